@@ -1,6 +1,7 @@
 #pragma once
 // Minimal, array only refactor of stb_ds.h by Sean Barrett.
 // https://github.com/nothings/stb/blob/master/stb_ds.h
+#include <assert.h>
 #include <stddef.h>
 #include <string.h>
 #if !(defined(XARR_REALLOC) || defined(XARR_FREE))
@@ -46,4 +47,49 @@ static xarr_T* __xarr_setcap(xarr_T* ptr, size_t N, struct xarray_header* next_p
 #define xarr_pop(a)             (xarr_header(a)->length--, (a)[xarr_header(a)->length])
 #define xarr_end(a)             ((a) + xarr_len(a))
 #define xarr_copy(src, dst)     (xarr_setlen(dst, xarr_len(src)), memcpy(dst, src, sizeof((dst)[0]) * xarr_len(src)))
-// clang-format on
\ No newline at end of file
+
+// Allocator aware arrays. The allocator is stored in front of the regular header, so all read only macros above
+// (xarr_len, xarr_cap, xarr_last, xarr_pop, xarr_delete etc.) work on these arrays too.
+// Create with xarra_init before use, then use the xarra_ growth macros instead of the xarr_ ones.
+// 'free' may be NULL for allocators which release everything at once (eg. a frame arena), in which case xarra_free
+// simply forgets the array. xarra_free leaves the array NULL, call xarra_init again before growing it. 'realloc' receives the old size so arenas can copy without tracking allocations.
+typedef struct xarr_allocator
+{
+    void* (*realloc)(void* ctx, void* ptr, size_t old_size, size_t new_size);
+    void  (*free)(void* ctx, void* ptr, size_t size);
+    void* ctx;
+} xarr_allocator;
+struct xarray_header_alloc
+{
+    const xarr_allocator* allocator;
+    size_t                pad; // Keeps the size a multiple of 16 like xarray_header, so elements stay 16 byte aligned
+    struct xarray_header  header;
+};
+#define xarra_header(a)         ((struct xarray_header_alloc*)(a)-1)
+#define xarra_allocator(a)      ((a) ? xarra_header(a)->allocator : NULL)
+#define xarra_size(a)           (sizeof(*a)*xarr_cap(a)+sizeof(struct xarray_header_alloc))
+#define xarra_free(a)           ((void)((a) && xarra_header(a)->allocator->free ? xarra_header(a)->allocator->free(xarra_header(a)->allocator->ctx, xarra_header(a), xarra_size(a)) : (void)0), (a) = NULL)
+#ifdef __cplusplus
+template<class xarr_T>
+#endif
+static xarr_T* __xarra_grow(xarr_T* ptr, const xarr_allocator* allocator, size_t stride, size_t N) {
+    assert(allocator && "Array has no allocator, call xarra_init first");
+    struct xarray_header_alloc* prev = ptr ? xarra_header(ptr) : NULL;
+    size_t prevcap  = ptr ? prev->header.capacity : 0;
+    size_t prevsize = ptr ? stride * prevcap + sizeof(*prev) : 0;
+    size_t nextcap  = N < prevcap * 2 ? prevcap * 2 : N;
+    struct xarray_header_alloc* next = (struct xarray_header_alloc*)allocator->realloc(allocator->ctx, prev, prevsize, stride * nextcap + sizeof(*next));
+    if (!ptr) next->header.length = 0;
+    next->allocator       = allocator;
+    next->header.capacity = nextcap;
+    return (xarr_T*)(next+1);
+}
+#define xarra_init(a, alloc, N) ((a) = __xarra_grow(0 ? (a) : NULL, (alloc), sizeof(*a), (N) > 0 ? (N) : 1))
+#define xarra_setcap(a, N)      (xarr_cap(a) < (N) ? (void)((a) = __xarra_grow((a), xarra_allocator(a), sizeof(*a), (N))) : (void)0)
+#define xarra_setlen(a, N)      (xarr_len(a) != (N) ? (void)(xarra_setcap((a), (N)), xarr_header(a)->length = (N)) : (void)0)
+#define xarra_addn(a, N)        (xarra_setlen(a, xarr_len(a) + (N)))
+#define xarra_push(a, v)        (xarra_setcap(a, xarr_len(a) + 1), (a)[xarr_header(a)->length++] = (v))
+#define xarra_insertn(a, i, N)  (xarra_addn((a), (N)), memmove(&(a)[(i) + (N)],  &(a)[i], sizeof *(a) * (xarr_header(a)->length - (N) - (i))))
+#define xarra_insert(a, i, v)   (xarra_insertn((a), (i), 1), (a)[i] = (v))
+#define xarra_copy(src, dst)    (xarra_setlen(dst, xarr_len(src)), memcpy(dst, src, sizeof((dst)[0]) * xarr_len(src)))
+// clang-format on
@@ -8,6 +8,7 @@ Very much a WIP. Do not use. Come back later!
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #if defined(__cplusplus) || __STDC_VERSION__ < 199901
 #define XTR_RESTRICT
@@ -27,6 +28,12 @@ Very much a WIP. Do not use. Come back later!
 #endif // NDEBUG
 #endif // XTR_ASSERT
 
+#if !defined(XTR_REALLOC) || !defined(XTR_FREE)
+#include <stdlib.h>
+#define XTR_REALLOC(ptr, size) realloc(ptr, size)
+#define XTR_FREE(ptr)          free(ptr)
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -71,6 +78,53 @@ ptrdiff_t xtr_fmt_va(char* text, ptrdiff_t max_len, char const* fmt, va_list va)
 uint64_t xtr_str_to_u64(char const* str, char** end_ptr, int base);
 int64_t  xtr_str_to_i64(char const* str, char** end_ptr, int base);
 
+// String interning. Each unique string is copied once into arena blocks and given a 32bit ID, so comparing two
+// interned strings is an integer comparison instead of xtr_match.
+// IDs are sequential starting from 0 and never change. Pointers returned by xtr_intern_get are stable for the lifetime
+// of the table, are 16 byte aligned and NULL terminated.
+// Not thread safe. Add all your strings from one thread, or wrap the table in a lock.
+#define XTR_INTERN_INVALID ((uint32_t)-1)
+
+typedef struct xtr_intern_entry
+{
+    const char* str;
+    uint32_t    len;
+    uint32_t    hash;
+} xtr_intern_entry;
+
+typedef struct xtr_intern
+{
+    // Linked list of string blocks. Each block begins with a pointer to the previous block
+    char*  block;
+    size_t block_len;
+    size_t block_cap;
+
+    xtr_intern_entry* entries; // indexed by ID
+    uint32_t          num_entries;
+    uint32_t          cap_entries;
+
+    uint32_t* slots; // open addressing hash table of ID + 1. 0 == empty slot
+    uint32_t  cap_slots;
+} xtr_intern;
+
+void xtr_intern_init(xtr_intern* table);
+void xtr_intern_deinit(xtr_intern* table);
+// Returns ID of the string, adding it to the table if it doesn't exist yet
+uint32_t xtr_intern_add(xtr_intern* table, const char* str, size_t len);
+// Returns XTR_INTERN_INVALID if the string has not been interned
+uint32_t xtr_intern_find(const xtr_intern* table, const char* str, size_t len);
+
+static inline const char* xtr_intern_get(const xtr_intern* table, uint32_t id)
+{
+    XTR_ASSERT(id < table->num_entries);
+    return table->entries[id].str;
+}
+static inline size_t xtr_intern_len(const xtr_intern* table, uint32_t id)
+{
+    XTR_ASSERT(id < table->num_entries);
+    return table->entries[id].len;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -81,6 +135,7 @@ int64_t  xtr_str_to_i64(char const* str, char** end_ptr, int base);
 #include <math.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #define xtr_min(a, b) ((a) < (b) ? (a) : (b))
 #define xtr_max(a, b) ((a) > (b) ? (a) : (b))
@@ -1311,4 +1366,150 @@ unsigned xtr_fmt(char* const buf, ptrdiff_t const cap, ptrdiff_t const offset, c
     return n;
 }
 
-#endif // XHL_STRING_IMPL
\ No newline at end of file
+// 32bit FNV-1a
+static uint32_t xtr_intern_hash(const char* str, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= (unsigned char)str[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void xtr_intern_init(xtr_intern* table) { memset(table, 0, sizeof(*table)); }
+
+void xtr_intern_deinit(xtr_intern* table)
+{
+    char* block = table->block;
+    while (block != NULL)
+    {
+        char* prev = *(char**)block;
+        XTR_FREE(block);
+        block = prev;
+    }
+    XTR_FREE(table->entries);
+    XTR_FREE(table->slots);
+    memset(table, 0, sizeof(*table));
+}
+
+static uint32_t xtr_intern_find_slot(const xtr_intern* table, const char* str, size_t len, uint32_t hash)
+{
+    XTR_ASSERT(table->cap_slots > 0);
+    uint32_t mask = table->cap_slots - 1;
+    uint32_t idx  = hash & mask;
+    for (;;)
+    {
+        uint32_t id = table->slots[idx];
+        if (id == 0)
+            return idx;
+
+        const xtr_intern_entry* e = &table->entries[id - 1];
+        if (e->hash == hash && e->len == len && memcmp(e->str, str, len) == 0)
+            return idx;
+
+        idx = (idx + 1) & mask;
+    }
+}
+
+static void xtr_intern_grow_slots(xtr_intern* table)
+{
+    uint32_t nextcap = table->cap_slots ? table->cap_slots * 2 : 256;
+
+    XTR_FREE(table->slots);
+    table->slots     = (uint32_t*)XTR_REALLOC(NULL, sizeof(*table->slots) * nextcap);
+    XTR_ASSERT(table->slots != NULL);
+    table->cap_slots = nextcap;
+    memset(table->slots, 0, sizeof(*table->slots) * nextcap);
+
+    uint32_t mask = nextcap - 1;
+    for (uint32_t i = 0; i < table->num_entries; i++)
+    {
+        uint32_t idx = table->entries[i].hash & mask;
+        while (table->slots[idx] != 0)
+            idx = (idx + 1) & mask;
+        table->slots[idx] = i + 1;
+    }
+}
+
+static const char* xtr_intern_push_string(xtr_intern* table, const char* str, size_t len)
+{
+    size_t offset  = table->block_len;
+    size_t nextlen = offset + len + 1;       // +1 for '\0' byte
+    nextlen        = (nextlen + 0xf) & ~0xf; // Round to 16 byte boundary
+
+    if (table->block == NULL || nextlen > table->block_cap)
+    {
+        // First 16 bytes of a block store a pointer to the previous block
+        size_t nextcap = 16 + ((len + 1 + 0xf) & ~0xf);
+        if (nextcap < 4096) // min cap
+            nextcap = 4096;
+
+        char* block = (char*)XTR_REALLOC(NULL, nextcap);
+        XTR_ASSERT(block != NULL);
+        *(char**)block   = table->block;
+        table->block     = block;
+        table->block_cap = nextcap;
+
+        offset  = 16;
+        nextlen = offset + ((len + 1 + 0xf) & ~0xf);
+    }
+    XTR_ASSERT((offset & 15) == 0);
+    table->block_len = nextlen;
+
+    char* dst = table->block + offset;
+    memcpy(dst, str, len);
+    dst[len] = '\0';
+    return dst;
+}
+
+uint32_t xtr_intern_find(const xtr_intern* table, const char* str, size_t len)
+{
+    if (table->num_entries == 0)
+        return XTR_INTERN_INVALID;
+
+    uint32_t hash = xtr_intern_hash(str, len);
+    uint32_t slot = xtr_intern_find_slot(table, str, len, hash);
+    return table->slots[slot] - 1; // Empty slot (0) wraps to XTR_INTERN_INVALID
+}
+
+uint32_t xtr_intern_add(xtr_intern* table, const char* str, size_t len)
+{
+    XTR_ASSERT(len < UINT32_MAX);
+    uint32_t hash = xtr_intern_hash(str, len);
+    uint32_t slot = 0;
+    if (table->cap_slots > 0)
+    {
+        slot = xtr_intern_find_slot(table, str, len, hash);
+        if (table->slots[slot] != 0)
+            return table->slots[slot] - 1;
+    }
+
+    // Only new strings grow the table. Keep load factor <= 0.5
+    if ((table->num_entries + 1) * 2 > table->cap_slots)
+    {
+        xtr_intern_grow_slots(table);
+        slot = xtr_intern_find_slot(table, str, len, hash);
+    }
+
+    if (table->num_entries == table->cap_entries)
+    {
+        uint32_t nextcap = table->cap_entries ? table->cap_entries * 2 : 128;
+        xtr_intern_entry* entries = (xtr_intern_entry*)XTR_REALLOC(table->entries, sizeof(*table->entries) * nextcap);
+        XTR_ASSERT(entries != NULL);
+        table->entries     = entries;
+        table->cap_entries = nextcap;
+    }
+
+    uint32_t          id = table->num_entries++;
+    xtr_intern_entry* e  = &table->entries[id];
+    e->str               = xtr_intern_push_string(table, str, len);
+    e->len               = (uint32_t)len;
+    e->hash              = hash;
+
+    table->slots[slot] = id + 1;
+    return id;
+}
+
+#endif // XHL_STRING_IMPL
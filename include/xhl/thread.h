@@ -9,21 +9,43 @@
 #ifndef XHL_THREAD_H
 #define XHL_THREAD_H
 
+// The implementation uses clock_gettime, syscall, MAP_ANONYMOUS and PTHREAD_PRIO_INHERIT, which strict modes like
+// -std=c11 hide. Feature macros only work before the first system header, so include this with XHL_THREAD_IMPL before
+// anything else, or build with -D_GNU_SOURCE. See the README
+#if defined(XHL_THREAD_IMPL) && !defined(_WIN32) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #define XTHREAD_STACK_SIZE_DEFAULT (0)
 #define XTHREAD_SIGNAL_WAIT_INFINITE (-1)
 #define XTHREAD_QUEUE_WAIT_INFINITE (-1)
 
+#if defined(__APPLE__) && defined(__arm64__)
+#define XTHREAD_CACHE_LINE_SIZE 128
+#else
+#define XTHREAD_CACHE_LINE_SIZE 64
+#endif
+
 #ifdef _MSC_VER
 #define XTHREAD_LOCAL __declspec(thread)
+#elif defined(__cplusplus)
+#define XTHREAD_LOCAL thread_local
 #else
 #define XTHREAD_LOCAL _Thread_local
 #endif
 
+#ifdef __cplusplus
+#define XTHREAD_STATIC_ASSERT static_assert
+#else
+#define XTHREAD_STATIC_ASSERT _Static_assert
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 typedef void* xt_thread_ptr_t;
@@ -41,24 +63,105 @@ typedef volatile long long xt_atomic_int64_t;
 typedef volatile void*     xt_atomic_ptr_t;
 typedef volatile unsigned  xt_atomic_float;
 
+#ifdef _MSC_VER
+#define XTHREAD_ALIGN(n) __declspec(align(n))
+#else
+#define XTHREAD_ALIGN(n) __attribute__((aligned(n)))
+#endif
+// Double width CAS, for pointer + tag pairs. Elsewhere the Treiber stack & free list fall back to a spinlock
+#if defined(__x86_64__) || defined(__aarch64__) || defined(__arm64__) || defined(_M_X64) || defined(_M_ARM64)
+#define XTHREAD_HAS_CAS128
+#endif
+typedef struct XTHREAD_ALIGN(16) xt_uint128_t
+{
+    uint64_t lo;
+    uint64_t hi;
+} xt_uint128_t;
+typedef volatile xt_uint128_t xt_atomic_uint128_t;
+
 typedef union  xt_mutex_t  xt_mutex_t;
 typedef union  xt_signal_t xt_signal_t;
 typedef union  xt_timer_t  xt_timer_t;
 typedef struct xt_queue_t  xt_queue_t;
+typedef struct xt_semaphore_t  xt_semaphore_t;
+typedef struct xt_barrier_t    xt_barrier_t;
+typedef struct xt_latch_t      xt_latch_t;
+typedef struct xt_mpmc_queue_t xt_mpmc_queue_t;
+typedef struct xt_mpmc_cell_t  xt_mpmc_cell_t;
+typedef struct xt_spsc_ring_t  xt_spsc_ring_t;
+typedef struct xt_triple_buffer_t xt_triple_buffer_t;
+typedef struct xt_stack_t         xt_stack_t;
+typedef struct xt_stack_node_t    xt_stack_node_t;
+typedef struct xt_freelist_t      xt_freelist_t;
+typedef struct xt_mpsc_queue_t    xt_mpsc_queue_t;
+typedef struct xt_mpsc_node_t     xt_mpsc_node_t;
+typedef struct xt_fiber_t         xt_fiber_t;
+typedef struct xt_counter_t       xt_counter_t; // Zero initialise
+typedef struct xt_deadline_monitor_t xt_deadline_monitor_t;
+typedef struct xt_deadline_t         xt_deadline_t;
+typedef struct xt_deadline_stats_t   xt_deadline_stats_t;
+typedef struct xt_deadline_overrun_t xt_deadline_overrun_t;
+typedef struct xt_pool_t       xt_pool_t;
+typedef struct xt_job_t        xt_job_t;
+typedef struct xt_graph_t      xt_graph_t;
+typedef struct xt_ebr_t        xt_ebr_t;
+typedef struct xt_ebr_reader_t xt_ebr_reader_t;
+typedef struct xt_thread_options_t xt_thread_options_t;
+typedef struct xt_realtime_t       xt_realtime_t;
+
+enum
+{
+    XTHREAD_MUTEX_DEFAULT      = 0,
+    XTHREAD_MUTEX_PRIO_INHERIT = 1 << 0,
+};
+
+typedef void (*xt_job_fn)(void* user_data);
+typedef void (*xt_range_fn)(void* ctx, int64_t begin, int64_t end);
+typedef void (*xt_reduce_fn)(void* ctx, int64_t begin, int64_t end, void* result);
+typedef void (*xt_join_fn)(void* ctx, void* result, const void* other);
 
 typedef volatile unsigned char xt_spinlock_t;
+typedef xt_atomic_uint32_t     xt_fastmutex_t; // Zero initialise
+typedef xt_atomic_uint32_t     xt_seqlock_t;   // Zero initialise
+typedef struct xt_rwlock_t     xt_rwlock_t;    // Zero initialise
+typedef struct xt_lock_stats_t xt_lock_stats_t;
+typedef struct xt_ticketlock_t xt_ticketlock_t;
+typedef struct xt_mcslock_t    xt_mcslock_t;
+typedef struct xt_mcs_node_t   xt_mcs_node_t;
 
 xt_thread_ptr_t xthread_current(void);
 xt_thread_ptr_t xthread_create(int (*thread_proc)(void*), void* user_data, int stack_size);
+// Zero initialise options for defaults. Name and affinity are applied by the new thread before thread_proc runs.
+// If the scheduling policy is not permitted the thread is still created, with the policy of the creating thread
+xt_thread_ptr_t xthread_create_ex(int (*thread_proc)(void*), void* user_data, const xt_thread_options_t* options);
+bool xthread_set_name(const char* name); // Calling thread. Linux truncates names to 15 characters
+// Calling thread. One bit per logical core, so only cores 0-63 can be selected. On Windows these are cores of the
+// threads processor group. Unsupported on Apple
+bool xthread_set_affinity(uint64_t core_mask);
 
 void xthread_yield(void);
-void xthread_set_high_priority(void);
+void xthread_set_high_priority(void); // xthread_set_realtime(XTHREAD_REALTIME_DEFAULT_PRIORITY, false)
+// Asks for realtime scheduling for the calling thread and reports what was granted.
+// POSIX: requests SCHED_FIFO at 'priority' (clamped to the valid range, and to RLIMIT_RTPRIO on Linux). If that is
+// not permitted Linux falls back to lowering the threads niceness like rtkit does, as far as RLIMIT_NICE allows.
+// lock_memory calls mlockall so pages aren't swapped out. Future allocations are only locked if RLIMIT_MEMLOCK is
+// unlimited, otherwise they could start failing.
+// Windows: THREAD_PRIORITY_TIME_CRITICAL. 'priority' and lock_memory are ignored
+#define XTHREAD_REALTIME_DEFAULT_PRIORITY 80
+xt_realtime_t xthread_set_realtime(int priority, bool lock_memory);
 void xthread_exit(int return_code);
 void xthread_destroy(xt_thread_ptr_t thread);
 int  xthread_join(xt_thread_ptr_t thread);
 int  xthread_detach(xt_thread_ptr_t thread);
+int  xthread_num_cores(void); // Logical cores available to this process
 
 void xthread_mutex_init(xt_mutex_t* mutex);
+// With XTHREAD_MUTEX_PRIO_INHERIT a thread holding the mutex is boosted to the priority of the highest priority thread
+// blocked on it (PTHREAD_PRIO_INHERIT, which is FUTEX_LOCK_PI on Linux), so a realtime thread waiting on a lock held by
+// a GUI thread isn't stuck behind everything else the GUI thread competes with. Returns false if the mode isn't
+// supported, the mutex is still initialised without it. Windows has no inheritance, instead its scheduler randomly
+// boosts starved lock holders, so this always returns false there
+bool xthread_mutex_init_ex(xt_mutex_t* mutex, int flags);
 void xthread_mutex_term(xt_mutex_t* mutex);
 void xthread_mutex_lock(xt_mutex_t* mutex);
 void xthread_mutex_unlock(xt_mutex_t* mutex);
@@ -68,7 +171,51 @@ void xthread_signal_term(xt_signal_t* signal);
 void xthread_signal_raise(xt_signal_t* signal);
 int  xthread_signal_wait(xt_signal_t* signal, int timeout_ms);
 
-// TODO add explicit memory order to atomic ops
+// Sleeps while *ptr == expected, on a futex (Linux), WaitOnAddress (Windows) or __ulock_wait (Apple).
+// Returns false on timeout. Wakes can be spurious and the value may have changed back, so always recheck it.
+// Notify after changing the value. Waiting and notifying are syscalls, track whether anyone is waiting if you can
+bool xt_atomic_wait_u32(xt_atomic_uint32_t* ptr, uint32_t expected, int timeout_ms);
+void xt_atomic_notify(xt_atomic_uint32_t* ptr, bool all);
+
+// Counting semaphore. Spins briefly then sleeps with xt_atomic_wait_u32. post() only makes a syscall when there are
+// threads sleeping. wait() returns false on timeout
+void xthread_semaphore_init(xt_semaphore_t* sem, uint32_t initial_count);
+void xthread_semaphore_term(xt_semaphore_t* sem);
+void xthread_semaphore_post(xt_semaphore_t* sem, uint32_t count);
+bool xthread_semaphore_wait(xt_semaphore_t* sem, int timeout_ms);
+bool xthread_semaphore_try_wait(xt_semaphore_t* sem);
+
+// Reusable barrier for 'count' threads, eg. the gather, process and mix phases of a block. Each wait blocks until all
+// 'count' threads have arrived, then releases them together and resets for the next phase. The last thread to arrive
+// bumps a generation counter the others watch, so a thread racing ahead into the next phase can't be confused with a
+// late one from this phase. Waiters spin for XTHREAD_BARRIER_SPIN_COUNT rounds of the spinlocks backoff, then sleep
+// with xt_atomic_wait_u32. Returns true on exactly one thread per phase, handy for serial work between phases
+#ifndef XTHREAD_BARRIER_SPIN_COUNT
+#define XTHREAD_BARRIER_SPIN_COUNT 100
+#endif
+void xthread_barrier_init(xt_barrier_t* barrier, uint32_t count);
+bool xthread_barrier_wait(xt_barrier_t* barrier);
+
+// One shot latch. Waiters block until count_down has been called 'count' times in total. Can't be reset, init it
+// again once nobody is waiting. Spins and sleeps like the barrier. The last count_down touches the latch after waiters
+// may have returned, so keep it alive until every count_down has returned
+void xthread_latch_init(xt_latch_t* latch, uint32_t count);
+void xthread_latch_count_down(xt_latch_t* latch, uint32_t n);
+bool xthread_latch_try_wait(xt_latch_t* latch); // Returns true if the count has reached 0
+void xthread_latch_wait(xt_latch_t* latch);
+
+// Atomics are static inline by default so they compile down to single instructions at the call site.
+// Define XTHREAD_ATOMIC_NOINLINE in every translation unit to get the old out-of-line functions, compiled alongside
+// XHL_THREAD_IMPL
+#ifdef XTHREAD_ATOMIC_NOINLINE
+#define XTHREAD_ATOMIC_API
+#else
+#define XTHREAD_ATOMIC_API static inline
+#endif
+
+// The plain atomic ops are all seq_cst. Use the _explicit variants where acquire/release or relaxed ordering is enough,
+// eg. load acquire / store release for publishing data, relaxed fetch_add for counters.
+// For compare_exchange the failure order is derived from the success order the same way C11 does
 enum xt_memory_order
 {
     xt_memory_order_relaxed, // __ATOMIC_RELAXED
@@ -79,102 +226,187 @@ enum xt_memory_order
     xt_memory_order_seq_cst, // __ATOMIC_SEQ_CST
 };
 
-uint8_t  xt_atomic_load_u8 (const xt_atomic_uint8_t*);
-uint16_t xt_atomic_load_u16(const xt_atomic_uint16_t*);
-uint32_t xt_atomic_load_u32(const xt_atomic_uint32_t*);
-uint64_t xt_atomic_load_u64(const xt_atomic_uint64_t*);
-int8_t   xt_atomic_load_i8 (const xt_atomic_int8_t*);
-int16_t  xt_atomic_load_i16(const xt_atomic_int16_t*);
-int32_t  xt_atomic_load_i32(const xt_atomic_int32_t*);
-int64_t  xt_atomic_load_i64(const xt_atomic_int64_t*);
-
-void xt_atomic_store_u8 (xt_atomic_uint8_t*,  uint8_t);
-void xt_atomic_store_u16(xt_atomic_uint16_t*, uint16_t);
-void xt_atomic_store_u32(xt_atomic_uint32_t*, uint32_t);
-void xt_atomic_store_u64(xt_atomic_uint64_t*, uint64_t);
-void xt_atomic_store_i8 (xt_atomic_int8_t*,   int8_t);
-void xt_atomic_store_i16(xt_atomic_int16_t*,  int16_t);
-void xt_atomic_store_i32(xt_atomic_int32_t*,  int32_t);
-void xt_atomic_store_i64(xt_atomic_int64_t*,  int64_t);
-
-uint8_t  xt_atomic_exchange_u8 (xt_atomic_uint8_t*,     uint8_t);
-uint16_t xt_atomic_exchange_u16(xt_atomic_uint16_t*ptr, uint16_t);
-uint32_t xt_atomic_exchange_u32(xt_atomic_uint32_t*ptr, uint32_t);
-uint64_t xt_atomic_exchange_u64(xt_atomic_uint64_t*ptr, uint64_t);
-int8_t   xt_atomic_exchange_i8 (xt_atomic_int8_t*ptr,   int8_t);
-int16_t  xt_atomic_exchange_i16(xt_atomic_int16_t*ptr,  int16_t);
-int32_t  xt_atomic_exchange_i32(xt_atomic_int32_t*ptr,  int32_t);
-int64_t  xt_atomic_exchange_i64(xt_atomic_int64_t*ptr,  int64_t);
-
-uint8_t xt_atomic_fetch_add_u8(xt_atomic_uint8_t*, uint8_t);
-uint16_t xt_atomic_fetch_add_u16(xt_atomic_uint16_t*ptr, uint16_t);
-uint32_t xt_atomic_fetch_add_u32(xt_atomic_uint32_t*ptr, uint32_t);
-uint64_t xt_atomic_fetch_add_u64(xt_atomic_uint64_t*ptr, uint64_t);
-int8_t xt_atomic_fetch_add_i8(xt_atomic_int8_t*ptr, int8_t);
-int16_t xt_atomic_fetch_add_i16(xt_atomic_int16_t*ptr, int16_t);
-int32_t xt_atomic_fetch_add_i32(xt_atomic_int32_t*ptr, int32_t);
-int64_t xt_atomic_fetch_add_i64(xt_atomic_int64_t*ptr, int64_t);
-
-uint8_t xt_atomic_fetch_sub_u8(xt_atomic_uint8_t*, uint8_t);
-uint16_t xt_atomic_fetch_sub_u16(xt_atomic_uint16_t*ptr, uint16_t);
-uint32_t xt_atomic_fetch_sub_u32(xt_atomic_uint32_t*ptr, uint32_t);
-uint64_t xt_atomic_fetch_sub_u64(xt_atomic_uint64_t*ptr, uint64_t);
-int8_t xt_atomic_fetch_sub_i8(xt_atomic_int8_t*ptr, int8_t);
-int16_t xt_atomic_fetch_sub_i16(xt_atomic_int16_t*ptr, int16_t);
-int32_t xt_atomic_fetch_sub_i32(xt_atomic_int32_t*ptr, int32_t);
-int64_t xt_atomic_fetch_sub_i64(xt_atomic_int64_t*ptr, int64_t);
-
-uint8_t xt_atomic_fetch_and_u8(xt_atomic_uint8_t*, uint8_t);
-uint16_t xt_atomic_fetch_and_u16(xt_atomic_uint16_t*ptr, uint16_t);
-uint32_t xt_atomic_fetch_and_u32(xt_atomic_uint32_t*ptr, uint32_t);
-uint64_t xt_atomic_fetch_and_u64(xt_atomic_uint64_t*ptr, uint64_t);
-int8_t xt_atomic_fetch_and_i8(xt_atomic_int8_t*ptr, int8_t);
-int16_t xt_atomic_fetch_and_i16(xt_atomic_int16_t*ptr, int16_t);
-int32_t xt_atomic_fetch_and_i32(xt_atomic_int32_t*ptr, int32_t);
-int64_t xt_atomic_fetch_and_i64(xt_atomic_int64_t*ptr, int64_t);
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_load_u8 (const xt_atomic_uint8_t*);
+XTHREAD_ATOMIC_API uint16_t xt_atomic_load_u16(const xt_atomic_uint16_t*);
+XTHREAD_ATOMIC_API uint32_t xt_atomic_load_u32(const xt_atomic_uint32_t*);
+XTHREAD_ATOMIC_API uint64_t xt_atomic_load_u64(const xt_atomic_uint64_t*);
+XTHREAD_ATOMIC_API int8_t   xt_atomic_load_i8 (const xt_atomic_int8_t*);
+XTHREAD_ATOMIC_API int16_t  xt_atomic_load_i16(const xt_atomic_int16_t*);
+XTHREAD_ATOMIC_API int32_t  xt_atomic_load_i32(const xt_atomic_int32_t*);
+XTHREAD_ATOMIC_API int64_t  xt_atomic_load_i64(const xt_atomic_int64_t*);
+
+XTHREAD_ATOMIC_API void xt_atomic_store_u8 (xt_atomic_uint8_t*,  uint8_t);
+XTHREAD_ATOMIC_API void xt_atomic_store_u16(xt_atomic_uint16_t*, uint16_t);
+XTHREAD_ATOMIC_API void xt_atomic_store_u32(xt_atomic_uint32_t*, uint32_t);
+XTHREAD_ATOMIC_API void xt_atomic_store_u64(xt_atomic_uint64_t*, uint64_t);
+XTHREAD_ATOMIC_API void xt_atomic_store_i8 (xt_atomic_int8_t*,   int8_t);
+XTHREAD_ATOMIC_API void xt_atomic_store_i16(xt_atomic_int16_t*,  int16_t);
+XTHREAD_ATOMIC_API void xt_atomic_store_i32(xt_atomic_int32_t*,  int32_t);
+XTHREAD_ATOMIC_API void xt_atomic_store_i64(xt_atomic_int64_t*,  int64_t);
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_exchange_u8 (xt_atomic_uint8_t*,     uint8_t);
+XTHREAD_ATOMIC_API uint16_t xt_atomic_exchange_u16(xt_atomic_uint16_t*ptr, uint16_t);
+XTHREAD_ATOMIC_API uint32_t xt_atomic_exchange_u32(xt_atomic_uint32_t*ptr, uint32_t);
+XTHREAD_ATOMIC_API uint64_t xt_atomic_exchange_u64(xt_atomic_uint64_t*ptr, uint64_t);
+XTHREAD_ATOMIC_API int8_t   xt_atomic_exchange_i8 (xt_atomic_int8_t*ptr,   int8_t);
+XTHREAD_ATOMIC_API int16_t  xt_atomic_exchange_i16(xt_atomic_int16_t*ptr,  int16_t);
+XTHREAD_ATOMIC_API int32_t  xt_atomic_exchange_i32(xt_atomic_int32_t*ptr,  int32_t);
+XTHREAD_ATOMIC_API int64_t  xt_atomic_exchange_i64(xt_atomic_int64_t*ptr,  int64_t);
+
+XTHREAD_ATOMIC_API uint8_t xt_atomic_fetch_add_u8(xt_atomic_uint8_t*, uint8_t);
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_add_u16(xt_atomic_uint16_t*ptr, uint16_t);
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_add_u32(xt_atomic_uint32_t*ptr, uint32_t);
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_add_u64(xt_atomic_uint64_t*ptr, uint64_t);
+XTHREAD_ATOMIC_API int8_t xt_atomic_fetch_add_i8(xt_atomic_int8_t*ptr, int8_t);
+XTHREAD_ATOMIC_API int16_t xt_atomic_fetch_add_i16(xt_atomic_int16_t*ptr, int16_t);
+XTHREAD_ATOMIC_API int32_t xt_atomic_fetch_add_i32(xt_atomic_int32_t*ptr, int32_t);
+XTHREAD_ATOMIC_API int64_t xt_atomic_fetch_add_i64(xt_atomic_int64_t*ptr, int64_t);
+
+XTHREAD_ATOMIC_API uint8_t xt_atomic_fetch_sub_u8(xt_atomic_uint8_t*, uint8_t);
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_sub_u16(xt_atomic_uint16_t*ptr, uint16_t);
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_sub_u32(xt_atomic_uint32_t*ptr, uint32_t);
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_sub_u64(xt_atomic_uint64_t*ptr, uint64_t);
+XTHREAD_ATOMIC_API int8_t xt_atomic_fetch_sub_i8(xt_atomic_int8_t*ptr, int8_t);
+XTHREAD_ATOMIC_API int16_t xt_atomic_fetch_sub_i16(xt_atomic_int16_t*ptr, int16_t);
+XTHREAD_ATOMIC_API int32_t xt_atomic_fetch_sub_i32(xt_atomic_int32_t*ptr, int32_t);
+XTHREAD_ATOMIC_API int64_t xt_atomic_fetch_sub_i64(xt_atomic_int64_t*ptr, int64_t);
+
+XTHREAD_ATOMIC_API uint8_t xt_atomic_fetch_and_u8(xt_atomic_uint8_t*, uint8_t);
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_and_u16(xt_atomic_uint16_t*ptr, uint16_t);
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_and_u32(xt_atomic_uint32_t*ptr, uint32_t);
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_and_u64(xt_atomic_uint64_t*ptr, uint64_t);
+XTHREAD_ATOMIC_API int8_t xt_atomic_fetch_and_i8(xt_atomic_int8_t*ptr, int8_t);
+XTHREAD_ATOMIC_API int16_t xt_atomic_fetch_and_i16(xt_atomic_int16_t*ptr, int16_t);
+XTHREAD_ATOMIC_API int32_t xt_atomic_fetch_and_i32(xt_atomic_int32_t*ptr, int32_t);
+XTHREAD_ATOMIC_API int64_t xt_atomic_fetch_and_i64(xt_atomic_int64_t*ptr, int64_t);
 
 // GCC has __atomic_fetch_nand, but MSVC doesn't. I don't really need it so it's not inluded here
 
-uint8_t xt_atomic_fetch_nand_u8(xt_atomic_uint8_t*, uint8_t);
-uint16_t xt_atomic_fetch_nand_u16(xt_atomic_uint16_t*ptr, uint16_t);
-uint32_t xt_atomic_fetch_nand_u32(xt_atomic_uint32_t*ptr, uint32_t);
-uint64_t xt_atomic_fetch_nand_u64(xt_atomic_uint64_t*ptr, uint64_t);
-int8_t xt_atomic_fetch_nand_i8(xt_atomic_int8_t*ptr, int8_t);
-int16_t xt_atomic_fetch_nand_i16(xt_atomic_int16_t*ptr, int16_t);
-int32_t xt_atomic_fetch_nand_i32(xt_atomic_int32_t*ptr, int32_t);
-int64_t xt_atomic_fetch_nand_i64(xt_atomic_int64_t*ptr, int64_t);
-
-uint8_t xt_atomic_fetch_or_u8(xt_atomic_uint8_t*, uint8_t);
-uint16_t xt_atomic_fetch_or_u16(xt_atomic_uint16_t*ptr, uint16_t);
-uint32_t xt_atomic_fetch_or_u32(xt_atomic_uint32_t*ptr, uint32_t);
-uint64_t xt_atomic_fetch_or_u64(xt_atomic_uint64_t*ptr, uint64_t);
-int8_t xt_atomic_fetch_or_i8(xt_atomic_int8_t*ptr, int8_t);
-int16_t xt_atomic_fetch_or_i16(xt_atomic_int16_t*ptr, int16_t);
-int32_t xt_atomic_fetch_or_i32(xt_atomic_int32_t*ptr, int32_t);
-int64_t xt_atomic_fetch_or_i64(xt_atomic_int64_t*ptr, int64_t);
-
-uint8_t xt_atomic_fetch_xor_u8(xt_atomic_uint8_t*, uint8_t);
-uint16_t xt_atomic_fetch_xor_u16(xt_atomic_uint16_t*ptr, uint16_t);
-uint32_t xt_atomic_fetch_xor_u32(xt_atomic_uint32_t*ptr, uint32_t);
-uint64_t xt_atomic_fetch_xor_u64(xt_atomic_uint64_t*ptr, uint64_t);
-int8_t xt_atomic_fetch_xor_i8(xt_atomic_int8_t*ptr, int8_t);
-int16_t xt_atomic_fetch_xor_i16(xt_atomic_int16_t*ptr, int16_t);
-int32_t xt_atomic_fetch_xor_i32(xt_atomic_int32_t*ptr, int32_t);
-int64_t xt_atomic_fetch_xor_i64(xt_atomic_int64_t*ptr, int64_t);
-
-uint8_t  xt_atomic_compare_exchange_u8 (xt_atomic_uint8_t*  ptr, uint8_t  expected, uint8_t  desired);
-uint16_t xt_atomic_compare_exchange_u16(xt_atomic_uint16_t* ptr, uint16_t expected, uint16_t desired);
-uint32_t xt_atomic_compare_exchange_u32(xt_atomic_uint32_t* ptr, uint32_t expected, uint32_t desired);
-uint64_t xt_atomic_compare_exchange_u64(xt_atomic_uint64_t* ptr, uint64_t expected, uint64_t desired);
-int8_t   xt_atomic_compare_exchange_i8 (xt_atomic_int8_t*   ptr, int8_t   expected, int8_t   desired);
-int16_t  xt_atomic_compare_exchange_i16(xt_atomic_int16_t*  ptr, int16_t  expected, int16_t  desired);
-int32_t  xt_atomic_compare_exchange_i32(xt_atomic_int32_t*  ptr, int32_t  expected, int32_t  desired);
-int64_t  xt_atomic_compare_exchange_i64(xt_atomic_int64_t*  ptr, int64_t  expected, int64_t  desired);
-
-static inline void* xt_atomic_load_ptr(const xt_atomic_ptr_t* ptr) { return (void*)xt_atomic_load_u64((uint64_t*)ptr); }
-static inline void  xt_atomic_store_ptr(xt_atomic_ptr_t* ptr, void* v) { xt_atomic_store_u64((uint64_t*)ptr, (uint64_t)v); }
-static inline void* xt_atomic_exchange_ptr(xt_atomic_ptr_t* ptr, void* v) { return (void*)xt_atomic_exchange_u64((uint64_t*)ptr, (uint64_t)v); }
-static inline bool  xt_atomic_compare_exchange_strong_ptr(xt_atomic_ptr_t* ptr, void* expected, void* desired) { return xt_atomic_compare_exchange_u64((xt_atomic_uint64_t*)ptr, (uint64_t)expected, (uint64_t)desired); }
+XTHREAD_ATOMIC_API uint8_t xt_atomic_fetch_or_u8(xt_atomic_uint8_t*, uint8_t);
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_or_u16(xt_atomic_uint16_t*ptr, uint16_t);
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_or_u32(xt_atomic_uint32_t*ptr, uint32_t);
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_or_u64(xt_atomic_uint64_t*ptr, uint64_t);
+XTHREAD_ATOMIC_API int8_t xt_atomic_fetch_or_i8(xt_atomic_int8_t*ptr, int8_t);
+XTHREAD_ATOMIC_API int16_t xt_atomic_fetch_or_i16(xt_atomic_int16_t*ptr, int16_t);
+XTHREAD_ATOMIC_API int32_t xt_atomic_fetch_or_i32(xt_atomic_int32_t*ptr, int32_t);
+XTHREAD_ATOMIC_API int64_t xt_atomic_fetch_or_i64(xt_atomic_int64_t*ptr, int64_t);
+
+XTHREAD_ATOMIC_API uint8_t xt_atomic_fetch_xor_u8(xt_atomic_uint8_t*, uint8_t);
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_xor_u16(xt_atomic_uint16_t*ptr, uint16_t);
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_xor_u32(xt_atomic_uint32_t*ptr, uint32_t);
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_xor_u64(xt_atomic_uint64_t*ptr, uint64_t);
+XTHREAD_ATOMIC_API int8_t xt_atomic_fetch_xor_i8(xt_atomic_int8_t*ptr, int8_t);
+XTHREAD_ATOMIC_API int16_t xt_atomic_fetch_xor_i16(xt_atomic_int16_t*ptr, int16_t);
+XTHREAD_ATOMIC_API int32_t xt_atomic_fetch_xor_i32(xt_atomic_int32_t*ptr, int32_t);
+XTHREAD_ATOMIC_API int64_t xt_atomic_fetch_xor_i64(xt_atomic_int64_t*ptr, int64_t);
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_compare_exchange_u8 (xt_atomic_uint8_t*  ptr, uint8_t  expected, uint8_t  desired);
+XTHREAD_ATOMIC_API uint16_t xt_atomic_compare_exchange_u16(xt_atomic_uint16_t* ptr, uint16_t expected, uint16_t desired);
+XTHREAD_ATOMIC_API uint32_t xt_atomic_compare_exchange_u32(xt_atomic_uint32_t* ptr, uint32_t expected, uint32_t desired);
+XTHREAD_ATOMIC_API uint64_t xt_atomic_compare_exchange_u64(xt_atomic_uint64_t* ptr, uint64_t expected, uint64_t desired);
+XTHREAD_ATOMIC_API int8_t   xt_atomic_compare_exchange_i8 (xt_atomic_int8_t*   ptr, int8_t   expected, int8_t   desired);
+XTHREAD_ATOMIC_API int16_t  xt_atomic_compare_exchange_i16(xt_atomic_int16_t*  ptr, int16_t  expected, int16_t  desired);
+XTHREAD_ATOMIC_API int32_t  xt_atomic_compare_exchange_i32(xt_atomic_int32_t*  ptr, int32_t  expected, int32_t  desired);
+XTHREAD_ATOMIC_API int64_t  xt_atomic_compare_exchange_i64(xt_atomic_int64_t*  ptr, int64_t  expected, int64_t  desired);
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_load_explicit_u8 (const xt_atomic_uint8_t*  ptr, enum xt_memory_order);
+XTHREAD_ATOMIC_API uint16_t xt_atomic_load_explicit_u16(const xt_atomic_uint16_t* ptr, enum xt_memory_order);
+XTHREAD_ATOMIC_API uint32_t xt_atomic_load_explicit_u32(const xt_atomic_uint32_t* ptr, enum xt_memory_order);
+XTHREAD_ATOMIC_API uint64_t xt_atomic_load_explicit_u64(const xt_atomic_uint64_t* ptr, enum xt_memory_order);
+XTHREAD_ATOMIC_API int8_t   xt_atomic_load_explicit_i8 (const xt_atomic_int8_t*   ptr, enum xt_memory_order);
+XTHREAD_ATOMIC_API int16_t  xt_atomic_load_explicit_i16(const xt_atomic_int16_t*  ptr, enum xt_memory_order);
+XTHREAD_ATOMIC_API int32_t  xt_atomic_load_explicit_i32(const xt_atomic_int32_t*  ptr, enum xt_memory_order);
+XTHREAD_ATOMIC_API int64_t  xt_atomic_load_explicit_i64(const xt_atomic_int64_t*  ptr, enum xt_memory_order);
+
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v, enum xt_memory_order);
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t v, enum xt_memory_order);
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t v, enum xt_memory_order);
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t v, enum xt_memory_order);
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   v, enum xt_memory_order);
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  v, enum xt_memory_order);
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  v, enum xt_memory_order);
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  v, enum xt_memory_order);
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_exchange_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v, enum xt_memory_order);
+XTHREAD_ATOMIC_API uint16_t xt_atomic_exchange_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t v, enum xt_memory_order);
+XTHREAD_ATOMIC_API uint32_t xt_atomic_exchange_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t v, enum xt_memory_order);
+XTHREAD_ATOMIC_API uint64_t xt_atomic_exchange_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t v, enum xt_memory_order);
+XTHREAD_ATOMIC_API int8_t   xt_atomic_exchange_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   v, enum xt_memory_order);
+XTHREAD_ATOMIC_API int16_t  xt_atomic_exchange_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  v, enum xt_memory_order);
+XTHREAD_ATOMIC_API int32_t  xt_atomic_exchange_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  v, enum xt_memory_order);
+XTHREAD_ATOMIC_API int64_t  xt_atomic_exchange_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  v, enum xt_memory_order);
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_fetch_add_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v, enum xt_memory_order);
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_add_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t v, enum xt_memory_order);
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_add_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t v, enum xt_memory_order);
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_add_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t v, enum xt_memory_order);
+XTHREAD_ATOMIC_API int8_t   xt_atomic_fetch_add_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   v, enum xt_memory_order);
+XTHREAD_ATOMIC_API int16_t  xt_atomic_fetch_add_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  v, enum xt_memory_order);
+XTHREAD_ATOMIC_API int32_t  xt_atomic_fetch_add_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  v, enum xt_memory_order);
+XTHREAD_ATOMIC_API int64_t  xt_atomic_fetch_add_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  v, enum xt_memory_order);
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_fetch_sub_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v, enum xt_memory_order);
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_sub_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t v, enum xt_memory_order);
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_sub_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t v, enum xt_memory_order);
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_sub_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t v, enum xt_memory_order);
+XTHREAD_ATOMIC_API int8_t   xt_atomic_fetch_sub_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   v, enum xt_memory_order);
+XTHREAD_ATOMIC_API int16_t  xt_atomic_fetch_sub_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  v, enum xt_memory_order);
+XTHREAD_ATOMIC_API int32_t  xt_atomic_fetch_sub_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  v, enum xt_memory_order);
+XTHREAD_ATOMIC_API int64_t  xt_atomic_fetch_sub_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  v, enum xt_memory_order);
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_fetch_and_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v, enum xt_memory_order);
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_and_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t v, enum xt_memory_order);
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_and_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t v, enum xt_memory_order);
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_and_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t v, enum xt_memory_order);
+XTHREAD_ATOMIC_API int8_t   xt_atomic_fetch_and_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   v, enum xt_memory_order);
+XTHREAD_ATOMIC_API int16_t  xt_atomic_fetch_and_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  v, enum xt_memory_order);
+XTHREAD_ATOMIC_API int32_t  xt_atomic_fetch_and_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  v, enum xt_memory_order);
+XTHREAD_ATOMIC_API int64_t  xt_atomic_fetch_and_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  v, enum xt_memory_order);
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_fetch_or_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v, enum xt_memory_order);
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_or_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t v, enum xt_memory_order);
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_or_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t v, enum xt_memory_order);
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_or_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t v, enum xt_memory_order);
+XTHREAD_ATOMIC_API int8_t   xt_atomic_fetch_or_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   v, enum xt_memory_order);
+XTHREAD_ATOMIC_API int16_t  xt_atomic_fetch_or_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  v, enum xt_memory_order);
+XTHREAD_ATOMIC_API int32_t  xt_atomic_fetch_or_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  v, enum xt_memory_order);
+XTHREAD_ATOMIC_API int64_t  xt_atomic_fetch_or_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  v, enum xt_memory_order);
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_fetch_xor_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v, enum xt_memory_order);
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_xor_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t v, enum xt_memory_order);
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_xor_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t v, enum xt_memory_order);
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_xor_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t v, enum xt_memory_order);
+XTHREAD_ATOMIC_API int8_t   xt_atomic_fetch_xor_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   v, enum xt_memory_order);
+XTHREAD_ATOMIC_API int16_t  xt_atomic_fetch_xor_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  v, enum xt_memory_order);
+XTHREAD_ATOMIC_API int32_t  xt_atomic_fetch_xor_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  v, enum xt_memory_order);
+XTHREAD_ATOMIC_API int64_t  xt_atomic_fetch_xor_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  v, enum xt_memory_order);
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_compare_exchange_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  expected, uint8_t  desired, enum xt_memory_order);
+XTHREAD_ATOMIC_API uint16_t xt_atomic_compare_exchange_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t expected, uint16_t desired, enum xt_memory_order);
+XTHREAD_ATOMIC_API uint32_t xt_atomic_compare_exchange_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t expected, uint32_t desired, enum xt_memory_order);
+XTHREAD_ATOMIC_API uint64_t xt_atomic_compare_exchange_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t expected, uint64_t desired, enum xt_memory_order);
+XTHREAD_ATOMIC_API int8_t   xt_atomic_compare_exchange_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   expected, int8_t   desired, enum xt_memory_order);
+XTHREAD_ATOMIC_API int16_t  xt_atomic_compare_exchange_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  expected, int16_t  desired, enum xt_memory_order);
+XTHREAD_ATOMIC_API int32_t  xt_atomic_compare_exchange_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  expected, int32_t  desired, enum xt_memory_order);
+XTHREAD_ATOMIC_API int64_t  xt_atomic_compare_exchange_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  expected, int64_t  desired, enum xt_memory_order);
+
+XTHREAD_ATOMIC_API void xt_atomic_thread_fence(enum xt_memory_order);
+
+#ifdef XTHREAD_HAS_CAS128
+// Double width CAS (cmpxchg16b on x86-64, ldaxp/stlxp on AArch64). seq_cst. Returns the old value like the other
+// compare_exchange ops. There's no 128bit load, read the halves separately and let the CAS catch torn reads
+XTHREAD_ATOMIC_API xt_uint128_t xt_atomic_compare_exchange_u128(xt_atomic_uint128_t* ptr, xt_uint128_t expected, xt_uint128_t desired);
+#endif
+
+static inline void* xt_atomic_load_ptr(const xt_atomic_ptr_t* ptr) { return (void*)xt_atomic_load_u64((const xt_atomic_uint64_t*)ptr); }
+static inline void  xt_atomic_store_ptr(xt_atomic_ptr_t* ptr, void* v) { xt_atomic_store_u64((xt_atomic_uint64_t*)ptr, (uint64_t)v); }
+static inline void* xt_atomic_exchange_ptr(xt_atomic_ptr_t* ptr, void* v) { return (void*)xt_atomic_exchange_u64((xt_atomic_uint64_t*)ptr, (uint64_t)v); }
+static inline bool  xt_atomic_compare_exchange_strong_ptr(xt_atomic_ptr_t* ptr, void* expected, void* desired) { return xt_atomic_compare_exchange_u64((xt_atomic_uint64_t*)ptr, (uint64_t)expected, (uint64_t)desired) == (uint64_t)expected; }
+
+static inline void* xt_atomic_load_explicit_ptr(const xt_atomic_ptr_t* ptr, enum xt_memory_order o) { return (void*)xt_atomic_load_explicit_u64((const xt_atomic_uint64_t*)ptr, o); }
+static inline void  xt_atomic_store_explicit_ptr(xt_atomic_ptr_t* ptr, void* v, enum xt_memory_order o) { xt_atomic_store_explicit_u64((xt_atomic_uint64_t*)ptr, (uint64_t)v, o); }
+static inline void* xt_atomic_exchange_explicit_ptr(xt_atomic_ptr_t* ptr, void* v, enum xt_memory_order o) { return (void*)xt_atomic_exchange_explicit_u64((xt_atomic_uint64_t*)ptr, (uint64_t)v, o); }
+static inline bool  xt_atomic_compare_exchange_strong_explicit_ptr(xt_atomic_ptr_t* ptr, void* expected, void* desired, enum xt_memory_order o) { return xt_atomic_compare_exchange_explicit_u64((xt_atomic_uint64_t*)ptr, (uint64_t)expected, (uint64_t)desired, o) == (uint64_t)expected; }
 
 union xt_uif {unsigned u; int i; float f;};
 
@@ -197,6 +429,18 @@ static inline float xt_atomic_exchange_f32(xt_atomic_float* ptr, float v)
     return b.f;
 }
 
+static inline float xt_atomic_load_explicit_f32(const xt_atomic_float* ptr, enum xt_memory_order o)
+{
+    union xt_uif v  = {.u = xt_atomic_load_explicit_u32(ptr, o)};
+    return v.f;
+}
+
+static inline void xt_atomic_store_explicit_f32(xt_atomic_float* ptr, float v, enum xt_memory_order o)
+{
+    union xt_uif a = {.f = v};
+    xt_atomic_store_explicit_u32(ptr, a.u, o);
+}
+
 
 void xthread_timer_init(xt_timer_t* timer);
 void xthread_timer_term(xt_timer_t* timer);
@@ -214,12 +458,286 @@ int   xthread_queue_produce(xt_queue_t* queue, void* value, int timeout_ms);
 void* xthread_queue_consume(xt_queue_t* queue, int timeout_ms);
 int   xthread_queue_count(xt_queue_t* queue);
 
+// Bounded multi producer multi consumer queue. Based on Dmitry Vyukov's MPMC queue
+// https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+// 'cells' must point to 'size' cells, where size is a power of 2.
+// try_push/try_pop never block or wait. produce/consume additionally wait on signals when the queue is full/empty.
+// If any consumer uses consume() with a timeout, producers must use produce() so they raise the signal, and vice versa
+void  xthread_mpmc_queue_init(xt_mpmc_queue_t* queue, xt_mpmc_cell_t* cells, int size);
+void  xthread_mpmc_queue_term(xt_mpmc_queue_t* queue);
+bool  xthread_mpmc_queue_try_push(xt_mpmc_queue_t* queue, void* value);
+bool  xthread_mpmc_queue_try_pop(xt_mpmc_queue_t* queue, void** value);
+int   xthread_mpmc_queue_produce(xt_mpmc_queue_t* queue, void* value, int timeout_ms);
+void* xthread_mpmc_queue_consume(xt_mpmc_queue_t* queue, int timeout_ms);
+int   xthread_mpmc_queue_count(xt_mpmc_queue_t* queue); // Approximate when other threads are pushing/popping
+
+// Wait free single producer single consumer ring buffer of fixed size items.
+// The producer and consumer indices live on separate cache lines, and each side caches the other sides index so it
+// only touches the other cache line when the ring looks full/empty.
+// 'buffer' must hold 'size' items of 'stride' bytes, where size is a power of 2.
+// The _n variants copy as many items as fit/are available and return the number of items copied
+void     xthread_spsc_ring_init(xt_spsc_ring_t* ring, void* buffer, uint32_t stride, uint32_t size);
+bool     xthread_spsc_ring_produce(xt_spsc_ring_t* ring, const void* item);
+bool     xthread_spsc_ring_consume(xt_spsc_ring_t* ring, void* item);
+uint32_t xthread_spsc_ring_produce_n(xt_spsc_ring_t* ring, const void* items, uint32_t n);
+uint32_t xthread_spsc_ring_consume_n(xt_spsc_ring_t* ring, void* items, uint32_t n);
+uint32_t xthread_spsc_ring_count(xt_spsc_ring_t* ring);
+
+// Triple buffer for passing the latest value from one writer thread to one reader thread, eg. scope frames from the
+// audio thread to the GUI. Neither side ever blocks or waits, and stale values are simply overwritten.
+// The writer fills its back buffer and publishes it by swapping it with the middle buffer in one atomic exchange.
+// The reader swaps the middle buffer with its front buffer if a new one has been published since its last read.
+// 'buffers' must hold 3 items of 'stride' bytes
+void        xthread_triple_buffer_init(xt_triple_buffer_t* tb, void* buffers, uint32_t stride);
+void*       xthread_triple_buffer_write_begin(xt_triple_buffer_t* tb); // Returns the buffer to fill
+void        xthread_triple_buffer_write_end(xt_triple_buffer_t* tb);   // Publishes it
+const void* xthread_triple_buffer_read(xt_triple_buffer_t* tb, bool* is_new); // Latest published buffer. is_new is optional
+void        xthread_triple_buffer_write(xt_triple_buffer_t* tb, const void* item); // Copy and publish
+
+// Lock free intrusive Treiber stack. Embed an xt_stack_node_t in your objects. The head pointer is paired with a
+// version tag that changes on every push & pop, and both are swapped with xt_atomic_compare_exchange_u128, so a node
+// popped and pushed back by other threads between our read and our CAS can't fool us (ABA).
+// Without XTHREAD_HAS_CAS128 push & pop take a spinlock instead, so they are no longer lock free.
+// Pop reads the next pointer of nodes that other threads may have popped meanwhile, so nodes must stay readable while
+// the stack is in use, ie. recycle them rather than freeing them.
+void             xthread_stack_init(xt_stack_t* stack);
+void             xthread_stack_push(xt_stack_t* stack, xt_stack_node_t* node);
+xt_stack_node_t* xthread_stack_pop(xt_stack_t* stack); // Returns NULL when empty
+
+// Lock free pool of fixed size items built on the stack above. 'memory' holds 'count' items of 'stride' bytes, where
+// stride >= sizeof(void*). Items are recycled, never freed, so the free list and memory must outlive all users
+void  xthread_freelist_init(xt_freelist_t* list, void* memory, size_t stride, size_t count);
+void* xthread_freelist_alloc(xt_freelist_t* list); // Returns NULL when empty
+void  xthread_freelist_free(xt_freelist_t* list, void* item);
+
+// Unbounded intrusive multi producer single consumer queue (Dmitry Vyukov's). Embed an xt_mpsc_node_t in your objects.
+// Pushing is wait free, a single exchange, and never allocates, so any thread can post to eg. the main thread without
+// taking a lock. Only one thread may pop/drain.
+// A push that has swapped the head but not yet linked its node hides everything behind it for a moment, so pop can
+// return NULL while the queue isn't empty. Those items show up on the next pop/drain.
+// Drain pops at most max_items, so producers that keep pushing (or a callback that pushes again) can't keep the
+// consumer stuck in it, eg. for a whole GUI frame. Anything left over is picked up by the next drain.
+// The queue must not be moved after init.
+//     struct main_thread_task { xt_mpsc_node_t node; void (*fn)(void*); void* ud; };
+//     // Any thread
+//     xthread_mpsc_queue_push(&g_main_queue, &task->node);
+//     // Main thread timer
+//     xthread_mpsc_queue_drain(&g_main_queue, 64, run_task, NULL);
+typedef void (*xt_mpsc_drain_fn)(void* ctx, xt_mpsc_node_t* node);
+void            xthread_mpsc_queue_init(xt_mpsc_queue_t* queue);
+void            xthread_mpsc_queue_push(xt_mpsc_queue_t* queue, xt_mpsc_node_t* node);
+xt_mpsc_node_t* xthread_mpsc_queue_pop(xt_mpsc_queue_t* queue);
+int             xthread_mpsc_queue_drain(xt_mpsc_queue_t* queue, int max_items, xt_mpsc_drain_fn fn, void* ctx); // Num popped
+
+// Fibers, aka stackful coroutines. Switching saves the callee saved registers and swaps stack pointers in a few
+// instructions, and never enters the kernel. Hand written for x86-64 and AArch64, Win32 fibers on Windows, and
+// ucontext everywhere else or if XTHREAD_FIBER_UCONTEXT is defined.
+// A thread becomes a fiber the first time it calls xthread_fiber_current or switches. Call
+// xthread_fiber_release_thread from that original fiber before the thread exits.
+// When fn returns the fiber is done, and control goes back to whichever fiber last switched to it. Never switch to a
+// fiber that is done or running on another thread. Fibers may be resumed on a different thread than the one they were
+// suspended on, so don't keep pointers to thread locals across a switch.
+// Stacks have a guard page on POSIX. Memory is only committed as the stack is used
+#define XTHREAD_FIBER_STACK_SIZE_DEFAULT (256 * 1024)
+typedef void (*xt_fiber_fn)(void* user_data);
+xt_fiber_t* xthread_fiber_create(size_t stack_size, xt_fiber_fn fn, void* user_data); // stack_size 0 for default
+void        xthread_fiber_destroy(xt_fiber_t* fiber);
+xt_fiber_t* xthread_fiber_current(void);
+void        xthread_fiber_switch(xt_fiber_t* to);
+bool        xthread_fiber_done(xt_fiber_t* fiber);
+void        xthread_fiber_release_thread(void);
+
+// Work stealing job system. Each worker thread owns a Chase-Lev deque which it pushes and pops jobs from, while idle
+// workers steal from the other end. Jobs submitted from threads outside the pool go into a shared injection queue.
+// Workers park on a signal when there is no work anywhere.
+// Jobs are owned by the caller and must stay alive until they are done. Child jobs count towards their parents
+// completion, so you can wait on one parent for a whole tree of work.
+// xthread_pool_wait runs other jobs while it waits, so it is safe to call from inside a job.
+// Fiber jobs run on a fiber of their own. When one waits, its fiber is parked and the worker carries on with other
+// jobs, then the fiber is resumed (possibly by another worker) once the job it waits on is done. Use them for jobs that
+// spend a long time waiting on other jobs, eg. a preset load waiting on file reads and decoding. Fibers are recycled.
+// Any number of fibers can be parked, each keeps its stack until it's done. Threads outside the pool that wait may end
+// up running fiber jobs, and become fibers themselves (see xthread_fiber_release_thread).
+// Destroying a pool does not run pending jobs. Wait for them first.
+xt_pool_t* xthread_pool_create(int num_threads); // num_threads <= 0 creates one per core
+void       xthread_pool_destroy(xt_pool_t* pool);
+int        xthread_pool_num_threads(xt_pool_t* pool);
+void       xthread_pool_submit(xt_pool_t* pool, xt_job_t* job, xt_job_fn fn, void* user_data);
+void       xthread_pool_submit_child(xt_pool_t* pool, xt_job_t* parent, xt_job_t* job, xt_job_fn fn, void* user_data);
+void       xthread_pool_submit_fiber(xt_pool_t* pool, xt_job_t* job, xt_job_fn fn, void* user_data);
+void       xthread_pool_wait(xt_pool_t* pool, xt_job_t* job);
+bool       xthread_job_done(xt_job_t* job);
+
+// Runs fn over [begin, end) using the pool. The range is split in half recursively until it is no larger than
+// 'grain'. Right halves are offered to other workers while the calling thread keeps working on the left half, so
+// halves nobody steals are run by the caller without further overhead. Pass grain <= 0 to pick one automatically.
+// Blocks until the whole range is done. The calling thread participates and may be inside a job.
+void xthread_parallel_for(xt_pool_t* pool, int64_t begin, int64_t end, int64_t grain, xt_range_fn fn, void* ctx);
+// Same splitting as above. 'result' must contain the identity value (eg. 0 for a sum) when called. Each range
+// accumulates into a result of its own via reduce_fn, and results are combined with join_fn into 'result'.
+// result_size must be <= XTHREAD_REDUCE_MAX_SIZE
+#define XTHREAD_REDUCE_MAX_SIZE 128
+void xthread_parallel_reduce(
+    xt_pool_t*   pool,
+    int64_t      begin,
+    int64_t      end,
+    int64_t      grain,
+    xt_reduce_fn reduce_fn,
+    xt_join_fn   join_fn,
+    void*        ctx,
+    void*        result,
+    size_t       result_size);
+
+// Task graph. Build a DAG of nodes once, then run it as many times as you like (eg. once per audio block).
+// Each run resets every nodes dependency counter. Nodes with no predecessors are submitted to the pool, and when a
+// node finishes it decrements the counters of its successors. Successors hitting zero are submitted, except for the
+// last one which the finishing thread runs itself.
+// Running never allocates. Edges are sorted into a flat array when the graph changes, the first run after adding
+// nodes or dependencies does this work. The graph must be acyclic, which is asserted when it is sorted.
+// xthread_graph_run blocks until every node has run and the calling thread helps. Only one run at a time.
+xt_graph_t* xthread_graph_create(int max_nodes, int max_dependencies);
+void        xthread_graph_destroy(xt_graph_t* graph);
+int         xthread_graph_add_node(xt_graph_t* graph, xt_job_fn fn, void* user_data); // Returns node index
+void        xthread_graph_add_dependency(xt_graph_t* graph, int node, int depends_on);
+void        xthread_graph_run(xt_graph_t* graph, xt_pool_t* pool);
+
+// Epoch based reclamation. Lets realtime readers use shared objects without locks while writers replace them.
+// Readers register once, then wrap each use of shared pointers in enter/exit, which are a couple of atomic ops and
+// never block. Writers swap in a new object with xthread_ebr_publish (or xt_atomic_exchange_ptr + xthread_ebr_retire),
+// and the old object is freed once every reader that could still see it has exited.
+// Nothing is freed until xthread_ebr_collect is called, so call it from a non realtime thread, eg. the GUI timer.
+// Publish, retire and collect may allocate and take a mutex. Enter and exit may not be nested
+//     // Audio thread
+//     xthread_ebr_enter(reader);
+//     struct filter_table* table = xt_atomic_load_explicit_ptr(&g_table, xt_memory_order_acquire);
+//     ...
+//     xthread_ebr_exit(reader);
+//     // GUI thread
+//     xthread_ebr_publish(ebr, &g_table, new_table, free_table, NULL);
+//     xthread_ebr_collect(ebr);
+typedef void (*xt_ebr_free_fn)(void* ctx, void* ptr);
+xt_ebr_t*        xthread_ebr_create(int max_readers);
+void             xthread_ebr_destroy(xt_ebr_t* ebr); // Frees everything still retired
+xt_ebr_reader_t* xthread_ebr_register(xt_ebr_t* ebr); // Returns NULL when max_readers are registered
+void             xthread_ebr_unregister(xt_ebr_t* ebr, xt_ebr_reader_t* reader);
+void             xthread_ebr_enter(xt_ebr_reader_t* reader);
+void             xthread_ebr_exit(xt_ebr_reader_t* reader);
+void             xthread_ebr_retire(xt_ebr_t* ebr, void* ptr, xt_ebr_free_fn free_fn, void* ctx);
+void*            xthread_ebr_publish(xt_ebr_t* ebr, xt_atomic_ptr_t* ptr, void* obj, xt_ebr_free_fn free_fn, void* ctx);
+int              xthread_ebr_collect(xt_ebr_t* ebr); // Returns the number of objects freed
+
+// Statistics counter for hot paths, eg. blocks processed or bytes loaded. Each thread is handed a shard the first time
+// it adds to any counter, and shards sit on cache lines of their own, so threads adding at the same time don't bounce
+// a line between cores. Adds are relaxed. Threads beyond XTHREAD_COUNTER_SHARDS share shards, which is still correct.
+// Reading sums every shard, so it costs a cache miss per shard and is a snapshot that may miss adds in flight.
+// Reset races with adds in flight. ~1KB each, don't make thousands
+#ifndef XTHREAD_COUNTER_SHARDS
+#define XTHREAD_COUNTER_SHARDS 16
+#endif
+void    xt_counter_add(xt_counter_t* counter, int64_t v);
+int64_t xt_counter_read(const xt_counter_t* counter);
+void    xt_counter_reset(xt_counter_t* counter);
+
+// Deadline monitor, for finding out why and where realtime threads miss their deadlines in release builds.
+// Realtime threads register once, then bracket each cycle (eg. an audio callback) with begin/end, passing the time
+// the cycle has, and may mark named zones within it. Reporting reads the clock and writes to a wait free ring owned
+// by the thread, so it never blocks or allocates. The zone taking longest each cycle is remembered.
+// A watchdog thread drains the rings every interval_ms into per thread stats: cycle & overrun counts, the worst
+// cycle and its longest zone, and a histogram of cycle durations (~12% bucket resolution) for percentiles. It also
+// notices cycles that have run past their deadline without ending, eg. a thread stuck in a lock, and reports the zone
+// they're stuck in. Overruns are queued while the monitor is locked, including those found by get_stats/reset_stats,
+// and passed to on_overrun on the watchdog thread once it has unlocked, so on_overrun may call other deadline
+// functions. Past XTHREAD_DEADLINE_RING_SIZE queued overruns per interval the rest are only counted in the stats.
+// Zone and thread names must be string literals or otherwise outlive the monitor.
+// Cycles are dropped and counted if the watchdog falls more than XTHREAD_DEADLINE_RING_SIZE cycles behind
+//     // Audio thread
+//     xthread_deadline_begin(d, block_size * 1000000000ull / sample_rate);
+//     xthread_deadline_zone(d, "synth");
+//     ...
+//     xthread_deadline_zone(d, "reverb");
+//     ...
+//     xthread_deadline_end(d);
+#ifndef XTHREAD_DEADLINE_RING_SIZE
+#define XTHREAD_DEADLINE_RING_SIZE 256
+#endif
+#ifndef XTHREAD_DEADLINE_CLOCK_NS
+#define XTHREAD_DEADLINE_CLOCK_NS() xthread_monotonic_ns() // Override to feed in known times, eg. in tests
+#endif
+#define XTHREAD_DEADLINE_HISTOGRAM_SIZE 496 // 8 buckets per power of 2
+typedef void (*xt_deadline_overrun_fn)(void* ctx, const xt_deadline_overrun_t* overrun);
+xt_deadline_monitor_t* xthread_deadline_monitor_create(int max_threads, int interval_ms, xt_deadline_overrun_fn on_overrun, void* ctx);
+void                   xthread_deadline_monitor_destroy(xt_deadline_monitor_t* monitor);
+xt_deadline_t*         xthread_deadline_register(xt_deadline_monitor_t* monitor, const char* name); // NULL when full
+void                   xthread_deadline_unregister(xt_deadline_monitor_t* monitor, xt_deadline_t* deadline);
+void                   xthread_deadline_begin(xt_deadline_t* deadline, uint64_t deadline_ns);
+void                   xthread_deadline_zone(xt_deadline_t* deadline, const char* zone);
+void                   xthread_deadline_end(xt_deadline_t* deadline);
+// Collects anything the watchdog hasn't yet, then copies out the stats. Any thread
+void xthread_deadline_get_stats(xt_deadline_monitor_t* monitor, xt_deadline_t* deadline, xt_deadline_stats_t* stats);
+void xthread_deadline_reset_stats(xt_deadline_monitor_t* monitor, xt_deadline_t* deadline);
+
 // Progressive backoff spinlock based on Timur Doumler's ADC 2020 talk
 // https://www.youtube.com/watch?v=zrWYJ6FdOFQ
 void xt_spinlock_lock(xt_spinlock_t* ptr);
 bool xt_spinlock_trylock(xt_spinlock_t* ptr);
 void xt_spinlock_unlock(xt_spinlock_t* ptr);
 
+// 4 byte mutex. Uncontended lock & unlock are a single atomic op each. Under contention it spins briefly with the
+// spinlocks backoff, then sleeps on a futex (Linux), WaitOnAddress (Windows) or __ulock_wait (Apple).
+// Not recursive. Not fair.
+void xt_fastmutex_lock(xt_fastmutex_t* mutex);
+bool xt_fastmutex_trylock(xt_fastmutex_t* mutex);
+void xt_fastmutex_unlock(xt_fastmutex_t* mutex);
+
+// Sequence lock. Writers make the sequence odd while writing and even again when done. Readers never write shared
+// memory, they read the sequence, copy the data, and retry if the sequence was odd or has changed. Good for read mostly
+// data where readers must never block, eg. the audio thread reading parameter snapshots the GUI updates.
+// Writers are serialised by the sequence itself. Readers should only copy data out between begin and retry, because
+// they may see torn writes that would be discarded. Copies are data races as far as TSan is concerned
+//     uint32_t seq;
+//     do {
+//         seq = xt_seqlock_read_begin(&lock);
+//         memcpy(&copy, &shared, sizeof(copy));
+//     } while (xt_seqlock_read_retry(&lock, seq));
+uint32_t xt_seqlock_read_begin(xt_seqlock_t* lock);
+bool     xt_seqlock_read_retry(xt_seqlock_t* lock, uint32_t seq);
+void     xt_seqlock_write_begin(xt_seqlock_t* lock);
+void     xt_seqlock_write_end(xt_seqlock_t* lock);
+// Convenience wrappers around the above
+void     xt_seqlock_read(xt_seqlock_t* lock, void* dst, const void* src, size_t size);
+void     xt_seqlock_write(xt_seqlock_t* lock, void* dst, const void* src, size_t size);
+
+// Reader-writer lock with writer preference. Once a writer is waiting new readers block until it has had its turn, so
+// a steady stream of readers can't starve writers. Spins briefly, then sleeps with xt_atomic_wait_u32. Not recursive.
+void xt_rwlock_read_lock(xt_rwlock_t* lock);
+void xt_rwlock_read_unlock(xt_rwlock_t* lock);
+void xt_rwlock_write_lock(xt_rwlock_t* lock);
+void xt_rwlock_write_unlock(xt_rwlock_t* lock);
+
+// Fair spinlocks, locked in the order threads arrive. Both can count acquisitions, acquisitions that had to wait, and
+// the total time spent waiting. Pass NULL stats to skip the bookkeeping. Stats are updated while holding the lock, so
+// they cost nothing extra to synchronise. Read them with relaxed loads at any time.
+// Ticket lock: two 32 bit counters and the stats pointer, 16 bytes on 64 bit. Waiters spin on one shared counter,
+// with backoff proportional to their place in line. Fine for a handful of threads.
+// MCS lock: each waiter spins on its own cache line in a node it passes in, and the holder hands over to the next node
+// directly, so waiting threads don't fight over one line. Scales to many cores. The node must stay alive and be passed
+// to unlock.
+struct xt_lock_stats_t
+{
+    xt_atomic_uint64_t acquisitions;
+    xt_atomic_uint64_t contended;
+    xt_atomic_uint64_t wait_ns;
+};
+
+void xt_ticketlock_init(xt_ticketlock_t* lock, xt_lock_stats_t* stats);
+void xt_ticketlock_lock(xt_ticketlock_t* lock);
+bool xt_ticketlock_trylock(xt_ticketlock_t* lock);
+void xt_ticketlock_unlock(xt_ticketlock_t* lock);
+
+void xt_mcslock_init(xt_mcslock_t* lock, xt_lock_stats_t* stats);
+void xt_mcslock_lock(xt_mcslock_t* lock, xt_mcs_node_t* node);
+void xt_mcslock_unlock(xt_mcslock_t* lock, xt_mcs_node_t* node);
+
 union xt_mutex_t
 {
     void* align;
@@ -238,6 +756,55 @@ union xt_timer_t
     char  d[8];
 };
 
+enum xt_sched_policy
+{
+    XTHREAD_SCHED_DEFAULT, // Inherit from the creating thread
+    XTHREAD_SCHED_FIFO,    // Windows: THREAD_PRIORITY_TIME_CRITICAL
+    XTHREAD_SCHED_RR,      // Windows: THREAD_PRIORITY_HIGHEST
+};
+
+struct xt_deadline_stats_t
+{
+    uint64_t    cycles;
+    uint64_t    overruns;
+    uint64_t    dropped;     // Cycles lost because the ring was full
+    uint64_t    hangs;       // Cycles seen running past their deadline by the watchdog
+    uint64_t    worst_ns;    // Longest cycle
+    uint64_t    worst_deadline_ns;
+    const char* worst_zone;  // Longest zone in the longest cycle. NULL for time outside any zone
+    uint64_t    worst_zone_ns;
+    uint64_t    p50_ns;      // Percentiles are bucket upper bounds
+    uint64_t    p99_ns;
+    uint64_t    p999_ns;
+};
+
+struct xt_deadline_overrun_t
+{
+    const char* thread_name;
+    uint64_t    duration_ns; // If still_running, how long it has been running so far
+    uint64_t    deadline_ns;
+    const char* zone;        // Longest zone, or the zone it's in if still_running
+    uint64_t    zone_ns;
+    bool        still_running;
+};
+
+struct xt_thread_options_t
+{
+    int         stack_size;     // XTHREAD_STACK_SIZE_DEFAULT or bytes. Rounded up to the platforms minimum
+    const char* name;           // Optional
+    uint64_t    affinity_mask;  // 0 runs on any core. See xthread_set_affinity()
+    int         sched_policy;   // enum xt_sched_policy
+    int         sched_priority; // For FIFO/RR. Clamped to the range the OS allows. Ignored on Windows
+};
+
+struct xt_realtime_t
+{
+    int  sched_policy;   // enum xt_sched_policy actually granted. XTHREAD_SCHED_DEFAULT if realtime was refused
+    int  sched_priority; // Granted priority
+    int  nice;           // Niceness of the thread when realtime was refused
+    bool memory_locked;
+};
+
 struct xt_queue_t
 {
     xt_signal_t       data_ready;
@@ -255,12 +822,685 @@ struct xt_queue_t
 #endif
 };
 
+struct xt_ticketlock_t
+{
+    xt_atomic_uint32_t next;
+    xt_atomic_uint32_t serving;
+    xt_lock_stats_t*   stats;
+};
+
+struct xt_mcs_node_t
+{
+    xt_atomic_ptr_t    next;
+    xt_atomic_uint32_t locked;
+    char               pad[XTHREAD_CACHE_LINE_SIZE - sizeof(void*) - sizeof(uint32_t)];
+};
+
+struct xt_mcslock_t
+{
+    xt_atomic_ptr_t  tail;
+    xt_lock_stats_t* stats;
+};
+
+struct xt_rwlock_t
+{
+    xt_atomic_uint32_t state; // Number of readers, or XTHREAD_RWLOCK_WRITER
+    xt_atomic_uint32_t writers_waiting;
+    xt_atomic_uint32_t generation; // Sleepers wait on this rather than 'state', which can change and change back
+    xt_atomic_uint32_t num_sleeping;
+};
+
+struct xt_semaphore_t
+{
+    xt_atomic_uint32_t count;
+    xt_atomic_uint32_t num_waiters;
+};
+
+struct xt_barrier_t
+{
+    xt_atomic_uint32_t arrived;
+    uint32_t           count;
+    char               pad0[XTHREAD_CACHE_LINE_SIZE - 2 * sizeof(uint32_t)];
+    xt_atomic_uint32_t generation; // Watched by waiters, on its own line so arrivals don't disturb them
+    xt_atomic_uint32_t num_sleeping;
+    char               pad1[XTHREAD_CACHE_LINE_SIZE - 2 * sizeof(uint32_t)];
+};
+
+struct xt_latch_t
+{
+    xt_atomic_uint32_t count;
+    xt_atomic_uint32_t num_sleeping;
+};
+
+struct xt_mpmc_cell_t
+{
+    xt_atomic_uint64_t sequence;
+    void*              value;
+};
+
+struct xt_mpmc_queue_t
+{
+    xt_mpmc_cell_t*    cells;
+    uint64_t           mask;
+    char               pad0[XTHREAD_CACHE_LINE_SIZE - sizeof(void*) - sizeof(uint64_t)];
+    xt_atomic_uint64_t enqueue_pos;
+    char               pad1[XTHREAD_CACHE_LINE_SIZE - sizeof(uint64_t)];
+    xt_atomic_uint64_t dequeue_pos;
+    char               pad2[XTHREAD_CACHE_LINE_SIZE - sizeof(uint64_t)];
+    xt_signal_t        data_ready;
+    xt_signal_t        space_open;
+};
+
+struct xt_spsc_ring_t
+{
+    char*              buffer;
+    uint32_t           stride;
+    uint32_t           mask;
+    char               pad0[XTHREAD_CACHE_LINE_SIZE - sizeof(char*) - 2 * sizeof(uint32_t)];
+    // Producer
+    xt_atomic_uint32_t tail;
+    uint32_t           cached_head;
+    char               pad1[XTHREAD_CACHE_LINE_SIZE - 2 * sizeof(uint32_t)];
+    // Consumer
+    xt_atomic_uint32_t head;
+    uint32_t           cached_tail;
+    char               pad2[XTHREAD_CACHE_LINE_SIZE - 2 * sizeof(uint32_t)];
+};
+
+struct xt_triple_buffer_t
+{
+    char*              buffers;
+    uint32_t           stride;
+    char               pad0[XTHREAD_CACHE_LINE_SIZE - sizeof(char*) - sizeof(uint32_t)];
+    xt_atomic_uint32_t middle; // Buffer index | XTHREAD_TRIPLE_BUFFER_NEW
+    char               pad1[XTHREAD_CACHE_LINE_SIZE - sizeof(uint32_t)];
+    uint32_t           back; // Writer only
+    char               pad2[XTHREAD_CACHE_LINE_SIZE - sizeof(uint32_t)];
+    uint32_t           front; // Reader only
+    char               pad3[XTHREAD_CACHE_LINE_SIZE - sizeof(uint32_t)];
+};
+
+struct xt_stack_node_t
+{
+    xt_stack_node_t* next;
+};
+
+struct xt_stack_t
+{
+#ifdef XTHREAD_HAS_CAS128
+    xt_atomic_uint128_t head; // lo: xt_stack_node_t*, hi: tag
+#else
+    xt_stack_node_t* head; // Guarded by lock
+    xt_spinlock_t    lock;
+#endif
+};
+
+struct xt_freelist_t
+{
+    xt_stack_t stack;
+};
+
+struct xt_mpsc_node_t
+{
+    xt_atomic_ptr_t next;
+};
+
+struct xt_mpsc_queue_t
+{
+    xt_atomic_ptr_t head; // Producers
+    char            pad0[XTHREAD_CACHE_LINE_SIZE - sizeof(void*)];
+    xt_mpsc_node_t* tail; // Consumer
+    xt_mpsc_node_t  stub;
+    char            pad1[XTHREAD_CACHE_LINE_SIZE - 2 * sizeof(void*)];
+};
+
+struct xt_counter_t
+{
+    struct
+    {
+        xt_atomic_int64_t value;
+        char              pad[XTHREAD_CACHE_LINE_SIZE - sizeof(int64_t)];
+    } shards[XTHREAD_COUNTER_SHARDS];
+};
+
+struct xt_job_t
+{
+    xt_job_fn         fn;
+    void*             user_data;
+    xt_job_t*         parent;
+    xt_atomic_int32_t unfinished; // 1 for itself + 1 for each child still running
+    uint32_t          flags;      // Set by submit
+};
+
 #ifdef __cplusplus
 }
 #endif
 
 #endif /* XHL_THREAD_H */
 
+#if !defined(XHL_THREAD_ATOMIC_DEFINED) && (!defined(XTHREAD_ATOMIC_NOINLINE) || defined(XHL_THREAD_IMPL))
+#define XHL_THREAD_ATOMIC_DEFINED
+
+#if defined(_MSC_VER) && !(__clang__)
+#include <intrin.h>
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_load_u8 (const xt_atomic_uint8_t*  ptr) { return _InterlockedCompareExchange8 ((xt_atomic_int8_t*)ptr, 0, 0); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_load_u16(const xt_atomic_uint16_t* ptr) { return _InterlockedCompareExchange16((xt_atomic_int16_t*)ptr, 0, 0); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_load_u32(const xt_atomic_uint32_t* ptr) { return _InterlockedCompareExchange((xt_atomic_int32_t*)ptr, 0, 0); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_load_u64(const xt_atomic_uint64_t* ptr) { return _InterlockedCompareExchange64(ptr, 0, 0); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_load_i8 (const xt_atomic_int8_t*   ptr) { return _InterlockedCompareExchange8 (ptr, 0, 0); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_load_i16(const xt_atomic_int16_t*  ptr) { return _InterlockedCompareExchange16(ptr, 0, 0); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_load_i32(const xt_atomic_int32_t*  ptr) { return _InterlockedCompareExchange(ptr, 0, 0); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_load_i64(const xt_atomic_int64_t*  ptr) { return _InterlockedCompareExchange64(ptr, 0, 0); }
+
+XTHREAD_ATOMIC_API void xt_atomic_store_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v) { _InterlockedExchange8(ptr, v); }
+XTHREAD_ATOMIC_API void xt_atomic_store_u16(xt_atomic_uint16_t* ptr, uint16_t v) { _InterlockedExchange16(ptr, v); }
+XTHREAD_ATOMIC_API void xt_atomic_store_u32(xt_atomic_uint32_t* ptr, uint32_t v) { _InterlockedExchange(ptr, v); }
+XTHREAD_ATOMIC_API void xt_atomic_store_u64(xt_atomic_uint64_t* ptr, uint64_t v) { _InterlockedExchange64(ptr, v); }
+XTHREAD_ATOMIC_API void xt_atomic_store_i8 (xt_atomic_int8_t*   ptr, int8_t   v) { _InterlockedExchange8(ptr, v); }
+XTHREAD_ATOMIC_API void xt_atomic_store_i16(xt_atomic_int16_t*  ptr, int16_t  v) { _InterlockedExchange16(ptr, v); }
+XTHREAD_ATOMIC_API void xt_atomic_store_i32(xt_atomic_int32_t*  ptr, int32_t  v) { _InterlockedExchange(ptr, v); }
+XTHREAD_ATOMIC_API void xt_atomic_store_i64(xt_atomic_int64_t*  ptr, int64_t  v) { _InterlockedExchange64(ptr, v); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_exchange_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v) { return _InterlockedExchange8(ptr, v); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_exchange_u16(xt_atomic_uint16_t* ptr, uint16_t v) { return _InterlockedExchange16(ptr, v); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_exchange_u32(xt_atomic_uint32_t* ptr, uint32_t v) { return _InterlockedExchange(ptr, v); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_exchange_u64(xt_atomic_uint64_t* ptr, uint64_t v) { return _InterlockedExchange64(ptr, v); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_exchange_i8 (xt_atomic_int8_t*   ptr, int8_t   v) { return _InterlockedExchange8(ptr, v); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_exchange_i16(xt_atomic_int16_t*  ptr, int16_t  v) { return _InterlockedExchange16(ptr, v); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_exchange_i32(xt_atomic_int32_t*  ptr, int32_t  v) { return _InterlockedExchange(ptr, v); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_exchange_i64(xt_atomic_int64_t*  ptr, int64_t  v) { return _InterlockedExchange64(ptr, v); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_fetch_add_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v) { return _InterlockedExchangeAdd8(ptr, v); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_add_u16(xt_atomic_uint16_t* ptr, uint16_t v) { return _InterlockedExchangeAdd16(ptr, v); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_add_u32(xt_atomic_uint32_t* ptr, uint32_t v) { return _InterlockedExchangeAdd(ptr, v); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_add_u64(xt_atomic_uint64_t* ptr, uint64_t v) { return _InterlockedExchangeAdd64(ptr, v); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_fetch_add_i8 (xt_atomic_int8_t*   ptr, int8_t   v) { return _InterlockedExchangeAdd8(ptr, v); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_fetch_add_i16(xt_atomic_int16_t*  ptr, int16_t  v) { return _InterlockedExchangeAdd16(ptr, v); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_fetch_add_i32(xt_atomic_int32_t*  ptr, int32_t  v) { return _InterlockedExchangeAdd(ptr, v); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_fetch_add_i64(xt_atomic_int64_t*  ptr, int64_t  v) { return _InterlockedExchangeAdd64(ptr, v); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_fetch_sub_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v) { return xt_atomic_fetch_add_u8 (ptr, -v); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_sub_u16(xt_atomic_uint16_t* ptr, uint16_t v) { return xt_atomic_fetch_add_u16(ptr, -v); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_sub_u32(xt_atomic_uint32_t* ptr, uint32_t v) { return xt_atomic_fetch_add_u32(ptr, -v); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_sub_u64(xt_atomic_uint64_t* ptr, uint64_t v) { return xt_atomic_fetch_add_u64(ptr, -v); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_fetch_sub_i8 (xt_atomic_int8_t*   ptr, int8_t   v) { return xt_atomic_fetch_add_i8 (ptr, -v); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_fetch_sub_i16(xt_atomic_int16_t*  ptr, int16_t  v) { return xt_atomic_fetch_add_i16(ptr, -v); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_fetch_sub_i32(xt_atomic_int32_t*  ptr, int32_t  v) { return xt_atomic_fetch_add_i32(ptr, -v); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_fetch_sub_i64(xt_atomic_int64_t*  ptr, int64_t  v) { return xt_atomic_fetch_add_i64(ptr, -v); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_fetch_and_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v) { return _InterlockedAnd8(ptr, v); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_and_u16(xt_atomic_uint16_t* ptr, uint16_t v) { return _InterlockedAnd16(ptr, v); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_and_u32(xt_atomic_uint32_t* ptr, uint32_t v) { return _InterlockedAnd(ptr, v); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_and_u64(xt_atomic_uint64_t* ptr, uint64_t v) { return _InterlockedAnd64(ptr, v); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_fetch_and_i8 (xt_atomic_int8_t*   ptr, int8_t   v) { return _InterlockedAnd8(ptr, v); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_fetch_and_i16(xt_atomic_int16_t*  ptr, int16_t  v) { return _InterlockedAnd16(ptr, v); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_fetch_and_i32(xt_atomic_int32_t*  ptr, int32_t  v) { return _InterlockedAnd(ptr, v); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_fetch_and_i64(xt_atomic_int64_t*  ptr, int64_t  v) { return _InterlockedAnd64(ptr, v); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_fetch_or_u8 (xt_atomic_uint8_t* ptr, uint8_t  v) { return _InterlockedOr8(ptr, v); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_or_u16(xt_atomic_uint16_t*ptr, uint16_t v) { return _InterlockedOr16(ptr, v); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_or_u32(xt_atomic_uint32_t*ptr, uint32_t v) { return _InterlockedOr(ptr, v); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_or_u64(xt_atomic_uint64_t*ptr, uint64_t v) { return _InterlockedOr64(ptr, v); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_fetch_or_i8 (xt_atomic_int8_t*ptr,   int8_t   v) { return _InterlockedOr8(ptr, v); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_fetch_or_i16(xt_atomic_int16_t*ptr,  int16_t  v) { return _InterlockedOr16(ptr, v); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_fetch_or_i32(xt_atomic_int32_t*ptr,  int32_t  v) { return _InterlockedOr(ptr, v); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_fetch_or_i64(xt_atomic_int64_t*ptr,  int64_t  v) { return _InterlockedOr64(ptr, v); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_fetch_xor_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v) { return _InterlockedXor8(ptr, v); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_xor_u16(xt_atomic_uint16_t* ptr, uint16_t v) { return _InterlockedXor16(ptr, v); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_xor_u32(xt_atomic_uint32_t* ptr, uint32_t v) { return _InterlockedXor(ptr, v); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_xor_u64(xt_atomic_uint64_t* ptr, uint64_t v) { return _InterlockedXor64(ptr, v); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_fetch_xor_i8 (xt_atomic_int8_t*   ptr, int8_t   v) { return _InterlockedXor8(ptr, v); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_fetch_xor_i16(xt_atomic_int16_t*  ptr, int16_t  v) { return _InterlockedXor16(ptr, v); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_fetch_xor_i32(xt_atomic_int32_t*  ptr, int32_t  v) { return _InterlockedXor(ptr, v); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_fetch_xor_i64(xt_atomic_int64_t*  ptr, int64_t  v) { return _InterlockedXor64(ptr, v); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_compare_exchange_u8 (xt_atomic_uint8_t*  ptr, uint8_t  expected, uint8_t  desired) { return _InterlockedCompareExchange8 (ptr, desired, expected); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_compare_exchange_u16(xt_atomic_uint16_t* ptr, uint16_t expected, uint16_t desired) { return _InterlockedCompareExchange16(ptr, desired, expected); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_compare_exchange_u32(xt_atomic_uint32_t* ptr, uint32_t expected, uint32_t desired) { return _InterlockedCompareExchange  (ptr, desired, expected); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_compare_exchange_u64(xt_atomic_uint64_t* ptr, uint64_t expected, uint64_t desired) { return _InterlockedCompareExchange64(ptr, desired, expected); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_compare_exchange_i8 (xt_atomic_int8_t*   ptr, int8_t   expected, int8_t   desired) { return _InterlockedCompareExchange8 (ptr, desired, expected); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_compare_exchange_i16(xt_atomic_int16_t*  ptr, int16_t  expected, int16_t  desired) { return _InterlockedCompareExchange16(ptr, desired, expected); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_compare_exchange_i32(xt_atomic_int32_t*  ptr, int32_t  expected, int32_t  desired) { return _InterlockedCompareExchange  (ptr, desired, expected); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_compare_exchange_i64(xt_atomic_int64_t*  ptr, int64_t  expected, int64_t  desired) { return _InterlockedCompareExchange64(ptr, desired, expected); }
+
+// On x86/x64, interlocked RMW ops are full barriers, so the memory order only matters for loads and stores. Aligned
+// loads have acquire semantics and aligned stores have release semantics, as long as the compiler doesn't reorder them.
+// ARM64 has acquiring/releasing loads and stores and weaker interlocked variants. 32 bit ARM falls back to the seq_cst ops
+#if defined(_M_X64) || defined(_M_IX86)
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_load_explicit_u8 (const xt_atomic_uint8_t*  ptr, enum xt_memory_order o) { (void)o; uint8_t v = *ptr; _ReadWriteBarrier(); return v; }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_load_explicit_u16(const xt_atomic_uint16_t* ptr, enum xt_memory_order o) { (void)o; uint16_t v = *ptr; _ReadWriteBarrier(); return v; }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_load_explicit_u32(const xt_atomic_uint32_t* ptr, enum xt_memory_order o) { (void)o; uint32_t v = *ptr; _ReadWriteBarrier(); return v; }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_load_explicit_i8 (const xt_atomic_int8_t*   ptr, enum xt_memory_order o) { (void)o; int8_t v = *ptr; _ReadWriteBarrier(); return v; }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_load_explicit_i16(const xt_atomic_int16_t*  ptr, enum xt_memory_order o) { (void)o; int16_t v = *ptr; _ReadWriteBarrier(); return v; }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_load_explicit_i32(const xt_atomic_int32_t*  ptr, enum xt_memory_order o) { (void)o; int32_t v = *ptr; _ReadWriteBarrier(); return v; }
+
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v, enum xt_memory_order o) { if (o == xt_memory_order_seq_cst) xt_atomic_store_u8(ptr, v); else { _ReadWriteBarrier(); *ptr = v; } }
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t v, enum xt_memory_order o) { if (o == xt_memory_order_seq_cst) xt_atomic_store_u16(ptr, v); else { _ReadWriteBarrier(); *ptr = v; } }
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t v, enum xt_memory_order o) { if (o == xt_memory_order_seq_cst) xt_atomic_store_u32(ptr, v); else { _ReadWriteBarrier(); *ptr = v; } }
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   v, enum xt_memory_order o) { if (o == xt_memory_order_seq_cst) xt_atomic_store_i8(ptr, v); else { _ReadWriteBarrier(); *ptr = v; } }
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  v, enum xt_memory_order o) { if (o == xt_memory_order_seq_cst) xt_atomic_store_i16(ptr, v); else { _ReadWriteBarrier(); *ptr = v; } }
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  v, enum xt_memory_order o) { if (o == xt_memory_order_seq_cst) xt_atomic_store_i32(ptr, v); else { _ReadWriteBarrier(); *ptr = v; } }
+
+#if defined(_M_X64)
+XTHREAD_ATOMIC_API uint64_t xt_atomic_load_explicit_u64(const xt_atomic_uint64_t* ptr, enum xt_memory_order o) { (void)o; uint64_t v = *ptr; _ReadWriteBarrier(); return v; }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_load_explicit_i64(const xt_atomic_int64_t*  ptr, enum xt_memory_order o) { (void)o; int64_t v = *ptr; _ReadWriteBarrier(); return v; }
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t v, enum xt_memory_order o) { if (o == xt_memory_order_seq_cst) xt_atomic_store_u64(ptr, v); else { _ReadWriteBarrier(); *ptr = v; } }
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  v, enum xt_memory_order o) { if (o == xt_memory_order_seq_cst) xt_atomic_store_i64(ptr, v); else { _ReadWriteBarrier(); *ptr = v; } }
+#else
+// Plain 64 bit loads and stores can tear on 32 bit x86, so use the interlocked ops
+XTHREAD_ATOMIC_API uint64_t xt_atomic_load_explicit_u64(const xt_atomic_uint64_t* ptr, enum xt_memory_order o) { (void)o; return xt_atomic_load_u64(ptr); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_load_explicit_i64(const xt_atomic_int64_t*  ptr, enum xt_memory_order o) { (void)o; return xt_atomic_load_i64(ptr); }
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t v, enum xt_memory_order o) { (void)o; xt_atomic_store_u64(ptr, v); }
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  v, enum xt_memory_order o) { (void)o; xt_atomic_store_i64(ptr, v); }
+#endif
+
+XTHREAD_ATOMIC_API void xt_atomic_thread_fence(enum xt_memory_order o) { if (o == xt_memory_order_seq_cst) _mm_mfence(); else _ReadWriteBarrier(); }
+#elif defined(_M_ARM64)
+// LDAR/STLR are acquire/release, and ARMv8 orders a STLR before a later LDAR, so they also cover seq_cst
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_load_explicit_u8 (const xt_atomic_uint8_t*  ptr, enum xt_memory_order o) { return o == xt_memory_order_relaxed ? (uint8_t)__iso_volatile_load8((const volatile __int8*)ptr) : (uint8_t)__ldar8((volatile unsigned __int8*)ptr); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_load_explicit_u16(const xt_atomic_uint16_t* ptr, enum xt_memory_order o) { return o == xt_memory_order_relaxed ? (uint16_t)__iso_volatile_load16((const volatile __int16*)ptr) : (uint16_t)__ldar16((volatile unsigned __int16*)ptr); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_load_explicit_u32(const xt_atomic_uint32_t* ptr, enum xt_memory_order o) { return o == xt_memory_order_relaxed ? (uint32_t)__iso_volatile_load32((const volatile __int32*)ptr) : (uint32_t)__ldar32((volatile unsigned __int32*)ptr); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_load_explicit_u64(const xt_atomic_uint64_t* ptr, enum xt_memory_order o) { return o == xt_memory_order_relaxed ? (uint64_t)__iso_volatile_load64((const volatile __int64*)ptr) : (uint64_t)__ldar64((volatile unsigned __int64*)ptr); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_load_explicit_i8 (const xt_atomic_int8_t*   ptr, enum xt_memory_order o) { return o == xt_memory_order_relaxed ? (int8_t)__iso_volatile_load8((const volatile __int8*)ptr) : (int8_t)__ldar8((volatile unsigned __int8*)ptr); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_load_explicit_i16(const xt_atomic_int16_t*  ptr, enum xt_memory_order o) { return o == xt_memory_order_relaxed ? (int16_t)__iso_volatile_load16((const volatile __int16*)ptr) : (int16_t)__ldar16((volatile unsigned __int16*)ptr); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_load_explicit_i32(const xt_atomic_int32_t*  ptr, enum xt_memory_order o) { return o == xt_memory_order_relaxed ? (int32_t)__iso_volatile_load32((const volatile __int32*)ptr) : (int32_t)__ldar32((volatile unsigned __int32*)ptr); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_load_explicit_i64(const xt_atomic_int64_t*  ptr, enum xt_memory_order o) { return o == xt_memory_order_relaxed ? (int64_t)__iso_volatile_load64((const volatile __int64*)ptr) : (int64_t)__ldar64((volatile unsigned __int64*)ptr); }
+
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v, enum xt_memory_order o) { if (o == xt_memory_order_relaxed) __iso_volatile_store8((volatile __int8*)ptr, (__int8)v); else __stlr8((volatile unsigned __int8*)ptr, (unsigned __int8)v); }
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t v, enum xt_memory_order o) { if (o == xt_memory_order_relaxed) __iso_volatile_store16((volatile __int16*)ptr, (__int16)v); else __stlr16((volatile unsigned __int16*)ptr, (unsigned __int16)v); }
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t v, enum xt_memory_order o) { if (o == xt_memory_order_relaxed) __iso_volatile_store32((volatile __int32*)ptr, (__int32)v); else __stlr32((volatile unsigned __int32*)ptr, (unsigned __int32)v); }
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t v, enum xt_memory_order o) { if (o == xt_memory_order_relaxed) __iso_volatile_store64((volatile __int64*)ptr, (__int64)v); else __stlr64((volatile unsigned __int64*)ptr, (unsigned __int64)v); }
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   v, enum xt_memory_order o) { if (o == xt_memory_order_relaxed) __iso_volatile_store8((volatile __int8*)ptr, (__int8)v); else __stlr8((volatile unsigned __int8*)ptr, (unsigned __int8)v); }
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  v, enum xt_memory_order o) { if (o == xt_memory_order_relaxed) __iso_volatile_store16((volatile __int16*)ptr, (__int16)v); else __stlr16((volatile unsigned __int16*)ptr, (unsigned __int16)v); }
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  v, enum xt_memory_order o) { if (o == xt_memory_order_relaxed) __iso_volatile_store32((volatile __int32*)ptr, (__int32)v); else __stlr32((volatile unsigned __int32*)ptr, (unsigned __int32)v); }
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  v, enum xt_memory_order o) { if (o == xt_memory_order_relaxed) __iso_volatile_store64((volatile __int64*)ptr, (__int64)v); else __stlr64((volatile unsigned __int64*)ptr, (unsigned __int64)v); }
+
+XTHREAD_ATOMIC_API void xt_atomic_thread_fence(enum xt_memory_order o)
+{
+    if (o == xt_memory_order_acquire || o == xt_memory_order_consume)
+        __dmb(_ARM64_BARRIER_ISHLD);
+    else if (o != xt_memory_order_relaxed)
+        __dmb(_ARM64_BARRIER_ISH);
+}
+#else
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_load_explicit_u8 (const xt_atomic_uint8_t*  ptr, enum xt_memory_order o) { (void)o; return xt_atomic_load_u8(ptr); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_load_explicit_u16(const xt_atomic_uint16_t* ptr, enum xt_memory_order o) { (void)o; return xt_atomic_load_u16(ptr); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_load_explicit_u32(const xt_atomic_uint32_t* ptr, enum xt_memory_order o) { (void)o; return xt_atomic_load_u32(ptr); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_load_explicit_u64(const xt_atomic_uint64_t* ptr, enum xt_memory_order o) { (void)o; return xt_atomic_load_u64(ptr); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_load_explicit_i8 (const xt_atomic_int8_t*   ptr, enum xt_memory_order o) { (void)o; return xt_atomic_load_i8(ptr); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_load_explicit_i16(const xt_atomic_int16_t*  ptr, enum xt_memory_order o) { (void)o; return xt_atomic_load_i16(ptr); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_load_explicit_i32(const xt_atomic_int32_t*  ptr, enum xt_memory_order o) { (void)o; return xt_atomic_load_i32(ptr); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_load_explicit_i64(const xt_atomic_int64_t*  ptr, enum xt_memory_order o) { (void)o; return xt_atomic_load_i64(ptr); }
+
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v, enum xt_memory_order o) { (void)o; xt_atomic_store_u8(ptr, v); }
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t v, enum xt_memory_order o) { (void)o; xt_atomic_store_u16(ptr, v); }
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t v, enum xt_memory_order o) { (void)o; xt_atomic_store_u32(ptr, v); }
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t v, enum xt_memory_order o) { (void)o; xt_atomic_store_u64(ptr, v); }
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   v, enum xt_memory_order o) { (void)o; xt_atomic_store_i8(ptr, v); }
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  v, enum xt_memory_order o) { (void)o; xt_atomic_store_i16(ptr, v); }
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  v, enum xt_memory_order o) { (void)o; xt_atomic_store_i32(ptr, v); }
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  v, enum xt_memory_order o) { (void)o; xt_atomic_store_i64(ptr, v); }
+
+XTHREAD_ATOMIC_API void xt_atomic_thread_fence(enum xt_memory_order o) { (void)o; __dmb(_ARM_BARRIER_ISH); }
+#endif
+
+#if defined(_M_ARM64)
+// ARM64 has relaxed (_nf), acquire (_acq) and release (_rel) variants of the interlocked intrinsics
+#define XTHREAD_INTERLOCKED_EXPLICIT(fn, o, ...)                                                   \
+    ((o) == xt_memory_order_relaxed                                  ? fn##_nf(__VA_ARGS__)  :     \
+     (o) == xt_memory_order_acquire || (o) == xt_memory_order_consume ? fn##_acq(__VA_ARGS__) :     \
+     (o) == xt_memory_order_release                                  ? fn##_rel(__VA_ARGS__) :     \
+                                                                       fn(__VA_ARGS__))
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_exchange_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedExchange8, o, ptr, v); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_exchange_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedExchange16, o, ptr, v); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_exchange_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedExchange, o, ptr, v); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_exchange_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedExchange64, o, ptr, v); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_exchange_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedExchange8, o, ptr, v); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_exchange_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedExchange16, o, ptr, v); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_exchange_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedExchange, o, ptr, v); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_exchange_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedExchange64, o, ptr, v); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_fetch_add_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedExchangeAdd8, o, ptr, v); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_add_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedExchangeAdd16, o, ptr, v); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_add_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedExchangeAdd, o, ptr, v); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_add_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedExchangeAdd64, o, ptr, v); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_fetch_add_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedExchangeAdd8, o, ptr, v); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_fetch_add_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedExchangeAdd16, o, ptr, v); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_fetch_add_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedExchangeAdd, o, ptr, v); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_fetch_add_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedExchangeAdd64, o, ptr, v); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_fetch_sub_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedExchangeAdd8, o, ptr, -v); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_sub_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedExchangeAdd16, o, ptr, -v); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_sub_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedExchangeAdd, o, ptr, -v); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_sub_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedExchangeAdd64, o, ptr, -v); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_fetch_sub_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedExchangeAdd8, o, ptr, -v); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_fetch_sub_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedExchangeAdd16, o, ptr, -v); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_fetch_sub_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedExchangeAdd, o, ptr, -v); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_fetch_sub_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedExchangeAdd64, o, ptr, -v); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_fetch_and_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedAnd8, o, ptr, v); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_and_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedAnd16, o, ptr, v); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_and_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedAnd, o, ptr, v); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_and_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedAnd64, o, ptr, v); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_fetch_and_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedAnd8, o, ptr, v); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_fetch_and_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedAnd16, o, ptr, v); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_fetch_and_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedAnd, o, ptr, v); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_fetch_and_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedAnd64, o, ptr, v); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_fetch_or_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedOr8, o, ptr, v); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_or_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedOr16, o, ptr, v); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_or_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedOr, o, ptr, v); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_or_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedOr64, o, ptr, v); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_fetch_or_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedOr8, o, ptr, v); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_fetch_or_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedOr16, o, ptr, v); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_fetch_or_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedOr, o, ptr, v); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_fetch_or_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedOr64, o, ptr, v); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_fetch_xor_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedXor8, o, ptr, v); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_xor_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedXor16, o, ptr, v); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_xor_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedXor, o, ptr, v); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_xor_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedXor64, o, ptr, v); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_fetch_xor_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedXor8, o, ptr, v); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_fetch_xor_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedXor16, o, ptr, v); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_fetch_xor_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedXor, o, ptr, v); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_fetch_xor_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  v, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedXor64, o, ptr, v); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_compare_exchange_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  expected, uint8_t  desired, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedCompareExchange8, o, ptr, desired, expected); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_compare_exchange_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t expected, uint16_t desired, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedCompareExchange16, o, ptr, desired, expected); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_compare_exchange_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t expected, uint32_t desired, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedCompareExchange, o, ptr, desired, expected); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_compare_exchange_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t expected, uint64_t desired, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedCompareExchange64, o, ptr, desired, expected); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_compare_exchange_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   expected, int8_t   desired, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedCompareExchange8, o, ptr, desired, expected); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_compare_exchange_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  expected, int16_t  desired, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedCompareExchange16, o, ptr, desired, expected); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_compare_exchange_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  expected, int32_t  desired, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedCompareExchange, o, ptr, desired, expected); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_compare_exchange_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  expected, int64_t  desired, enum xt_memory_order o) { return XTHREAD_INTERLOCKED_EXPLICIT(_InterlockedCompareExchange64, o, ptr, desired, expected); }
+
+#undef XTHREAD_INTERLOCKED_EXPLICIT
+#else
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_exchange_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v, enum xt_memory_order o) { (void)o; return xt_atomic_exchange_u8(ptr, v); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_exchange_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t v, enum xt_memory_order o) { (void)o; return xt_atomic_exchange_u16(ptr, v); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_exchange_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t v, enum xt_memory_order o) { (void)o; return xt_atomic_exchange_u32(ptr, v); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_exchange_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t v, enum xt_memory_order o) { (void)o; return xt_atomic_exchange_u64(ptr, v); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_exchange_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   v, enum xt_memory_order o) { (void)o; return xt_atomic_exchange_i8(ptr, v); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_exchange_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  v, enum xt_memory_order o) { (void)o; return xt_atomic_exchange_i16(ptr, v); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_exchange_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  v, enum xt_memory_order o) { (void)o; return xt_atomic_exchange_i32(ptr, v); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_exchange_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  v, enum xt_memory_order o) { (void)o; return xt_atomic_exchange_i64(ptr, v); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_fetch_add_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_add_u8(ptr, v); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_add_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_add_u16(ptr, v); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_add_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_add_u32(ptr, v); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_add_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_add_u64(ptr, v); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_fetch_add_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_add_i8(ptr, v); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_fetch_add_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_add_i16(ptr, v); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_fetch_add_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_add_i32(ptr, v); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_fetch_add_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_add_i64(ptr, v); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_fetch_sub_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_sub_u8(ptr, v); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_sub_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_sub_u16(ptr, v); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_sub_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_sub_u32(ptr, v); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_sub_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_sub_u64(ptr, v); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_fetch_sub_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_sub_i8(ptr, v); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_fetch_sub_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_sub_i16(ptr, v); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_fetch_sub_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_sub_i32(ptr, v); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_fetch_sub_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_sub_i64(ptr, v); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_fetch_and_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_and_u8(ptr, v); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_and_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_and_u16(ptr, v); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_and_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_and_u32(ptr, v); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_and_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_and_u64(ptr, v); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_fetch_and_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_and_i8(ptr, v); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_fetch_and_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_and_i16(ptr, v); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_fetch_and_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_and_i32(ptr, v); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_fetch_and_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_and_i64(ptr, v); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_fetch_or_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_or_u8(ptr, v); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_or_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_or_u16(ptr, v); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_or_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_or_u32(ptr, v); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_or_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_or_u64(ptr, v); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_fetch_or_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_or_i8(ptr, v); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_fetch_or_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_or_i16(ptr, v); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_fetch_or_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_or_i32(ptr, v); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_fetch_or_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_or_i64(ptr, v); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_fetch_xor_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_xor_u8(ptr, v); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_xor_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_xor_u16(ptr, v); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_xor_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_xor_u32(ptr, v); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_xor_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_xor_u64(ptr, v); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_fetch_xor_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_xor_i8(ptr, v); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_fetch_xor_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_xor_i16(ptr, v); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_fetch_xor_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_xor_i32(ptr, v); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_fetch_xor_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  v, enum xt_memory_order o) { (void)o; return xt_atomic_fetch_xor_i64(ptr, v); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_compare_exchange_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  expected, uint8_t  desired, enum xt_memory_order o) { (void)o; return xt_atomic_compare_exchange_u8(ptr, expected, desired); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_compare_exchange_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t expected, uint16_t desired, enum xt_memory_order o) { (void)o; return xt_atomic_compare_exchange_u16(ptr, expected, desired); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_compare_exchange_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t expected, uint32_t desired, enum xt_memory_order o) { (void)o; return xt_atomic_compare_exchange_u32(ptr, expected, desired); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_compare_exchange_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t expected, uint64_t desired, enum xt_memory_order o) { (void)o; return xt_atomic_compare_exchange_u64(ptr, expected, desired); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_compare_exchange_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   expected, int8_t   desired, enum xt_memory_order o) { (void)o; return xt_atomic_compare_exchange_i8(ptr, expected, desired); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_compare_exchange_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  expected, int16_t  desired, enum xt_memory_order o) { (void)o; return xt_atomic_compare_exchange_i16(ptr, expected, desired); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_compare_exchange_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  expected, int32_t  desired, enum xt_memory_order o) { (void)o; return xt_atomic_compare_exchange_i32(ptr, expected, desired); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_compare_exchange_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  expected, int64_t  desired, enum xt_memory_order o) { (void)o; return xt_atomic_compare_exchange_i64(ptr, expected, desired); }
+#endif
+
+#ifdef XTHREAD_HAS_CAS128
+XTHREAD_ATOMIC_API xt_uint128_t xt_atomic_compare_exchange_u128(xt_atomic_uint128_t* ptr, xt_uint128_t expected, xt_uint128_t desired)
+{
+    __int64 cmp[2] = {(__int64)expected.lo, (__int64)expected.hi};
+    _InterlockedCompareExchange128((volatile __int64*)ptr, (__int64)desired.hi, (__int64)desired.lo, cmp);
+    xt_uint128_t old = {(uint64_t)cmp[0], (uint64_t)cmp[1]};
+    return old;
+}
+#endif
+
+#else
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_load_u8 (const xt_atomic_uint8_t*  ptr) { return __atomic_load_n(ptr, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_load_u16(const xt_atomic_uint16_t* ptr) { return __atomic_load_n(ptr, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_load_u32(const xt_atomic_uint32_t* ptr) { return __atomic_load_n(ptr, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_load_u64(const xt_atomic_uint64_t* ptr) { return __atomic_load_n(ptr, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_load_i8 (const xt_atomic_int8_t*   ptr) { return __atomic_load_n(ptr, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_load_i16(const xt_atomic_int16_t*  ptr) { return __atomic_load_n(ptr, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_load_i32(const xt_atomic_int32_t*  ptr) { return __atomic_load_n(ptr, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_load_i64(const xt_atomic_int64_t*  ptr) { return __atomic_load_n(ptr, __ATOMIC_SEQ_CST); }
+
+XTHREAD_ATOMIC_API void xt_atomic_store_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v) { __atomic_store_n(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API void xt_atomic_store_u16(xt_atomic_uint16_t* ptr, uint16_t v) { __atomic_store_n(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API void xt_atomic_store_u32(xt_atomic_uint32_t* ptr, uint32_t v) { __atomic_store_n(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API void xt_atomic_store_u64(xt_atomic_uint64_t* ptr, uint64_t v) { __atomic_store_n(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API void xt_atomic_store_i8 (xt_atomic_int8_t*   ptr, int8_t   v) { __atomic_store_n(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API void xt_atomic_store_i16(xt_atomic_int16_t*  ptr, int16_t  v) { __atomic_store_n(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API void xt_atomic_store_i32(xt_atomic_int32_t*  ptr, int32_t  v) { __atomic_store_n(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API void xt_atomic_store_i64(xt_atomic_int64_t*  ptr, int64_t  v) { __atomic_store_n(ptr, v, __ATOMIC_SEQ_CST); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_exchange_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v) { return __atomic_exchange_n(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_exchange_u16(xt_atomic_uint16_t* ptr, uint16_t v) { return __atomic_exchange_n(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_exchange_u32(xt_atomic_uint32_t* ptr, uint32_t v) { return __atomic_exchange_n(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_exchange_u64(xt_atomic_uint64_t* ptr, uint64_t v) { return __atomic_exchange_n(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_exchange_i8 (xt_atomic_int8_t*   ptr, int8_t   v) { return __atomic_exchange_n(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_exchange_i16(xt_atomic_int16_t*  ptr, int16_t  v) { return __atomic_exchange_n(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_exchange_i32(xt_atomic_int32_t*  ptr, int32_t  v) { return __atomic_exchange_n(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_exchange_i64(xt_atomic_int64_t*  ptr, int64_t  v) { return __atomic_exchange_n(ptr, v, __ATOMIC_SEQ_CST); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_fetch_add_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v) { return __atomic_fetch_add(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_add_u16(xt_atomic_uint16_t* ptr, uint16_t v) { return __atomic_fetch_add(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_add_u32(xt_atomic_uint32_t* ptr, uint32_t v) { return __atomic_fetch_add(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_add_u64(xt_atomic_uint64_t* ptr, uint64_t v) { return __atomic_fetch_add(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_fetch_add_i8 (xt_atomic_int8_t*   ptr, int8_t   v) { return __atomic_fetch_add(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_fetch_add_i16(xt_atomic_int16_t*  ptr, int16_t  v) { return __atomic_fetch_add(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_fetch_add_i32(xt_atomic_int32_t*  ptr, int32_t  v) { return __atomic_fetch_add(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_fetch_add_i64(xt_atomic_int64_t*  ptr, int64_t  v) { return __atomic_fetch_add(ptr, v, __ATOMIC_SEQ_CST); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_fetch_sub_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v) { return __atomic_fetch_sub(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_sub_u16(xt_atomic_uint16_t* ptr, uint16_t v) { return __atomic_fetch_sub(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_sub_u32(xt_atomic_uint32_t* ptr, uint32_t v) { return __atomic_fetch_sub(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_sub_u64(xt_atomic_uint64_t* ptr, uint64_t v) { return __atomic_fetch_sub(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_fetch_sub_i8 (xt_atomic_int8_t*   ptr, int8_t   v) { return __atomic_fetch_sub(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_fetch_sub_i16(xt_atomic_int16_t*  ptr, int16_t  v) { return __atomic_fetch_sub(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_fetch_sub_i32(xt_atomic_int32_t*  ptr, int32_t  v) { return __atomic_fetch_sub(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_fetch_sub_i64(xt_atomic_int64_t*  ptr, int64_t  v) { return __atomic_fetch_sub(ptr, v, __ATOMIC_SEQ_CST); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_fetch_and_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v) { return __atomic_fetch_and(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_and_u16(xt_atomic_uint16_t* ptr, uint16_t v) { return __atomic_fetch_and(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_and_u32(xt_atomic_uint32_t* ptr, uint32_t v) { return __atomic_fetch_and(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_and_u64(xt_atomic_uint64_t* ptr, uint64_t v) { return __atomic_fetch_and(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_fetch_and_i8 (xt_atomic_int8_t*   ptr, int8_t   v) { return __atomic_fetch_and(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_fetch_and_i16(xt_atomic_int16_t*  ptr, int16_t  v) { return __atomic_fetch_and(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_fetch_and_i32(xt_atomic_int32_t*  ptr, int32_t  v) { return __atomic_fetch_and(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_fetch_and_i64(xt_atomic_int64_t*  ptr, int64_t  v) { return __atomic_fetch_and(ptr, v, __ATOMIC_SEQ_CST); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_fetch_or_u8 (xt_atomic_uint8_t* ptr, uint8_t  v) { return __atomic_fetch_or(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_or_u16(xt_atomic_uint16_t*ptr, uint16_t v) { return __atomic_fetch_or(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_or_u32(xt_atomic_uint32_t*ptr, uint32_t v) { return __atomic_fetch_or(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_or_u64(xt_atomic_uint64_t*ptr, uint64_t v) { return __atomic_fetch_or(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_fetch_or_i8 (xt_atomic_int8_t*ptr,   int8_t   v) { return __atomic_fetch_or(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_fetch_or_i16(xt_atomic_int16_t*ptr,  int16_t  v) { return __atomic_fetch_or(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_fetch_or_i32(xt_atomic_int32_t*ptr,  int32_t  v) { return __atomic_fetch_or(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_fetch_or_i64(xt_atomic_int64_t*ptr,  int64_t  v) { return __atomic_fetch_or(ptr, v, __ATOMIC_SEQ_CST); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_fetch_xor_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v) { return __atomic_fetch_xor(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_xor_u16(xt_atomic_uint16_t* ptr, uint16_t v) { return __atomic_fetch_xor(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_xor_u32(xt_atomic_uint32_t* ptr, uint32_t v) { return __atomic_fetch_xor(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_xor_u64(xt_atomic_uint64_t* ptr, uint64_t v) { return __atomic_fetch_xor(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_fetch_xor_i8 (xt_atomic_int8_t*   ptr, int8_t   v) { return __atomic_fetch_xor(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_fetch_xor_i16(xt_atomic_int16_t*  ptr, int16_t  v) { return __atomic_fetch_xor(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_fetch_xor_i32(xt_atomic_int32_t*  ptr, int32_t  v) { return __atomic_fetch_xor(ptr, v, __ATOMIC_SEQ_CST); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_fetch_xor_i64(xt_atomic_int64_t*  ptr, int64_t  v) { return __atomic_fetch_xor(ptr, v, __ATOMIC_SEQ_CST); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_compare_exchange_u8 (xt_atomic_uint8_t*  ptr, uint8_t  expected, uint8_t  desired) { return __sync_val_compare_and_swap(           ptr, expected, desired); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_compare_exchange_u16(xt_atomic_uint16_t* ptr, uint16_t expected, uint16_t desired) { return __sync_val_compare_and_swap(           ptr, expected, desired); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_compare_exchange_u32(xt_atomic_uint32_t* ptr, uint32_t expected, uint32_t desired) { return __sync_val_compare_and_swap(           ptr, expected, desired); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_compare_exchange_u64(xt_atomic_uint64_t* ptr, uint64_t expected, uint64_t desired) { return __sync_val_compare_and_swap(           ptr, expected, desired); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_compare_exchange_i8 (xt_atomic_int8_t*   ptr, int8_t   expected, int8_t   desired) { return __sync_val_compare_and_swap((uint8_t*) ptr, expected, desired); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_compare_exchange_i16(xt_atomic_int16_t*  ptr, int16_t  expected, int16_t  desired) { return __sync_val_compare_and_swap((uint16_t*)ptr, expected, desired); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_compare_exchange_i32(xt_atomic_int32_t*  ptr, int32_t  expected, int32_t  desired) { return __sync_val_compare_and_swap((uint32_t*)ptr, expected, desired); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_compare_exchange_i64(xt_atomic_int64_t*  ptr, int64_t  expected, int64_t  desired) { return __sync_val_compare_and_swap((uint64_t*)ptr, expected, desired); }
+
+// xt_memory_order matches the values of GCC's __ATOMIC_* macros
+static inline int xt_memory_order_cas_failure(enum xt_memory_order o) { return o == xt_memory_order_acq_rel ? __ATOMIC_ACQUIRE : o == xt_memory_order_release ? __ATOMIC_RELAXED : (int)o; }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_load_explicit_u8 (const xt_atomic_uint8_t*  ptr, enum xt_memory_order o) { return __atomic_load_n(ptr, o); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_load_explicit_u16(const xt_atomic_uint16_t* ptr, enum xt_memory_order o) { return __atomic_load_n(ptr, o); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_load_explicit_u32(const xt_atomic_uint32_t* ptr, enum xt_memory_order o) { return __atomic_load_n(ptr, o); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_load_explicit_u64(const xt_atomic_uint64_t* ptr, enum xt_memory_order o) { return __atomic_load_n(ptr, o); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_load_explicit_i8 (const xt_atomic_int8_t*   ptr, enum xt_memory_order o) { return __atomic_load_n(ptr, o); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_load_explicit_i16(const xt_atomic_int16_t*  ptr, enum xt_memory_order o) { return __atomic_load_n(ptr, o); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_load_explicit_i32(const xt_atomic_int32_t*  ptr, enum xt_memory_order o) { return __atomic_load_n(ptr, o); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_load_explicit_i64(const xt_atomic_int64_t*  ptr, enum xt_memory_order o) { return __atomic_load_n(ptr, o); }
+
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v, enum xt_memory_order o) { __atomic_store_n(ptr, v, o); }
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t v, enum xt_memory_order o) { __atomic_store_n(ptr, v, o); }
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t v, enum xt_memory_order o) { __atomic_store_n(ptr, v, o); }
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t v, enum xt_memory_order o) { __atomic_store_n(ptr, v, o); }
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   v, enum xt_memory_order o) { __atomic_store_n(ptr, v, o); }
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  v, enum xt_memory_order o) { __atomic_store_n(ptr, v, o); }
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  v, enum xt_memory_order o) { __atomic_store_n(ptr, v, o); }
+XTHREAD_ATOMIC_API void xt_atomic_store_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  v, enum xt_memory_order o) { __atomic_store_n(ptr, v, o); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_exchange_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v, enum xt_memory_order o) { return __atomic_exchange_n(ptr, v, o); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_exchange_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t v, enum xt_memory_order o) { return __atomic_exchange_n(ptr, v, o); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_exchange_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t v, enum xt_memory_order o) { return __atomic_exchange_n(ptr, v, o); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_exchange_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t v, enum xt_memory_order o) { return __atomic_exchange_n(ptr, v, o); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_exchange_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   v, enum xt_memory_order o) { return __atomic_exchange_n(ptr, v, o); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_exchange_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  v, enum xt_memory_order o) { return __atomic_exchange_n(ptr, v, o); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_exchange_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  v, enum xt_memory_order o) { return __atomic_exchange_n(ptr, v, o); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_exchange_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  v, enum xt_memory_order o) { return __atomic_exchange_n(ptr, v, o); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_fetch_add_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v, enum xt_memory_order o) { return __atomic_fetch_add(ptr, v, o); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_add_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t v, enum xt_memory_order o) { return __atomic_fetch_add(ptr, v, o); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_add_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t v, enum xt_memory_order o) { return __atomic_fetch_add(ptr, v, o); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_add_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t v, enum xt_memory_order o) { return __atomic_fetch_add(ptr, v, o); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_fetch_add_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   v, enum xt_memory_order o) { return __atomic_fetch_add(ptr, v, o); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_fetch_add_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  v, enum xt_memory_order o) { return __atomic_fetch_add(ptr, v, o); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_fetch_add_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  v, enum xt_memory_order o) { return __atomic_fetch_add(ptr, v, o); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_fetch_add_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  v, enum xt_memory_order o) { return __atomic_fetch_add(ptr, v, o); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_fetch_sub_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v, enum xt_memory_order o) { return __atomic_fetch_sub(ptr, v, o); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_sub_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t v, enum xt_memory_order o) { return __atomic_fetch_sub(ptr, v, o); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_sub_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t v, enum xt_memory_order o) { return __atomic_fetch_sub(ptr, v, o); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_sub_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t v, enum xt_memory_order o) { return __atomic_fetch_sub(ptr, v, o); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_fetch_sub_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   v, enum xt_memory_order o) { return __atomic_fetch_sub(ptr, v, o); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_fetch_sub_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  v, enum xt_memory_order o) { return __atomic_fetch_sub(ptr, v, o); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_fetch_sub_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  v, enum xt_memory_order o) { return __atomic_fetch_sub(ptr, v, o); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_fetch_sub_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  v, enum xt_memory_order o) { return __atomic_fetch_sub(ptr, v, o); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_fetch_and_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v, enum xt_memory_order o) { return __atomic_fetch_and(ptr, v, o); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_and_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t v, enum xt_memory_order o) { return __atomic_fetch_and(ptr, v, o); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_and_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t v, enum xt_memory_order o) { return __atomic_fetch_and(ptr, v, o); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_and_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t v, enum xt_memory_order o) { return __atomic_fetch_and(ptr, v, o); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_fetch_and_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   v, enum xt_memory_order o) { return __atomic_fetch_and(ptr, v, o); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_fetch_and_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  v, enum xt_memory_order o) { return __atomic_fetch_and(ptr, v, o); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_fetch_and_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  v, enum xt_memory_order o) { return __atomic_fetch_and(ptr, v, o); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_fetch_and_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  v, enum xt_memory_order o) { return __atomic_fetch_and(ptr, v, o); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_fetch_or_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v, enum xt_memory_order o) { return __atomic_fetch_or(ptr, v, o); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_or_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t v, enum xt_memory_order o) { return __atomic_fetch_or(ptr, v, o); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_or_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t v, enum xt_memory_order o) { return __atomic_fetch_or(ptr, v, o); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_or_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t v, enum xt_memory_order o) { return __atomic_fetch_or(ptr, v, o); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_fetch_or_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   v, enum xt_memory_order o) { return __atomic_fetch_or(ptr, v, o); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_fetch_or_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  v, enum xt_memory_order o) { return __atomic_fetch_or(ptr, v, o); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_fetch_or_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  v, enum xt_memory_order o) { return __atomic_fetch_or(ptr, v, o); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_fetch_or_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  v, enum xt_memory_order o) { return __atomic_fetch_or(ptr, v, o); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_fetch_xor_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v, enum xt_memory_order o) { return __atomic_fetch_xor(ptr, v, o); }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_fetch_xor_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t v, enum xt_memory_order o) { return __atomic_fetch_xor(ptr, v, o); }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_fetch_xor_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t v, enum xt_memory_order o) { return __atomic_fetch_xor(ptr, v, o); }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_fetch_xor_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t v, enum xt_memory_order o) { return __atomic_fetch_xor(ptr, v, o); }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_fetch_xor_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   v, enum xt_memory_order o) { return __atomic_fetch_xor(ptr, v, o); }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_fetch_xor_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  v, enum xt_memory_order o) { return __atomic_fetch_xor(ptr, v, o); }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_fetch_xor_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  v, enum xt_memory_order o) { return __atomic_fetch_xor(ptr, v, o); }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_fetch_xor_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  v, enum xt_memory_order o) { return __atomic_fetch_xor(ptr, v, o); }
+
+XTHREAD_ATOMIC_API uint8_t  xt_atomic_compare_exchange_explicit_u8 (xt_atomic_uint8_t*  ptr, uint8_t  expected, uint8_t  desired, enum xt_memory_order o) { unsigned char e = expected; __atomic_compare_exchange_n(ptr, &e, desired, false, o, xt_memory_order_cas_failure(o)); return e; }
+XTHREAD_ATOMIC_API uint16_t xt_atomic_compare_exchange_explicit_u16(xt_atomic_uint16_t* ptr, uint16_t expected, uint16_t desired, enum xt_memory_order o) { unsigned short e = expected; __atomic_compare_exchange_n(ptr, &e, desired, false, o, xt_memory_order_cas_failure(o)); return e; }
+XTHREAD_ATOMIC_API uint32_t xt_atomic_compare_exchange_explicit_u32(xt_atomic_uint32_t* ptr, uint32_t expected, uint32_t desired, enum xt_memory_order o) { unsigned int e = expected; __atomic_compare_exchange_n(ptr, &e, desired, false, o, xt_memory_order_cas_failure(o)); return e; }
+XTHREAD_ATOMIC_API uint64_t xt_atomic_compare_exchange_explicit_u64(xt_atomic_uint64_t* ptr, uint64_t expected, uint64_t desired, enum xt_memory_order o) { unsigned long long e = expected; __atomic_compare_exchange_n(ptr, &e, desired, false, o, xt_memory_order_cas_failure(o)); return e; }
+XTHREAD_ATOMIC_API int8_t   xt_atomic_compare_exchange_explicit_i8 (xt_atomic_int8_t*   ptr, int8_t   expected, int8_t   desired, enum xt_memory_order o) { char e = expected; __atomic_compare_exchange_n(ptr, &e, desired, false, o, xt_memory_order_cas_failure(o)); return e; }
+XTHREAD_ATOMIC_API int16_t  xt_atomic_compare_exchange_explicit_i16(xt_atomic_int16_t*  ptr, int16_t  expected, int16_t  desired, enum xt_memory_order o) { short e = expected; __atomic_compare_exchange_n(ptr, &e, desired, false, o, xt_memory_order_cas_failure(o)); return e; }
+XTHREAD_ATOMIC_API int32_t  xt_atomic_compare_exchange_explicit_i32(xt_atomic_int32_t*  ptr, int32_t  expected, int32_t  desired, enum xt_memory_order o) { int e = expected; __atomic_compare_exchange_n(ptr, &e, desired, false, o, xt_memory_order_cas_failure(o)); return e; }
+XTHREAD_ATOMIC_API int64_t  xt_atomic_compare_exchange_explicit_i64(xt_atomic_int64_t*  ptr, int64_t  expected, int64_t  desired, enum xt_memory_order o) { long long e = expected; __atomic_compare_exchange_n(ptr, &e, desired, false, o, xt_memory_order_cas_failure(o)); return e; }
+
+XTHREAD_ATOMIC_API void xt_atomic_thread_fence(enum xt_memory_order o) { __atomic_thread_fence(o); }
+
+#ifdef XTHREAD_HAS_CAS128
+// __atomic on 16 bytes calls into libatomic (or needs -mcx16), so these are written by hand
+XTHREAD_ATOMIC_API xt_uint128_t xt_atomic_compare_exchange_u128(xt_atomic_uint128_t* ptr, xt_uint128_t expected, xt_uint128_t desired)
+{
+    xt_uint128_t old;
+#if defined(__x86_64__)
+    old = expected;
+    __asm__ __volatile__(
+        "lock cmpxchg16b %0"
+        : "+m"(*ptr), "+a"(old.lo), "+d"(old.hi)
+        : "b"(desired.lo), "c"(desired.hi)
+        : "memory", "cc");
+#elif defined(__aarch64__) || defined(__arm64__)
+    // On mismatch the old value is stored back, otherwise the load alone isn't guaranteed to be single-copy atomic
+    uint64_t lo, hi, tlo, thi;
+    uint32_t fail;
+    __asm__ __volatile__(
+        "1: ldaxp %[lo], %[hi], %[mem]\n"
+        "   cmp   %[lo], %[elo]\n"
+        "   ccmp  %[hi], %[ehi], #0, eq\n"
+        "   csel  %[tlo], %[dlo], %[lo], eq\n"
+        "   csel  %[thi], %[dhi], %[hi], eq\n"
+        "   stlxp %w[fail], %[tlo], %[thi], %[mem]\n"
+        "   cbnz  %w[fail], 1b\n"
+        : [lo] "=&r"(lo), [hi] "=&r"(hi), [fail] "=&r"(fail), [mem] "+Q"(*ptr),
+          [tlo] "=&r"(tlo), [thi] "=&r"(thi)
+        : [elo] "r"(expected.lo), [ehi] "r"(expected.hi), [dlo] "r"(desired.lo), [dhi] "r"(desired.hi)
+        : "memory", "cc");
+    old.lo = lo;
+    old.hi = hi;
+#endif
+    return old;
+}
+#endif
+
+#endif
+
+#endif /* XHL_THREAD_ATOMIC_DEFINED */
+
 #ifdef XHL_THREAD_IMPL
 #undef XHL_THREAD_IMPL
 
@@ -277,8 +1517,22 @@ struct xt_queue_t
 #endif
 
 #include <assert.h>
+#include <stdio.h>
+#include <string.h>
 #define XTHREAD_ASSERT(expression, message) assert((expression) && (message))
 
+#if defined(__x86_64__) || defined(_M_X64)
+#define xthread_cpu_relax() _mm_pause()
+#else
+#define xthread_cpu_relax() __yield()
+#endif
+
+#if !defined(XTHREAD_MALLOC) || !defined(XTHREAD_FREE)
+#include <stdlib.h>
+#define XTHREAD_MALLOC(size) malloc(size)
+#define XTHREAD_FREE(ptr)    free(ptr)
+#endif
+
 #if defined(_WIN32)
 
 #pragma comment(lib, "winmm.lib")
@@ -294,19 +1548,59 @@ struct xt_queue_t
 xt_thread_ptr_t xthread_current(void) { return (void*)(uintptr_t)GetCurrentThreadId(); }
 xt_thread_ptr_t xthread_create(int (*thread_proc)(void*), void* user_data, int stack_size)
 {
+    xt_thread_options_t options;
+    memset(&options, 0, sizeof(options));
+    options.stack_size = stack_size;
+    return xthread_create_ex(thread_proc, user_data, &options);
+}
+
+// SetThreadDescription only exists on Windows 10 1607+
+typedef HRESULT(WINAPI* xthread_SetThreadDescription_fn)(HANDLE, PCWSTR);
+static bool xthread_set_name_handle(HANDLE thread, const char* name)
+{
+    xthread_SetThreadDescription_fn set_description =
+        (xthread_SetThreadDescription_fn)(uintptr_t)GetProcAddress(GetModuleHandleW(L"kernel32.dll"), "SetThreadDescription");
+    if (! set_description)
+        return false;
+    WCHAR wname[64];
+    if (MultiByteToWideChar(CP_UTF8, 0, name, -1, wname, ARRAYSIZE(wname)) == 0)
+        return false;
+    return SUCCEEDED(set_description(thread, wname));
+}
+
+xt_thread_ptr_t xthread_create_ex(int (*thread_proc)(void*), void* user_data, const xt_thread_options_t* options)
+{
+    // Created suspended so everything is applied before thread_proc runs
     DWORD  thread_id;
     HANDLE handle = CreateThread(
         NULL,
-        stack_size > 0 ? (size_t)stack_size : 0U,
+        options->stack_size > 0 ? (size_t)options->stack_size : 0U,
         (LPTHREAD_START_ROUTINE)(uintptr_t)thread_proc,
         user_data,
-        0,
+        CREATE_SUSPENDED | (options->stack_size > 0 ? STACK_SIZE_PARAM_IS_A_RESERVATION : 0),
         &thread_id);
     if (! handle)
         return NULL;
+
+    if (options->name)
+        xthread_set_name_handle(handle, options->name);
+    if (options->affinity_mask)
+        SetThreadAffinityMask(handle, (DWORD_PTR)options->affinity_mask);
+    if (options->sched_policy == XTHREAD_SCHED_FIFO)
+        SetThreadPriority(handle, THREAD_PRIORITY_TIME_CRITICAL);
+    else if (options->sched_policy == XTHREAD_SCHED_RR)
+        SetThreadPriority(handle, THREAD_PRIORITY_HIGHEST);
+
+    ResumeThread(handle);
     return (xt_thread_ptr_t)handle;
 }
 
+bool xthread_set_name(const char* name) { return xthread_set_name_handle(GetCurrentThread(), name); }
+bool xthread_set_affinity(uint64_t core_mask)
+{
+    return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)core_mask) != 0;
+}
+
 void xthread_yield(void) { SwitchToThread(); }
 void xthread_exit(int return_code) { ExitThread((DWORD)return_code); }
 void xthread_destroy(xt_thread_ptr_t thread)
@@ -322,10 +1616,32 @@ int xthread_join(xt_thread_ptr_t thread)
     return (int)retval;
 }
 int  xthread_detach(xt_thread_ptr_t thread) { return CloseHandle((HANDLE)thread) != 0; }
-void xthread_set_high_priority(void) { SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST); }
+void xthread_set_high_priority(void) { xthread_set_realtime(XTHREAD_REALTIME_DEFAULT_PRIORITY, false); }
+xt_realtime_t xthread_set_realtime(int priority, bool lock_memory)
+{
+    (void)priority;
+    (void)lock_memory;
+    xt_realtime_t granted;
+    memset(&granted, 0, sizeof(granted));
+    if (SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL))
+        granted.sched_policy = XTHREAD_SCHED_FIFO;
+    granted.sched_priority = GetThreadPriority(GetCurrentThread());
+    return granted;
+}
+int  xthread_num_cores(void)
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+}
 
-_Static_assert(sizeof(xt_mutex_t) >= sizeof(CRITICAL_SECTION), "Mutex too smol...");
+XTHREAD_STATIC_ASSERT(sizeof(xt_mutex_t) >= sizeof(CRITICAL_SECTION), "Mutex too smol...");
 void xthread_mutex_init(xt_mutex_t* mutex) { InitializeCriticalSectionAndSpinCount((CRITICAL_SECTION*)mutex, 32); }
+bool xthread_mutex_init_ex(xt_mutex_t* mutex, int flags)
+{
+    xthread_mutex_init(mutex);
+    return (flags & XTHREAD_MUTEX_PRIO_INHERIT) == 0;
+}
 void xthread_mutex_term(xt_mutex_t* mutex) { DeleteCriticalSection((CRITICAL_SECTION*)mutex); }
 void xthread_mutex_lock(xt_mutex_t* mutex) { EnterCriticalSection((CRITICAL_SECTION*)mutex); }
 void xthread_mutex_unlock(xt_mutex_t* mutex) { LeaveCriticalSection((CRITICAL_SECTION*)mutex); }
@@ -345,10 +1661,23 @@ void* xthread_tls_get    (xt_tls_t tls)              { return TlsGetValue((DWORD
 #elif defined(__linux__) || defined(__APPLE__) || defined(__ANDROID__)
 
 #include <errno.h>
+#include <limits.h>
 #include <pthread.h>
+#include <sched.h>
 #include <stdint.h>
 #include <string.h>
-#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#if defined(__linux__) || defined(__ANDROID__)
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#endif
+
+#if !defined(CLOCK_MONOTONIC) || !defined(MAP_ANONYMOUS)
+#error "System headers were included before thread.h without _GNU_SOURCE. Include it first, or define _GNU_SOURCE"
+#endif
 
 xt_thread_ptr_t xthread_current(void) { return (void*)pthread_self(); }
 
@@ -358,10 +1687,109 @@ void xthread_exit(int return_code) { pthread_exit((void*)(uintptr_t)return_code)
 
 xt_thread_ptr_t xthread_create(int (*thread_proc)(void*), void* user_data, int stack_size)
 {
+    xt_thread_options_t options;
+    memset(&options, 0, sizeof(options));
+    options.stack_size = stack_size;
+    return xthread_create_ex(thread_proc, user_data, &options);
+}
+
+bool xthread_set_name(const char* name)
+{
+#if defined(__APPLE__)
+    return pthread_setname_np(name) == 0;
+#else
+    return prctl(PR_SET_NAME, (unsigned long)name, 0, 0, 0) == 0;
+#endif
+}
+
+bool xthread_set_affinity(uint64_t core_mask)
+{
+#if defined(__APPLE__)
+    // Apple only has affinity tags, which are a hint for sharing caches rather than pinning
+    (void)core_mask;
+    return false;
+#else
+    // Raw syscall, so we don't need cpu_set_t. The kernel treats cores beyond the end of the mask as cleared
+    unsigned long mask[64 / (sizeof(unsigned long) * CHAR_BIT)];
+    for (int i = 0; i < (int)(sizeof(mask) / sizeof(mask[0])); i++)
+        mask[i] = (unsigned long)(core_mask >> (i * sizeof(unsigned long) * CHAR_BIT));
+    return syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask) == 0;
+#endif
+}
+
+struct xthread_start_info
+{
+    int (*thread_proc)(void*);
+    void*    user_data;
+    uint64_t affinity_mask;
+    char     name[64];
+};
+
+static void* xthread_start_proc(void* arg)
+{
+    struct xthread_start_info info = *(struct xthread_start_info*)arg;
+    XTHREAD_FREE(arg);
+    if (info.name[0])
+        xthread_set_name(info.name);
+    if (info.affinity_mask)
+        xthread_set_affinity(info.affinity_mask);
+    return (void*)(uintptr_t)info.thread_proc(info.user_data);
+}
+
+xt_thread_ptr_t xthread_create_ex(int (*thread_proc)(void*), void* user_data, const xt_thread_options_t* options)
+{
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+
+    if (options->stack_size > 0)
+    {
+        size_t page  = (size_t)sysconf(_SC_PAGESIZE);
+        size_t size  = (size_t)options->stack_size;
+        size         = (size + page - 1) & ~(page - 1);
+#ifdef PTHREAD_STACK_MIN
+        if (size < (size_t)PTHREAD_STACK_MIN)
+            size = (size_t)PTHREAD_STACK_MIN;
+#endif
+        pthread_attr_setstacksize(&attr, size);
+    }
+
+    bool explicit_sched = options->sched_policy == XTHREAD_SCHED_FIFO || options->sched_policy == XTHREAD_SCHED_RR;
+    if (explicit_sched)
+    {
+        int policy = options->sched_policy == XTHREAD_SCHED_FIFO ? SCHED_FIFO : SCHED_RR;
+        int lo     = sched_get_priority_min(policy);
+        int hi     = sched_get_priority_max(policy);
+
+        struct sched_param sp;
+        memset(&sp, 0, sizeof(sp));
+        sp.sched_priority = options->sched_priority < lo ? lo : options->sched_priority > hi ? hi : options->sched_priority;
+        pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&attr, policy);
+        pthread_attr_setschedparam(&attr, &sp);
+    }
+
+    struct xthread_start_info* info = (struct xthread_start_info*)XTHREAD_MALLOC(sizeof(*info));
+    memset(info, 0, sizeof(*info));
+    info->thread_proc   = thread_proc;
+    info->user_data     = user_data;
+    info->affinity_mask = options->affinity_mask;
+    if (options->name)
+        strncpy(info->name, options->name, sizeof(info->name) - 1);
+
     pthread_t thread;
-    if (0 != pthread_create(&thread, NULL, (void* (*)(void*))thread_proc, user_data))
+    int       err = pthread_create(&thread, &attr, xthread_start_proc, info);
+    if (err == EPERM && explicit_sched)
+    {
+        // Not allowed to use realtime scheduling. Create the thread anyway
+        pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+        err = pthread_create(&thread, &attr, xthread_start_proc, info);
+    }
+    pthread_attr_destroy(&attr);
+    if (err != 0)
+    {
+        XTHREAD_FREE(info);
         return NULL;
-
+    }
     return (xt_thread_ptr_t)thread;
 }
 void xthread_destroy(xt_thread_ptr_t thread) { pthread_join((pthread_t)thread, NULL); }
@@ -372,16 +1800,101 @@ int  xthread_join(xt_thread_ptr_t thread)
     return (int)(uintptr_t)retval;
 }
 int  xthread_detach(xt_thread_ptr_t thread) { return pthread_detach((pthread_t)thread) == 0; }
-void xthread_set_high_priority(void)
+int  xthread_num_cores(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+void xthread_set_high_priority(void) { xthread_set_realtime(XTHREAD_REALTIME_DEFAULT_PRIORITY, false); }
+
+xt_realtime_t xthread_set_realtime(int priority, bool lock_memory)
 {
+    xt_realtime_t granted;
+    memset(&granted, 0, sizeof(granted));
+
+    int lo   = sched_get_priority_min(SCHED_FIFO);
+    int hi   = sched_get_priority_max(SCHED_FIFO);
+    priority = priority < lo ? lo : priority > hi ? hi : priority;
+
+    int policy = SCHED_FIFO;
+#if defined(__linux__)
+    // Children forked from this thread shouldn't inherit realtime. rtkit refuses threads without this flag
+#ifndef SCHED_RESET_ON_FORK
+#define SCHED_RESET_ON_FORK 0x40000000
+#endif
+    policy |= SCHED_RESET_ON_FORK;
+
+    // Unprivileged users may be allowed realtime up to RLIMIT_RTPRIO, eg. members of the 'audio' group
+    struct rlimit rtprio;
+    if (geteuid() != 0 && getrlimit(RLIMIT_RTPRIO, &rtprio) == 0 && rtprio.rlim_cur != RLIM_INFINITY &&
+        (rlim_t)priority > rtprio.rlim_cur && rtprio.rlim_cur >= (rlim_t)lo)
+        priority = (int)rtprio.rlim_cur;
+#endif
+
     struct sched_param sp;
     memset(&sp, 0, sizeof(sp));
-    sp.sched_priority = sched_get_priority_min(SCHED_RR);
-    pthread_setschedparam(pthread_self(), SCHED_RR, &sp);
+    sp.sched_priority = priority;
+    if (pthread_setschedparam(pthread_self(), policy, &sp) == 0)
+    {
+        granted.sched_policy   = XTHREAD_SCHED_FIFO;
+        granted.sched_priority = priority;
+    }
+#if defined(__linux__)
+    else
+    {
+        // Niceness is per thread on Linux. rtkit hands out -11 by default, go as low as RLIMIT_NICE allows
+        pid_t         tid  = (pid_t)syscall(SYS_gettid);
+        int           nice = -11;
+        struct rlimit rlim_nice;
+        if (geteuid() != 0 && getrlimit(RLIMIT_NICE, &rlim_nice) == 0 && rlim_nice.rlim_cur != RLIM_INFINITY)
+        {
+            int min_nice = 20 - (int)rlim_nice.rlim_cur;
+            if (nice < min_nice)
+                nice = min_nice;
+        }
+        // getpriority can legitimately return -1, errno is the only way to spot failure
+        errno       = 0;
+        int current = getpriority(PRIO_PROCESS, (id_t)tid);
+        if (errno == 0 && nice < current)
+            setpriority(PRIO_PROCESS, (id_t)tid, nice);
+        errno        = 0;
+        current      = getpriority(PRIO_PROCESS, (id_t)tid);
+        granted.nice = errno == 0 ? current : 0;
+    }
+#endif
+
+    if (lock_memory)
+    {
+        int flags = MCL_CURRENT;
+        struct rlimit memlock;
+        if (geteuid() == 0 || (getrlimit(RLIMIT_MEMLOCK, &memlock) == 0 && memlock.rlim_cur == RLIM_INFINITY))
+            flags |= MCL_FUTURE;
+        granted.memory_locked = mlockall(flags) == 0;
+    }
+    return granted;
 }
 
-_Static_assert(sizeof(xt_mutex_t) >= sizeof(pthread_mutex_t), "Mutex too smol...");
+XTHREAD_STATIC_ASSERT(sizeof(xt_mutex_t) >= sizeof(pthread_mutex_t), "Mutex too smol...");
 void xthread_mutex_init(xt_mutex_t* mutex) { pthread_mutex_init((pthread_mutex_t*)mutex, NULL); }
+bool xthread_mutex_init_ex(xt_mutex_t* mutex, int flags)
+{
+    if ((flags & XTHREAD_MUTEX_PRIO_INHERIT) == 0)
+    {
+        xthread_mutex_init(mutex);
+        return true;
+    }
+    bool ok = false;
+#if defined(_POSIX_THREAD_PRIO_INHERIT) && _POSIX_THREAD_PRIO_INHERIT >= 0
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    ok = pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT) == 0 &&
+         pthread_mutex_init((pthread_mutex_t*)mutex, &attr) == 0;
+    pthread_mutexattr_destroy(&attr);
+#endif
+    if (! ok)
+        xthread_mutex_init(mutex);
+    return ok;
+}
 void xthread_mutex_term(xt_mutex_t* mutex) { pthread_mutex_destroy((pthread_mutex_t*)mutex); }
 void xthread_mutex_lock(xt_mutex_t* mutex) { pthread_mutex_lock((pthread_mutex_t*)mutex); }
 void xthread_mutex_unlock(xt_mutex_t* mutex) { pthread_mutex_unlock((pthread_mutex_t*)mutex); }
@@ -398,182 +1911,56 @@ void  xthread_tls_destroy(xt_tls_t tls)          { pthread_key_delete((pthread_k
 void  xthread_tls_set(xt_tls_t tls, void* value) { pthread_setspecific((pthread_key_t)(uintptr_t)tls, value); }
 void* xthread_tls_get(xt_tls_t tls)              { return pthread_getspecific((pthread_key_t)(uintptr_t)tls); }
 
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// Absolute CLOCK_MONOTONIC deadline, as expected by FUTEX_WAIT_BITSET
+static void xthread_deadline_ms(struct timespec* ts, int timeout_ms)
+{
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_sec  += timeout_ms / 1000;
+    ts->tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (ts->tv_nsec >= 1000000000)
+    {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+// Sleeps while *addr == expected. Pass NULL to wait forever.
+// Returns 0 when woken (possibly spuriously) or if *addr != expected, and ETIMEDOUT when the deadline has passed
+static int xthread_futex_wait(xt_atomic_uint32_t* addr, uint32_t expected, const struct timespec* deadline)
+{
+    long res = syscall(
+        SYS_futex,
+        addr,
+        FUTEX_WAIT_BITSET | FUTEX_PRIVATE_FLAG,
+        expected,
+        deadline,
+        NULL,
+        FUTEX_BITSET_MATCH_ANY);
+    return res == -1 && errno == ETIMEDOUT ? ETIMEDOUT : 0;
+}
+
+static void xthread_futex_wake(xt_atomic_uint32_t* addr, int count)
+{
+    syscall(SYS_futex, addr, FUTEX_WAKE | FUTEX_PRIVATE_FLAG, count, NULL, NULL, 0);
+}
+#endif // __linux__
+
 #else
 #error Unknown platform.
 #endif
 
 #if defined(_MSC_VER) && !(__clang__)
-
-uint8_t  xt_atomic_load_u8 (const xt_atomic_uint8_t*  ptr) { return _InterlockedCompareExchange8 ((xt_atomic_int8_t*)ptr, 0, 0); }
-uint16_t xt_atomic_load_u16(const xt_atomic_uint16_t* ptr) { return _InterlockedCompareExchange16((xt_atomic_int16_t*)ptr, 0, 0); }
-uint32_t xt_atomic_load_u32(const xt_atomic_uint32_t* ptr) { return _InterlockedCompareExchange((xt_atomic_int32_t*)ptr, 0, 0); }
-uint64_t xt_atomic_load_u64(const xt_atomic_uint64_t* ptr) { return _InterlockedCompareExchange64(ptr, 0, 0); }
-int8_t   xt_atomic_load_i8 (const xt_atomic_int8_t*   ptr) { return _InterlockedCompareExchange8 (ptr, 0, 0); }
-int16_t  xt_atomic_load_i16(const xt_atomic_int16_t*  ptr) { return _InterlockedCompareExchange16(ptr, 0, 0); }
-int32_t  xt_atomic_load_i32(const xt_atomic_int32_t*  ptr) { return _InterlockedCompareExchange(ptr, 0, 0); }
-int64_t  xt_atomic_load_i64(const xt_atomic_int64_t*  ptr) { return _InterlockedCompareExchange64(ptr, 0, 0); }
-
-void xt_atomic_store_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v) { _InterlockedExchange8(ptr, v); }
-void xt_atomic_store_u16(xt_atomic_uint16_t* ptr, uint16_t v) { _InterlockedExchange16(ptr, v); }
-void xt_atomic_store_u32(xt_atomic_uint32_t* ptr, uint32_t v) { _InterlockedExchange(ptr, v); }
-void xt_atomic_store_u64(xt_atomic_uint64_t* ptr, uint64_t v) { _InterlockedExchange64(ptr, v); }
-void xt_atomic_store_i8 (xt_atomic_int8_t*   ptr, int8_t   v) { _InterlockedExchange8(ptr, v); }
-void xt_atomic_store_i16(xt_atomic_int16_t*  ptr, int16_t  v) { _InterlockedExchange16(ptr, v); }
-void xt_atomic_store_i32(xt_atomic_int32_t*  ptr, int32_t  v) { _InterlockedExchange(ptr, v); }
-void xt_atomic_store_i64(xt_atomic_int64_t*  ptr, int64_t  v) { _InterlockedExchange64(ptr, v); }
-
-uint8_t  xt_atomic_exchange_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v) { return _InterlockedExchange8(ptr, v); }
-uint16_t xt_atomic_exchange_u16(xt_atomic_uint16_t* ptr, uint16_t v) { return _InterlockedExchange16(ptr, v); }
-uint32_t xt_atomic_exchange_u32(xt_atomic_uint32_t* ptr, uint32_t v) { return _InterlockedExchange(ptr, v); }
-uint64_t xt_atomic_exchange_u64(xt_atomic_uint64_t* ptr, uint64_t v) { return _InterlockedExchange64(ptr, v); }
-int8_t   xt_atomic_exchange_i8 (xt_atomic_int8_t*   ptr, int8_t   v) { return _InterlockedExchange8(ptr, v); }
-int16_t  xt_atomic_exchange_i16(xt_atomic_int16_t*  ptr, int16_t  v) { return _InterlockedExchange16(ptr, v); }
-int32_t  xt_atomic_exchange_i32(xt_atomic_int32_t*  ptr, int32_t  v) { return _InterlockedExchange(ptr, v); }
-int64_t  xt_atomic_exchange_i64(xt_atomic_int64_t*  ptr, int64_t  v) { return _InterlockedExchange64(ptr, v); }
-
-uint8_t  xt_atomic_fetch_add_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v) { return _InterlockedExchangeAdd8(ptr, v); }
-uint16_t xt_atomic_fetch_add_u16(xt_atomic_uint16_t* ptr, uint16_t v) { return _InterlockedExchangeAdd16(ptr, v); }
-uint32_t xt_atomic_fetch_add_u32(xt_atomic_uint32_t* ptr, uint32_t v) { return _InterlockedExchangeAdd(ptr, v); }
-uint64_t xt_atomic_fetch_add_u64(xt_atomic_uint64_t* ptr, uint64_t v) { return _InterlockedExchangeAdd64(ptr, v); }
-int8_t   xt_atomic_fetch_add_i8 (xt_atomic_int8_t*   ptr, int8_t   v) { return _InterlockedExchangeAdd8(ptr, v); }
-int16_t  xt_atomic_fetch_add_i16(xt_atomic_int16_t*  ptr, int16_t  v) { return _InterlockedExchangeAdd16(ptr, v); }
-int32_t  xt_atomic_fetch_add_i32(xt_atomic_int32_t*  ptr, int32_t  v) { return _InterlockedExchangeAdd(ptr, v); }
-int64_t  xt_atomic_fetch_add_i64(xt_atomic_int64_t*  ptr, int64_t  v) { return _InterlockedExchangeAdd64(ptr, v); }
-
-uint8_t  xt_atomic_fetch_sub_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v) { return xt_atomic_fetch_add_u8 (ptr, -v); }
-uint16_t xt_atomic_fetch_sub_u16(xt_atomic_uint16_t* ptr, uint16_t v) { return xt_atomic_fetch_add_u16(ptr, -v); }
-uint32_t xt_atomic_fetch_sub_u32(xt_atomic_uint32_t* ptr, uint32_t v) { return xt_atomic_fetch_add_u32(ptr, -v); }
-uint64_t xt_atomic_fetch_sub_u64(xt_atomic_uint64_t* ptr, uint64_t v) { return xt_atomic_fetch_add_u64(ptr, -v); }
-int8_t   xt_atomic_fetch_sub_i8 (xt_atomic_int8_t*   ptr, int8_t   v) { return xt_atomic_fetch_add_i8 (ptr, -v); }
-int16_t  xt_atomic_fetch_sub_i16(xt_atomic_int16_t*  ptr, int16_t  v) { return xt_atomic_fetch_add_i16(ptr, -v); }
-int32_t  xt_atomic_fetch_sub_i32(xt_atomic_int32_t*  ptr, int32_t  v) { return xt_atomic_fetch_add_i32(ptr, -v); }
-int64_t  xt_atomic_fetch_sub_i64(xt_atomic_int64_t*  ptr, int64_t  v) { return xt_atomic_fetch_add_i64(ptr, -v); }
-
-uint8_t  xt_atomic_fetch_and_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v) { return _InterlockedAnd8(ptr, v); }
-uint16_t xt_atomic_fetch_and_u16(xt_atomic_uint16_t* ptr, uint16_t v) { return _InterlockedAnd16(ptr, v); }
-uint32_t xt_atomic_fetch_and_u32(xt_atomic_uint32_t* ptr, uint32_t v) { return _InterlockedAnd(ptr, v); }
-uint64_t xt_atomic_fetch_and_u64(xt_atomic_uint64_t* ptr, uint64_t v) { return _InterlockedAnd64(ptr, v); }
-int8_t   xt_atomic_fetch_and_i8 (xt_atomic_int8_t*   ptr, int8_t   v) { return _InterlockedAnd8(ptr, v); }
-int16_t  xt_atomic_fetch_and_i16(xt_atomic_int16_t*  ptr, int16_t  v) { return _InterlockedAnd16(ptr, v); }
-int32_t  xt_atomic_fetch_and_i32(xt_atomic_int32_t*  ptr, int32_t  v) { return _InterlockedAnd(ptr, v); }
-int64_t  xt_atomic_fetch_and_i64(xt_atomic_int64_t*  ptr, int64_t  v) { return _InterlockedAnd64(ptr, v); }
-
-uint8_t  xt_atomic_fetch_or_u8 (xt_atomic_uint8_t* ptr, uint8_t  v) { return _InterlockedOr8(ptr, v); }
-uint16_t xt_atomic_fetch_or_u16(xt_atomic_uint16_t*ptr, uint16_t v) { return _InterlockedOr16(ptr, v); }
-uint32_t xt_atomic_fetch_or_u32(xt_atomic_uint32_t*ptr, uint32_t v) { return _InterlockedOr(ptr, v); }
-uint64_t xt_atomic_fetch_or_u64(xt_atomic_uint64_t*ptr, uint64_t v) { return _InterlockedOr64(ptr, v); }
-int8_t   xt_atomic_fetch_or_i8 (xt_atomic_int8_t*ptr,   int8_t   v) { return _InterlockedOr8(ptr, v); }
-int16_t  xt_atomic_fetch_or_i16(xt_atomic_int16_t*ptr,  int16_t  v) { return _InterlockedOr16(ptr, v); }
-int32_t  xt_atomic_fetch_or_i32(xt_atomic_int32_t*ptr,  int32_t  v) { return _InterlockedOr(ptr, v); }
-int64_t  xt_atomic_fetch_or_i64(xt_atomic_int64_t*ptr,  int64_t  v) { return _InterlockedOr64(ptr, v); }
-
-uint8_t  xt_atomic_fetch_xor_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v) { return _InterlockedXor8(ptr, v); }
-uint16_t xt_atomic_fetch_xor_u16(xt_atomic_uint16_t* ptr, uint16_t v) { return _InterlockedXor16(ptr, v); }
-uint32_t xt_atomic_fetch_xor_u32(xt_atomic_uint32_t* ptr, uint32_t v) { return _InterlockedXor(ptr, v); }
-uint64_t xt_atomic_fetch_xor_u64(xt_atomic_uint64_t* ptr, uint64_t v) { return _InterlockedXor64(ptr, v); }
-int8_t   xt_atomic_fetch_xor_i8 (xt_atomic_int8_t*   ptr, int8_t   v) { return _InterlockedXor8(ptr, v); }
-int16_t  xt_atomic_fetch_xor_i16(xt_atomic_int16_t*  ptr, int16_t  v) { return _InterlockedXor16(ptr, v); }
-int32_t  xt_atomic_fetch_xor_i32(xt_atomic_int32_t*  ptr, int32_t  v) { return _InterlockedXor(ptr, v); }
-int64_t  xt_atomic_fetch_xor_i64(xt_atomic_int64_t*  ptr, int64_t  v) { return _InterlockedXor64(ptr, v); }
-
-uint8_t  xt_atomic_compare_exchange_u8 (xt_atomic_uint8_t*  ptr, uint8_t  expected, uint8_t  desired) { return _InterlockedCompareExchange8 (ptr, desired, expected); }
-uint16_t xt_atomic_compare_exchange_u16(xt_atomic_uint16_t* ptr, uint16_t expected, uint16_t desired) { return _InterlockedCompareExchange16(ptr, desired, expected); }
-uint32_t xt_atomic_compare_exchange_u32(xt_atomic_uint32_t* ptr, uint32_t expected, uint32_t desired) { return _InterlockedCompareExchange  (ptr, desired, expected); }
-uint64_t xt_atomic_compare_exchange_u64(xt_atomic_uint64_t* ptr, uint64_t expected, uint64_t desired) { return _InterlockedCompareExchange64(ptr, desired, expected); }
-int8_t   xt_atomic_compare_exchange_i8 (xt_atomic_int8_t*   ptr, int8_t   expected, int8_t   desired) { return _InterlockedCompareExchange8 (ptr, desired, expected); }
-int16_t  xt_atomic_compare_exchange_i16(xt_atomic_int16_t*  ptr, int16_t  expected, int16_t  desired) { return _InterlockedCompareExchange16(ptr, desired, expected); }
-int32_t  xt_atomic_compare_exchange_i32(xt_atomic_int32_t*  ptr, int32_t  expected, int32_t  desired) { return _InterlockedCompareExchange  (ptr, desired, expected); }
-int64_t  xt_atomic_compare_exchange_i64(xt_atomic_int64_t*  ptr, int64_t  expected, int64_t  desired) { return _InterlockedCompareExchange64(ptr, desired, expected); }
-
-bool xt_spinlock_trylock(xt_spinlock_t*  ptr) { return _InterlockedCompareExchange8(ptr, 1, 0); }
-void xt_spinlock_unlock( xt_spinlock_t*  ptr) { return _InterlockedExchange8(ptr, 0); }
-
+bool xt_spinlock_trylock(xt_spinlock_t*  ptr) { return _InterlockedCompareExchange8((volatile char*)ptr, 1, 0) == 0; }
+void xt_spinlock_unlock( xt_spinlock_t*  ptr) { _InterlockedExchange8((volatile char*)ptr, 0); }
 #else
-
-uint8_t  xt_atomic_load_u8 (const xt_atomic_uint8_t*  ptr) { return __atomic_load_n(ptr, __ATOMIC_SEQ_CST); }
-uint16_t xt_atomic_load_u16(const xt_atomic_uint16_t* ptr) { return __atomic_load_n(ptr, __ATOMIC_SEQ_CST); }
-uint32_t xt_atomic_load_u32(const xt_atomic_uint32_t* ptr) { return __atomic_load_n(ptr, __ATOMIC_SEQ_CST); }
-uint64_t xt_atomic_load_u64(const xt_atomic_uint64_t* ptr) { return __atomic_load_n(ptr, __ATOMIC_SEQ_CST); }
-int8_t   xt_atomic_load_i8 (const xt_atomic_int8_t*   ptr) { return __atomic_load_n(ptr, __ATOMIC_SEQ_CST); }
-int16_t  xt_atomic_load_i16(const xt_atomic_int16_t*  ptr) { return __atomic_load_n(ptr, __ATOMIC_SEQ_CST); }
-int32_t  xt_atomic_load_i32(const xt_atomic_int32_t*  ptr) { return __atomic_load_n(ptr, __ATOMIC_SEQ_CST); }
-int64_t  xt_atomic_load_i64(const xt_atomic_int64_t*  ptr) { return __atomic_load_n(ptr, __ATOMIC_SEQ_CST); }
-
-void xt_atomic_store_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v) { __atomic_store_n(ptr, v, __ATOMIC_SEQ_CST); }
-void xt_atomic_store_u16(xt_atomic_uint16_t* ptr, uint16_t v) { __atomic_store_n(ptr, v, __ATOMIC_SEQ_CST); }
-void xt_atomic_store_u32(xt_atomic_uint32_t* ptr, uint32_t v) { __atomic_store_n(ptr, v, __ATOMIC_SEQ_CST); }
-void xt_atomic_store_u64(xt_atomic_uint64_t* ptr, uint64_t v) { __atomic_store_n(ptr, v, __ATOMIC_SEQ_CST); }
-void xt_atomic_store_i8 (xt_atomic_int8_t*   ptr, int8_t   v) { __atomic_store_n(ptr, v, __ATOMIC_SEQ_CST); }
-void xt_atomic_store_i16(xt_atomic_int16_t*  ptr, int16_t  v) { __atomic_store_n(ptr, v, __ATOMIC_SEQ_CST); }
-void xt_atomic_store_i32(xt_atomic_int32_t*  ptr, int32_t  v) { __atomic_store_n(ptr, v, __ATOMIC_SEQ_CST); }
-void xt_atomic_store_i64(xt_atomic_int64_t*  ptr, int64_t  v) { __atomic_store_n(ptr, v, __ATOMIC_SEQ_CST); }
-
-uint8_t  xt_atomic_exchange_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v) { return __atomic_exchange_n(ptr, v, __ATOMIC_SEQ_CST); }
-uint16_t xt_atomic_exchange_u16(xt_atomic_uint16_t* ptr, uint16_t v) { return __atomic_exchange_n(ptr, v, __ATOMIC_SEQ_CST); }
-uint32_t xt_atomic_exchange_u32(xt_atomic_uint32_t* ptr, uint32_t v) { return __atomic_exchange_n(ptr, v, __ATOMIC_SEQ_CST); }
-uint64_t xt_atomic_exchange_u64(xt_atomic_uint64_t* ptr, uint64_t v) { return __atomic_exchange_n(ptr, v, __ATOMIC_SEQ_CST); }
-int8_t   xt_atomic_exchange_i8 (xt_atomic_int8_t*   ptr, int8_t   v) { return __atomic_exchange_n(ptr, v, __ATOMIC_SEQ_CST); }
-int16_t  xt_atomic_exchange_i16(xt_atomic_int16_t*  ptr, int16_t  v) { return __atomic_exchange_n(ptr, v, __ATOMIC_SEQ_CST); }
-int32_t  xt_atomic_exchange_i32(xt_atomic_int32_t*  ptr, int32_t  v) { return __atomic_exchange_n(ptr, v, __ATOMIC_SEQ_CST); }
-int64_t  xt_atomic_exchange_i64(xt_atomic_int64_t*  ptr, int64_t  v) { return __atomic_exchange_n(ptr, v, __ATOMIC_SEQ_CST); }
-
-uint8_t  xt_atomic_fetch_add_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v) { return __atomic_fetch_add(ptr, v, __ATOMIC_SEQ_CST); }
-uint16_t xt_atomic_fetch_add_u16(xt_atomic_uint16_t* ptr, uint16_t v) { return __atomic_fetch_add(ptr, v, __ATOMIC_SEQ_CST); }
-uint32_t xt_atomic_fetch_add_u32(xt_atomic_uint32_t* ptr, uint32_t v) { return __atomic_fetch_add(ptr, v, __ATOMIC_SEQ_CST); }
-uint64_t xt_atomic_fetch_add_u64(xt_atomic_uint64_t* ptr, uint64_t v) { return __atomic_fetch_add(ptr, v, __ATOMIC_SEQ_CST); }
-int8_t   xt_atomic_fetch_add_i8 (xt_atomic_int8_t*   ptr, int8_t   v) { return __atomic_fetch_add(ptr, v, __ATOMIC_SEQ_CST); }
-int16_t  xt_atomic_fetch_add_i16(xt_atomic_int16_t*  ptr, int16_t  v) { return __atomic_fetch_add(ptr, v, __ATOMIC_SEQ_CST); }
-int32_t  xt_atomic_fetch_add_i32(xt_atomic_int32_t*  ptr, int32_t  v) { return __atomic_fetch_add(ptr, v, __ATOMIC_SEQ_CST); }
-int64_t  xt_atomic_fetch_add_i64(xt_atomic_int64_t*  ptr, int64_t  v) { return __atomic_fetch_add(ptr, v, __ATOMIC_SEQ_CST); }
-
-uint8_t  xt_atomic_fetch_sub_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v) { return __atomic_fetch_sub(ptr, v, __ATOMIC_SEQ_CST); }
-uint16_t xt_atomic_fetch_sub_u16(xt_atomic_uint16_t* ptr, uint16_t v) { return __atomic_fetch_sub(ptr, v, __ATOMIC_SEQ_CST); }
-uint32_t xt_atomic_fetch_sub_u32(xt_atomic_uint32_t* ptr, uint32_t v) { return __atomic_fetch_sub(ptr, v, __ATOMIC_SEQ_CST); }
-uint64_t xt_atomic_fetch_sub_u64(xt_atomic_uint64_t* ptr, uint64_t v) { return __atomic_fetch_sub(ptr, v, __ATOMIC_SEQ_CST); }
-int8_t   xt_atomic_fetch_sub_i8 (xt_atomic_int8_t*   ptr, int8_t   v) { return __atomic_fetch_sub(ptr, v, __ATOMIC_SEQ_CST); }
-int16_t  xt_atomic_fetch_sub_i16(xt_atomic_int16_t*  ptr, int16_t  v) { return __atomic_fetch_sub(ptr, v, __ATOMIC_SEQ_CST); }
-int32_t  xt_atomic_fetch_sub_i32(xt_atomic_int32_t*  ptr, int32_t  v) { return __atomic_fetch_sub(ptr, v, __ATOMIC_SEQ_CST); }
-int64_t  xt_atomic_fetch_sub_i64(xt_atomic_int64_t*  ptr, int64_t  v) { return __atomic_fetch_sub(ptr, v, __ATOMIC_SEQ_CST); }
-
-uint8_t  xt_atomic_fetch_and_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v) { return __atomic_fetch_and(ptr, v, __ATOMIC_SEQ_CST); }
-uint16_t xt_atomic_fetch_and_u16(xt_atomic_uint16_t* ptr, uint16_t v) { return __atomic_fetch_and(ptr, v, __ATOMIC_SEQ_CST); }
-uint32_t xt_atomic_fetch_and_u32(xt_atomic_uint32_t* ptr, uint32_t v) { return __atomic_fetch_and(ptr, v, __ATOMIC_SEQ_CST); }
-uint64_t xt_atomic_fetch_and_u64(xt_atomic_uint64_t* ptr, uint64_t v) { return __atomic_fetch_and(ptr, v, __ATOMIC_SEQ_CST); }
-int8_t   xt_atomic_fetch_and_i8 (xt_atomic_int8_t*   ptr, int8_t   v) { return __atomic_fetch_and(ptr, v, __ATOMIC_SEQ_CST); }
-int16_t  xt_atomic_fetch_and_i16(xt_atomic_int16_t*  ptr, int16_t  v) { return __atomic_fetch_and(ptr, v, __ATOMIC_SEQ_CST); }
-int32_t  xt_atomic_fetch_and_i32(xt_atomic_int32_t*  ptr, int32_t  v) { return __atomic_fetch_and(ptr, v, __ATOMIC_SEQ_CST); }
-int64_t  xt_atomic_fetch_and_i64(xt_atomic_int64_t*  ptr, int64_t  v) { return __atomic_fetch_and(ptr, v, __ATOMIC_SEQ_CST); }
-
-uint8_t  xt_atomic_fetch_or_u8 (xt_atomic_uint8_t* ptr, uint8_t  v) { return __atomic_fetch_or(ptr, v, __ATOMIC_SEQ_CST); }
-uint16_t xt_atomic_fetch_or_u16(xt_atomic_uint16_t*ptr, uint16_t v) { return __atomic_fetch_or(ptr, v, __ATOMIC_SEQ_CST); }
-uint32_t xt_atomic_fetch_or_u32(xt_atomic_uint32_t*ptr, uint32_t v) { return __atomic_fetch_or(ptr, v, __ATOMIC_SEQ_CST); }
-uint64_t xt_atomic_fetch_or_u64(xt_atomic_uint64_t*ptr, uint64_t v) { return __atomic_fetch_or(ptr, v, __ATOMIC_SEQ_CST); }
-int8_t   xt_atomic_fetch_or_i8 (xt_atomic_int8_t*ptr,   int8_t   v) { return __atomic_fetch_or(ptr, v, __ATOMIC_SEQ_CST); }
-int16_t  xt_atomic_fetch_or_i16(xt_atomic_int16_t*ptr,  int16_t  v) { return __atomic_fetch_or(ptr, v, __ATOMIC_SEQ_CST); }
-int32_t  xt_atomic_fetch_or_i32(xt_atomic_int32_t*ptr,  int32_t  v) { return __atomic_fetch_or(ptr, v, __ATOMIC_SEQ_CST); }
-int64_t  xt_atomic_fetch_or_i64(xt_atomic_int64_t*ptr,  int64_t  v) { return __atomic_fetch_or(ptr, v, __ATOMIC_SEQ_CST); }
-
-uint8_t  xt_atomic_fetch_xor_u8 (xt_atomic_uint8_t*  ptr, uint8_t  v) { return __atomic_fetch_xor(ptr, v, __ATOMIC_SEQ_CST); }
-uint16_t xt_atomic_fetch_xor_u16(xt_atomic_uint16_t* ptr, uint16_t v) { return __atomic_fetch_xor(ptr, v, __ATOMIC_SEQ_CST); }
-uint32_t xt_atomic_fetch_xor_u32(xt_atomic_uint32_t* ptr, uint32_t v) { return __atomic_fetch_xor(ptr, v, __ATOMIC_SEQ_CST); }
-uint64_t xt_atomic_fetch_xor_u64(xt_atomic_uint64_t* ptr, uint64_t v) { return __atomic_fetch_xor(ptr, v, __ATOMIC_SEQ_CST); }
-int8_t   xt_atomic_fetch_xor_i8 (xt_atomic_int8_t*   ptr, int8_t   v) { return __atomic_fetch_xor(ptr, v, __ATOMIC_SEQ_CST); }
-int16_t  xt_atomic_fetch_xor_i16(xt_atomic_int16_t*  ptr, int16_t  v) { return __atomic_fetch_xor(ptr, v, __ATOMIC_SEQ_CST); }
-int32_t  xt_atomic_fetch_xor_i32(xt_atomic_int32_t*  ptr, int32_t  v) { return __atomic_fetch_xor(ptr, v, __ATOMIC_SEQ_CST); }
-int64_t  xt_atomic_fetch_xor_i64(xt_atomic_int64_t*  ptr, int64_t  v) { return __atomic_fetch_xor(ptr, v, __ATOMIC_SEQ_CST); }
-
-uint8_t  xt_atomic_compare_exchange_u8 (xt_atomic_uint8_t*  ptr, uint8_t  expected, uint8_t  desired) { return __sync_val_compare_and_swap(           ptr, expected, desired); }
-uint16_t xt_atomic_compare_exchange_u16(xt_atomic_uint16_t* ptr, uint16_t expected, uint16_t desired) { return __sync_val_compare_and_swap(           ptr, expected, desired); }
-uint32_t xt_atomic_compare_exchange_u32(xt_atomic_uint32_t* ptr, uint32_t expected, uint32_t desired) { return __sync_val_compare_and_swap(           ptr, expected, desired); }
-uint64_t xt_atomic_compare_exchange_u64(xt_atomic_uint64_t* ptr, uint64_t expected, uint64_t desired) { return __sync_val_compare_and_swap(           ptr, expected, desired); }
-int8_t   xt_atomic_compare_exchange_i8 (xt_atomic_int8_t*   ptr, int8_t   expected, int8_t   desired) { return __sync_val_compare_and_swap((uint8_t*) ptr, expected, desired); }
-int16_t  xt_atomic_compare_exchange_i16(xt_atomic_int16_t*  ptr, int16_t  expected, int16_t  desired) { return __sync_val_compare_and_swap((uint16_t*)ptr, expected, desired); }
-int32_t  xt_atomic_compare_exchange_i32(xt_atomic_int32_t*  ptr, int32_t  expected, int32_t  desired) { return __sync_val_compare_and_swap((uint32_t*)ptr, expected, desired); }
-int64_t  xt_atomic_compare_exchange_i64(xt_atomic_int64_t*  ptr, int64_t  expected, int64_t  desired) { return __sync_val_compare_and_swap((uint64_t*)ptr, expected, desired); }
-
-bool xt_spinlock_trylock(xt_spinlock_t* ptr) { return __atomic_exchange_n(ptr, 1, __ATOMIC_ACQUIRE); }
+bool xt_spinlock_trylock(xt_spinlock_t* ptr) { return __atomic_exchange_n(ptr, 1, __ATOMIC_ACQUIRE) == 0; }
 void xt_spinlock_unlock(xt_spinlock_t* ptr)  { __atomic_store_n(ptr, 0, __ATOMIC_RELEASE); }
-
 #endif
 
 struct xthread_internal_signal_t
@@ -582,13 +1969,16 @@ struct xthread_internal_signal_t
     CRITICAL_SECTION   mutex;
     CONDITION_VARIABLE condition;
     int                value;
-#elif defined(__linux__) || defined(__APPLE__) || defined(__ANDROID__)
+#elif defined(__linux__)
+    // 0 == not raised, 1 == raised, 2 == not raised & a waiter may be parked on the futex
+    xt_atomic_uint32_t value;
+#elif defined(__APPLE__)
     pthread_mutex_t mutex;
     pthread_cond_t  condition;
     int             value;
 #endif
 };
-_Static_assert(sizeof(xt_signal_t) >= sizeof(struct xthread_internal_signal_t), "too smol");
+XTHREAD_STATIC_ASSERT(sizeof(xt_signal_t) >= sizeof(struct xthread_internal_signal_t), "too smol");
 
 void xthread_signal_init(xt_signal_t* signal)
 {
@@ -598,7 +1988,9 @@ void xthread_signal_init(xt_signal_t* signal)
     InitializeCriticalSectionAndSpinCount(&internal->mutex, 32);
     InitializeConditionVariable(&internal->condition);
     internal->value = 0;
-#elif defined(__linux__) || defined(__APPLE__) || defined(__ANDROID__)
+#elif defined(__linux__)
+    xt_atomic_store_u32(&internal->value, 0);
+#elif defined(__APPLE__)
     pthread_mutex_init(&internal->mutex, NULL);
     pthread_cond_init(&internal->condition, NULL);
     internal->value = 0;
@@ -611,7 +2003,9 @@ void xthread_signal_term(xt_signal_t* signal)
 
 #if defined(_WIN32)
     DeleteCriticalSection(&internal->mutex);
-#elif defined(__linux__) || defined(__APPLE__) || defined(__ANDROID__)
+#elif defined(__linux__)
+    (void)internal; // Nothing to free
+#elif defined(__APPLE__)
     pthread_mutex_destroy(&internal->mutex);
     pthread_cond_destroy(&internal->condition);
 #endif
@@ -626,7 +2020,11 @@ void xthread_signal_raise(xt_signal_t* signal)
     internal->value = 1;
     LeaveCriticalSection(&internal->mutex);
     WakeConditionVariable(&internal->condition);
-#elif defined(__linux__) || defined(__APPLE__) || defined(__ANDROID__)
+#elif defined(__linux__)
+    // Only enter the kernel if someone is parked
+    if (xt_atomic_exchange_explicit_u32(&internal->value, 1, xt_memory_order_release) == 2)
+        xthread_futex_wake(&internal->value, 1);
+#elif defined(__APPLE__)
     pthread_mutex_lock(&internal->mutex);
     internal->value = 1;
     pthread_mutex_unlock(&internal->mutex);
@@ -656,17 +2054,49 @@ int xthread_signal_wait(xt_signal_t* signal, int timeout_ms)
     LeaveCriticalSection(&internal->mutex);
     return ! timed_out;
 
-#elif defined(__linux__) || defined(__APPLE__) || defined(__ANDROID__)
+#elif defined(__linux__)
+
+    struct timespec deadline;
+    if (timeout_ms > 0)
+        xthread_deadline_ms(&deadline, timeout_ms);
+
+    // Once we have parked, other waiters may be parked too. Consume the signal by setting 2 instead of 0 so the next
+    // raise still wakes them
+    uint32_t consumed = 0;
+    uint32_t v        = xt_atomic_load_explicit_u32(&internal->value, xt_memory_order_relaxed);
+    for (;;)
+    {
+        if (v == 1)
+        {
+            v = xt_atomic_compare_exchange_explicit_u32(&internal->value, 1, consumed, xt_memory_order_acquire);
+            if (v == 1)
+                return 1;
+            continue;
+        }
+        if (timeout_ms == 0)
+            return 0;
+        if (v == 0)
+        {
+            v = xt_atomic_compare_exchange_explicit_u32(&internal->value, 0, 2, xt_memory_order_relaxed);
+            if (v != 0)
+                continue;
+        }
+        if (xthread_futex_wait(&internal->value, 2, timeout_ms < 0 ? NULL : &deadline) == ETIMEDOUT)
+            return 0;
+        consumed = 2;
+        v        = xt_atomic_load_explicit_u32(&internal->value, xt_memory_order_relaxed);
+    }
+
+#elif defined(__APPLE__)
 
     struct timespec ts;
     if (timeout_ms >= 0)
     {
-        struct timeval tv;
-        gettimeofday(&tv, NULL);
-        ts.tv_sec  = time(NULL) + timeout_ms / 1000;
-        ts.tv_nsec = tv.tv_usec * 1000 + 1000 * 1000 * (timeout_ms % 1000);
-        ts.tv_sec  += ts.tv_nsec / (1000 * 1000 * 1000);
-        ts.tv_nsec %= (1000 * 1000 * 1000);
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec  += timeout_ms / 1000;
+        ts.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+        ts.tv_sec  += ts.tv_nsec / 1000000000;
+        ts.tv_nsec %= 1000000000;
     }
 
     int timed_out = 0;
@@ -802,30 +2232,273 @@ void* xthread_queue_consume(xt_queue_t* queue, int timeout_ms)
 
 int xthread_queue_count(xt_queue_t* queue) { return xt_atomic_load_i32(&queue->count); }
 
-void xt_spinlock_lock(xt_atomic_uint8_t* ptr)
+void xthread_mpmc_queue_init(xt_mpmc_queue_t* queue, xt_mpmc_cell_t* cells, int size)
+{
+    XTHREAD_ASSERT(size >= 2 && (size & (size - 1)) == 0, "size must be a power of 2");
+    queue->cells = cells;
+    queue->mask  = size - 1;
+    for (int i = 0; i < size; i++)
+        xt_atomic_store_explicit_u64(&cells[i].sequence, i, xt_memory_order_relaxed);
+    xt_atomic_store_explicit_u64(&queue->enqueue_pos, 0, xt_memory_order_relaxed);
+    xt_atomic_store_explicit_u64(&queue->dequeue_pos, 0, xt_memory_order_relaxed);
+    xthread_signal_init(&queue->data_ready);
+    xthread_signal_init(&queue->space_open);
+    xt_atomic_thread_fence(xt_memory_order_seq_cst);
+}
+
+void xthread_mpmc_queue_term(xt_mpmc_queue_t* queue)
+{
+    xthread_signal_term(&queue->space_open);
+    xthread_signal_term(&queue->data_ready);
+}
+
+bool xthread_mpmc_queue_try_push(xt_mpmc_queue_t* queue, void* value)
+{
+    xt_mpmc_cell_t* cell;
+    uint64_t        pos = xt_atomic_load_explicit_u64(&queue->enqueue_pos, xt_memory_order_relaxed);
+    for (;;)
+    {
+        cell          = &queue->cells[pos & queue->mask];
+        uint64_t seq  = xt_atomic_load_explicit_u64(&cell->sequence, xt_memory_order_acquire);
+        int64_t  diff = (int64_t)(seq - pos);
+        if (diff == 0)
+        {
+            uint64_t prev = xt_atomic_compare_exchange_explicit_u64(&queue->enqueue_pos, pos, pos + 1, xt_memory_order_relaxed);
+            if (prev == pos)
+                break;
+            pos = prev;
+        }
+        else if (diff < 0) // full
+            return false;
+        else // another producer beat us to this cell
+            pos = xt_atomic_load_explicit_u64(&queue->enqueue_pos, xt_memory_order_relaxed);
+    }
+    cell->value = value;
+    xt_atomic_store_explicit_u64(&cell->sequence, pos + 1, xt_memory_order_release);
+    return true;
+}
+
+bool xthread_mpmc_queue_try_pop(xt_mpmc_queue_t* queue, void** value)
+{
+    xt_mpmc_cell_t* cell;
+    uint64_t        pos = xt_atomic_load_explicit_u64(&queue->dequeue_pos, xt_memory_order_relaxed);
+    for (;;)
+    {
+        cell          = &queue->cells[pos & queue->mask];
+        uint64_t seq  = xt_atomic_load_explicit_u64(&cell->sequence, xt_memory_order_acquire);
+        int64_t  diff = (int64_t)(seq - (pos + 1));
+        if (diff == 0)
+        {
+            uint64_t prev = xt_atomic_compare_exchange_explicit_u64(&queue->dequeue_pos, pos, pos + 1, xt_memory_order_relaxed);
+            if (prev == pos)
+                break;
+            pos = prev;
+        }
+        else if (diff < 0) // empty
+            return false;
+        else // another consumer beat us to this cell
+            pos = xt_atomic_load_explicit_u64(&queue->dequeue_pos, xt_memory_order_relaxed);
+    }
+    *value = cell->value;
+    xt_atomic_store_explicit_u64(&cell->sequence, pos + queue->mask + 1, xt_memory_order_release);
+    return true;
+}
+
+int xthread_mpmc_queue_produce(xt_mpmc_queue_t* queue, void* value, int timeout_ms)
+{
+    while (! xthread_mpmc_queue_try_push(queue, value))
+    {
+        if (timeout_ms == 0)
+            return 0;
+        if (xthread_signal_wait(
+                &queue->space_open,
+                timeout_ms == XTHREAD_QUEUE_WAIT_INFINITE ? XTHREAD_SIGNAL_WAIT_INFINITE : timeout_ms) == 0)
+            return 0;
+    }
+    xthread_signal_raise(&queue->data_ready);
+    // The signal is binary, so several pops may have collapsed into one raise. Pass it on to the next producer
+    if (xthread_mpmc_queue_count(queue) <= (int)queue->mask)
+        xthread_signal_raise(&queue->space_open);
+    return 1;
+}
+
+void* xthread_mpmc_queue_consume(xt_mpmc_queue_t* queue, int timeout_ms)
+{
+    void* value = NULL;
+    while (! xthread_mpmc_queue_try_pop(queue, &value))
+    {
+        if (timeout_ms == 0)
+            return NULL;
+        if (xthread_signal_wait(
+                &queue->data_ready,
+                timeout_ms == XTHREAD_QUEUE_WAIT_INFINITE ? XTHREAD_SIGNAL_WAIT_INFINITE : timeout_ms) == 0)
+            return NULL;
+    }
+    xthread_signal_raise(&queue->space_open);
+    // Same as above, pass the wake up on to the next consumer
+    if (xthread_mpmc_queue_count(queue) > 0)
+        xthread_signal_raise(&queue->data_ready);
+    return value;
+}
+
+int xthread_mpmc_queue_count(xt_mpmc_queue_t* queue)
+{
+    uint64_t head = xt_atomic_load_explicit_u64(&queue->dequeue_pos, xt_memory_order_relaxed);
+    uint64_t tail = xt_atomic_load_explicit_u64(&queue->enqueue_pos, xt_memory_order_relaxed);
+    return tail > head ? (int)(tail - head) : 0;
+}
+
+void xthread_spsc_ring_init(xt_spsc_ring_t* ring, void* buffer, uint32_t stride, uint32_t size)
+{
+    XTHREAD_ASSERT(size >= 2 && (size & (size - 1)) == 0, "size must be a power of 2");
+    XTHREAD_ASSERT(size <= (1u << 31), "size too big");
+    ring->buffer      = (char*)buffer;
+    ring->stride      = stride;
+    ring->mask        = size - 1;
+    ring->cached_head = 0;
+    ring->cached_tail = 0;
+    xt_atomic_store_explicit_u32(&ring->tail, 0, xt_memory_order_relaxed);
+    xt_atomic_store_explicit_u32(&ring->head, 0, xt_memory_order_relaxed);
+    xt_atomic_thread_fence(xt_memory_order_seq_cst);
+}
+
+// Copies n items in/out of the ring starting at index, wrapping around the end of the buffer
+static void xthread_spsc_ring_copy(xt_spsc_ring_t* ring, uint32_t index, void* items, uint32_t n, bool in)
+{
+    uint32_t start = index & ring->mask;
+    uint32_t first = ring->mask + 1 - start;
+    if (first > n)
+        first = n;
+
+    char* slot = ring->buffer + (size_t)start * ring->stride;
+    char* wrap = (char*)items + (size_t)first * ring->stride;
+    if (in)
+    {
+        memcpy(slot, items, (size_t)first * ring->stride);
+        memcpy(ring->buffer, wrap, (size_t)(n - first) * ring->stride);
+    }
+    else
+    {
+        memcpy(items, slot, (size_t)first * ring->stride);
+        memcpy(wrap, ring->buffer, (size_t)(n - first) * ring->stride);
+    }
+}
+
+uint32_t xthread_spsc_ring_produce_n(xt_spsc_ring_t* ring, const void* items, uint32_t n)
+{
+    uint32_t size  = ring->mask + 1;
+    uint32_t tail  = xt_atomic_load_explicit_u32(&ring->tail, xt_memory_order_relaxed);
+    uint32_t space = size - (tail - ring->cached_head);
+    if (space < n)
+    {
+        ring->cached_head = xt_atomic_load_explicit_u32(&ring->head, xt_memory_order_acquire);
+        space             = size - (tail - ring->cached_head);
+        if (n > space)
+            n = space;
+    }
+    if (n == 0)
+        return 0;
+
+    xthread_spsc_ring_copy(ring, tail, (void*)items, n, true);
+    xt_atomic_store_explicit_u32(&ring->tail, tail + n, xt_memory_order_release);
+    return n;
+}
+
+uint32_t xthread_spsc_ring_consume_n(xt_spsc_ring_t* ring, void* items, uint32_t n)
+{
+    uint32_t head      = xt_atomic_load_explicit_u32(&ring->head, xt_memory_order_relaxed);
+    uint32_t available = ring->cached_tail - head;
+    if (available < n)
+    {
+        ring->cached_tail = xt_atomic_load_explicit_u32(&ring->tail, xt_memory_order_acquire);
+        available         = ring->cached_tail - head;
+        if (n > available)
+            n = available;
+    }
+    if (n == 0)
+        return 0;
+
+    xthread_spsc_ring_copy(ring, head, items, n, false);
+    xt_atomic_store_explicit_u32(&ring->head, head + n, xt_memory_order_release);
+    return n;
+}
+
+bool xthread_spsc_ring_produce(xt_spsc_ring_t* ring, const void* item) { return xthread_spsc_ring_produce_n(ring, item, 1) == 1; }
+bool xthread_spsc_ring_consume(xt_spsc_ring_t* ring, void* item)       { return xthread_spsc_ring_consume_n(ring, item, 1) == 1; }
+
+uint32_t xthread_spsc_ring_count(xt_spsc_ring_t* ring)
+{
+    uint32_t head = xt_atomic_load_explicit_u32(&ring->head, xt_memory_order_acquire);
+    uint32_t tail = xt_atomic_load_explicit_u32(&ring->tail, xt_memory_order_acquire);
+    return tail - head;
+}
+
+#if defined(_WIN32)
+#pragma comment(lib, "Synchronization.lib")
+bool xt_atomic_wait_u32(xt_atomic_uint32_t* addr, uint32_t expected, int timeout_ms)
+{
+    DWORD ms = timeout_ms == XTHREAD_SIGNAL_WAIT_INFINITE ? INFINITE : (DWORD)timeout_ms;
+    return WaitOnAddress((volatile VOID*)addr, &expected, sizeof(expected), ms) || GetLastError() != ERROR_TIMEOUT;
+}
+void xt_atomic_notify(xt_atomic_uint32_t* addr, bool all)
+{
+    if (all)
+        WakeByAddressAll((PVOID)addr);
+    else
+        WakeByAddressSingle((PVOID)addr);
+}
+#elif defined(__linux__)
+bool xt_atomic_wait_u32(xt_atomic_uint32_t* addr, uint32_t expected, int timeout_ms)
+{
+    if (timeout_ms == XTHREAD_SIGNAL_WAIT_INFINITE)
+        return xthread_futex_wait(addr, expected, NULL) == 0;
+    struct timespec deadline;
+    xthread_deadline_ms(&deadline, timeout_ms);
+    return xthread_futex_wait(addr, expected, &deadline) == 0;
+}
+void xt_atomic_notify(xt_atomic_uint32_t* addr, bool all) { xthread_futex_wake(addr, all ? INT32_MAX : 1); }
+#elif defined(__APPLE__)
+// Private but stable, libc++ builds std::atomic::wait on these
+extern int __ulock_wait(uint32_t operation, void* addr, uint64_t value, uint32_t timeout_us);
+extern int __ulock_wake(uint32_t operation, void* addr, uint64_t wake_value);
+#define XTHREAD_UL_COMPARE_AND_WAIT 1
+#define XTHREAD_ULF_WAKE_ALL        0x00000100
+#define XTHREAD_ULF_NO_ERRNO        0x01000000
+bool xt_atomic_wait_u32(xt_atomic_uint32_t* addr, uint32_t expected, int timeout_ms)
+{
+    // 0 means forever to __ulock_wait
+    uint32_t us = 0;
+    if (timeout_ms != XTHREAD_SIGNAL_WAIT_INFINITE)
+        us = timeout_ms == 0 ? 1 : timeout_ms >= UINT32_MAX / 1000 ? UINT32_MAX : (uint32_t)timeout_ms * 1000;
+    int      res = __ulock_wait(XTHREAD_UL_COMPARE_AND_WAIT | XTHREAD_ULF_NO_ERRNO, (void*)addr, expected, us);
+    return res != -ETIMEDOUT;
+}
+void xt_atomic_notify(xt_atomic_uint32_t* addr, bool all)
+{
+    __ulock_wake(XTHREAD_UL_COMPARE_AND_WAIT | XTHREAD_ULF_NO_ERRNO | (all ? XTHREAD_ULF_WAKE_ALL : 0), (void*)addr, 0);
+}
+#endif
+
+// Progressive backoff, as used by xt_spinlock_lock. Call between failed attempts with an increasing iteration
+// Returns false once 'iteration' is past the last stage, after which the caller should yield or sleep
+static bool xthread_spin_backoff(int iteration)
 {
-#ifdef __SSE2__
+#if defined(__x86_64__) || defined(_M_X64)
 
     // Stage 1: ~25ns
-    for (int i = 0; i < 5; i++)
-        if (xt_spinlock_trylock(ptr))
-            return;
+    if (iteration < 5)
+        return true;
 
     // Stage 2: ~400ns
-    for (int i = 0; i < 10; i++)
+    if (iteration < 5 + 10)
     {
-        if (xt_spinlock_trylock(ptr))
-            return;
-
         _mm_pause();
+        return true;
     }
 
     // Stage 3: ~400ns
-    for (int i = 0; i < 3000; i++)
+    if (iteration < 5 + 10 + 3000)
     {
-        if (xt_spinlock_trylock(ptr))
-            return;
-
         _mm_pause();
         _mm_pause();
         _mm_pause();
@@ -838,26 +2511,25 @@ void xt_spinlock_lock(xt_atomic_uint8_t* ptr)
         _mm_pause();
 
         xthread_yield();
+        return true;
     }
 
-#elif defined(__arm64__)
+#else
 
     // Stage 1: ~20ns
-    for (int i = 0; i < 5; i++)
-        if (xt_spinlock_trylock(ptr))
-            return;
+    if (iteration < 5)
+        return true;
 
     // Stage 2: ~1ms
-    for (int i = 0; i < 750; i++)
+    if (iteration < 5 + 750)
     {
-        if (xt_spinlock_trylock(ptr))
-            return;
-
         __wfe(); // ~1300ns
 
         xthread_yield();
+        return true;
     }
 #endif
+    return false;
 /*
 NOTE: only this function is under the Boost license
 https://github.com/crill-dev/crill
@@ -886,7 +2558,2292 @@ FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
 ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
 DEALINGS IN THE SOFTWARE.
 */
+
+}
+
+#define XTHREAD_TRIPLE_BUFFER_NEW 4u
+
+void xthread_triple_buffer_init(xt_triple_buffer_t* tb, void* buffers, uint32_t stride)
+{
+    tb->buffers = (char*)buffers;
+    tb->stride  = stride;
+    tb->back    = 0;
+    tb->front   = 1;
+    xt_atomic_store_explicit_u32(&tb->middle, 2, xt_memory_order_relaxed);
+    xt_atomic_thread_fence(xt_memory_order_seq_cst);
+}
+
+void* xthread_triple_buffer_write_begin(xt_triple_buffer_t* tb) { return tb->buffers + tb->back * tb->stride; }
+
+void xthread_triple_buffer_write_end(xt_triple_buffer_t* tb)
+{
+    // Release publishes our writes, acquire makes sure the reader is done with the buffer we get back
+    uint32_t prev = xt_atomic_exchange_explicit_u32(&tb->middle, tb->back | XTHREAD_TRIPLE_BUFFER_NEW, xt_memory_order_acq_rel);
+    tb->back      = prev & 3;
+}
+
+const void* xthread_triple_buffer_read(xt_triple_buffer_t* tb, bool* is_new)
+{
+    bool fresh = (xt_atomic_load_explicit_u32(&tb->middle, xt_memory_order_relaxed) & XTHREAD_TRIPLE_BUFFER_NEW) != 0;
+    if (fresh)
+        tb->front = xt_atomic_exchange_explicit_u32(&tb->middle, tb->front, xt_memory_order_acq_rel) & 3;
+    if (is_new)
+        *is_new = fresh;
+    return tb->buffers + tb->front * tb->stride;
+}
+
+void xthread_triple_buffer_write(xt_triple_buffer_t* tb, const void* item)
+{
+    memcpy(xthread_triple_buffer_write_begin(tb), item, tb->stride);
+    xthread_triple_buffer_write_end(tb);
+}
+
+#ifdef XTHREAD_HAS_CAS128
+void xthread_stack_init(xt_stack_t* stack)
+{
+    stack->head.lo = 0;
+    stack->head.hi = 0;
+    xt_atomic_thread_fence(xt_memory_order_seq_cst);
+}
+
+// Torn reads are fine, the CAS fails and we try again with the value it returns
+static xt_uint128_t xthread_stack_load_head(xt_stack_t* stack)
+{
+    xt_uint128_t head;
+    head.hi = xt_atomic_load_explicit_u64((xt_atomic_uint64_t*)&stack->head.hi, xt_memory_order_acquire);
+    head.lo = xt_atomic_load_explicit_u64((xt_atomic_uint64_t*)&stack->head.lo, xt_memory_order_acquire);
+    return head;
+}
+
+void xthread_stack_push(xt_stack_t* stack, xt_stack_node_t* node)
+{
+    xt_uint128_t head = xthread_stack_load_head(stack);
+    for (;;)
+    {
+        node->next           = (xt_stack_node_t*)(uintptr_t)head.lo;
+        xt_uint128_t desired = {(uint64_t)(uintptr_t)node, head.hi + 1};
+        xt_uint128_t prev    = xt_atomic_compare_exchange_u128(&stack->head, head, desired);
+        if (prev.lo == head.lo && prev.hi == head.hi)
+            return;
+        head = prev;
+    }
+}
+
+xt_stack_node_t* xthread_stack_pop(xt_stack_t* stack)
+{
+    xt_uint128_t head = xthread_stack_load_head(stack);
+    for (;;)
+    {
+        xt_stack_node_t* node = (xt_stack_node_t*)(uintptr_t)head.lo;
+        if (node == NULL)
+            return NULL;
+        // 'node' may already be popped by someone else, in which case the tag has moved on and the CAS fails
+        xt_stack_node_t* next = (xt_stack_node_t*)xt_atomic_load_explicit_ptr((xt_atomic_ptr_t*)&node->next, xt_memory_order_relaxed);
+        xt_uint128_t desired  = {(uint64_t)(uintptr_t)next, head.hi + 1};
+        xt_uint128_t prev     = xt_atomic_compare_exchange_u128(&stack->head, head, desired);
+        if (prev.lo == head.lo && prev.hi == head.hi)
+            return node;
+        head = prev;
+    }
+}
+#else
+void xthread_stack_init(xt_stack_t* stack)
+{
+    stack->head = NULL;
+    stack->lock = 0;
+    xt_atomic_thread_fence(xt_memory_order_seq_cst);
+}
+
+void xthread_stack_push(xt_stack_t* stack, xt_stack_node_t* node)
+{
+    xt_spinlock_lock(&stack->lock);
+    node->next  = stack->head;
+    stack->head = node;
+    xt_spinlock_unlock(&stack->lock);
+}
+
+xt_stack_node_t* xthread_stack_pop(xt_stack_t* stack)
+{
+    xt_spinlock_lock(&stack->lock);
+    xt_stack_node_t* node = stack->head;
+    if (node)
+        stack->head = node->next;
+    xt_spinlock_unlock(&stack->lock);
+    return node;
+}
+#endif
+
+void xthread_freelist_init(xt_freelist_t* list, void* memory, size_t stride, size_t count)
+{
+    XTHREAD_ASSERT(stride >= sizeof(xt_stack_node_t), "stride too small");
+    xthread_stack_init(&list->stack);
+    // Pushed in reverse so items come back out in address order
+    for (size_t i = count; i-- > 0;)
+        xthread_stack_push(&list->stack, (xt_stack_node_t*)((char*)memory + i * stride));
+}
+
+void* xthread_freelist_alloc(xt_freelist_t* list) { return xthread_stack_pop(&list->stack); }
+void  xthread_freelist_free(xt_freelist_t* list, void* item) { xthread_stack_push(&list->stack, (xt_stack_node_t*)item); }
+
+// The queue always contains at least one node. When empty that's 'stub', which gets pushed back in whenever the
+// consumer is about to take the last real node
+void xthread_mpsc_queue_init(xt_mpsc_queue_t* queue)
+{
+    xt_atomic_store_explicit_ptr(&queue->stub.next, NULL, xt_memory_order_relaxed);
+    xt_atomic_store_explicit_ptr(&queue->head, &queue->stub, xt_memory_order_relaxed);
+    queue->tail = &queue->stub;
+    xt_atomic_thread_fence(xt_memory_order_seq_cst);
+}
+
+void xthread_mpsc_queue_push(xt_mpsc_queue_t* queue, xt_mpsc_node_t* node)
+{
+    xt_atomic_store_explicit_ptr(&node->next, NULL, xt_memory_order_relaxed);
+    xt_mpsc_node_t* prev = (xt_mpsc_node_t*)xt_atomic_exchange_explicit_ptr(&queue->head, node, xt_memory_order_acq_rel);
+    // Between the exchange and this store the consumer can't see past 'prev'
+    xt_atomic_store_explicit_ptr(&prev->next, node, xt_memory_order_release);
+}
+
+xt_mpsc_node_t* xthread_mpsc_queue_pop(xt_mpsc_queue_t* queue)
+{
+    xt_mpsc_node_t* tail = queue->tail;
+    xt_mpsc_node_t* next = (xt_mpsc_node_t*)xt_atomic_load_explicit_ptr(&tail->next, xt_memory_order_acquire);
+    if (tail == &queue->stub)
+    {
+        if (next == NULL)
+            return NULL;
+        queue->tail = next;
+        tail        = next;
+        next        = (xt_mpsc_node_t*)xt_atomic_load_explicit_ptr(&next->next, xt_memory_order_acquire);
+    }
+    if (next)
+    {
+        queue->tail = next;
+        return tail;
+    }
+
+    // 'tail' is the last linked node. If it isn't the head a producer is part way through a push
+    xt_mpsc_node_t* head = (xt_mpsc_node_t*)xt_atomic_load_explicit_ptr(&queue->head, xt_memory_order_acquire);
+    if (tail != head)
+        return NULL;
+
+    // Put the stub back behind 'tail' so we can take it
+    xthread_mpsc_queue_push(queue, &queue->stub);
+    next = (xt_mpsc_node_t*)xt_atomic_load_explicit_ptr(&tail->next, xt_memory_order_acquire);
+    if (next)
+    {
+        queue->tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+int xthread_mpsc_queue_drain(xt_mpsc_queue_t* queue, int max_items, xt_mpsc_drain_fn fn, void* ctx)
+{
+    int             n = 0;
+    xt_mpsc_node_t* node;
+    while (n < max_items && (node = xthread_mpsc_queue_pop(queue)) != NULL)
+    {
+        fn(ctx, node);
+        n++;
+    }
+    return n;
+}
+
+void xt_spinlock_lock(xt_spinlock_t* ptr)
+{
+    for (int i = 0; ! xt_spinlock_trylock(ptr); i++)
+        if (! xthread_spin_backoff(i))
+            xthread_yield();
+}
+
+// 0 = unlocked, 1 = locked, 2 = locked and there may be threads sleeping
+// Ulrich Drepper - Futexes Are Tricky (mutex take 2)
+// https://www.akkadia.org/drepper/futex.pdf
+#ifndef XTHREAD_FASTMUTEX_SPIN_COUNT
+#define XTHREAD_FASTMUTEX_SPIN_COUNT 15 // Stages 1 & 2 of the spinlocks backoff
+#endif
+
+bool xt_fastmutex_trylock(xt_fastmutex_t* mutex)
+{
+    return xt_atomic_compare_exchange_explicit_u32(mutex, 0, 1, xt_memory_order_acquire) == 0;
+}
+
+void xt_fastmutex_lock(xt_fastmutex_t* mutex)
+{
+    uint32_t c = xt_atomic_compare_exchange_explicit_u32(mutex, 0, 1, xt_memory_order_acquire);
+    if (c == 0)
+        return;
+
+    // Locked by someone else. Spin briefly, critical sections are usually short
+    for (int i = 0; i < XTHREAD_FASTMUTEX_SPIN_COUNT; i++)
+    {
+        xthread_spin_backoff(i);
+        c = xt_atomic_load_explicit_u32(mutex, xt_memory_order_relaxed);
+        if (c == 0)
+        {
+            c = xt_atomic_compare_exchange_explicit_u32(mutex, 0, 1, xt_memory_order_acquire);
+            if (c == 0)
+                return;
+        }
+        else if (c == 2)
+            break; // Others are already sleeping, get in line
+    }
+
+    // Mark the mutex contended before sleeping. If the exchange returns 0 we got the lock, but as we don't know if
+    // anyone else is waiting it stays marked contended and our unlock will issue a wake
+    if (c != 2)
+        c = xt_atomic_exchange_explicit_u32(mutex, 2, xt_memory_order_acquire);
+    while (c != 0)
+    {
+        xt_atomic_wait_u32(mutex, 2, XTHREAD_SIGNAL_WAIT_INFINITE);
+        c = xt_atomic_exchange_explicit_u32(mutex, 2, xt_memory_order_acquire);
+    }
+}
+
+void xt_fastmutex_unlock(xt_fastmutex_t* mutex)
+{
+    if (xt_atomic_exchange_explicit_u32(mutex, 0, xt_memory_order_release) == 2)
+        xt_atomic_notify(mutex, false);
+}
+
+uint32_t xt_seqlock_read_begin(xt_seqlock_t* lock)
+{
+    uint32_t seq;
+    while ((seq = xt_atomic_load_explicit_u32(lock, xt_memory_order_acquire)) & 1)
+        xthread_cpu_relax();
+    return seq;
+}
+
+bool xt_seqlock_read_retry(xt_seqlock_t* lock, uint32_t seq)
+{
+    // Keeps the data reads above from moving below the sequence load
+    xt_atomic_thread_fence(xt_memory_order_acquire);
+    return xt_atomic_load_explicit_u32(lock, xt_memory_order_relaxed) != seq;
+}
+
+void xt_seqlock_write_begin(xt_seqlock_t* lock)
+{
+    for (int i = 0;; i++)
+    {
+        uint32_t seq = xt_atomic_load_explicit_u32(lock, xt_memory_order_relaxed);
+        if ((seq & 1) == 0 && xt_atomic_compare_exchange_explicit_u32(lock, seq, seq + 1, xt_memory_order_acquire) == seq)
+            break;
+        if (! xthread_spin_backoff(i))
+            xthread_yield();
+    }
+    // Keeps the data writes below from moving above the sequence becoming odd
+    xt_atomic_thread_fence(xt_memory_order_release);
+}
+
+void xt_seqlock_write_end(xt_seqlock_t* lock) { xt_atomic_fetch_add_explicit_u32(lock, 1, xt_memory_order_release); }
+
+void xt_seqlock_read(xt_seqlock_t* lock, void* dst, const void* src, size_t size)
+{
+    uint32_t seq;
+    do
+    {
+        seq = xt_seqlock_read_begin(lock);
+        memcpy(dst, src, size);
+    }
+    while (xt_seqlock_read_retry(lock, seq));
+}
+
+void xt_seqlock_write(xt_seqlock_t* lock, void* dst, const void* src, size_t size)
+{
+    xt_seqlock_write_begin(lock);
+    memcpy(dst, src, size);
+    xt_seqlock_write_end(lock);
+}
+
+// All ops on the rwlock are seq_cst. Lockers read 'generation' before checking whether they are blocked, then bump
+// num_sleeping and sleep only if 'generation' is unchanged. Unlocks that can unblock someone bump 'generation' after
+// changing 'state' and check num_sleeping after that, so either the sleeper sees the new state, sees a new
+// generation and doesn't sleep, or the unlocker sees the sleeper. Waiting on 'state' itself could miss a writer that
+// locked and unlocked in between, and nothing changes 'state' when a reader is only held back by writers_waiting
+#define XTHREAD_RWLOCK_WRITER 0x80000000u
+
+static void xthread_rwlock_sleep(xt_rwlock_t* lock, uint32_t generation)
+{
+    xt_atomic_fetch_add_u32(&lock->num_sleeping, 1);
+    xt_atomic_wait_u32(&lock->generation, generation, XTHREAD_SIGNAL_WAIT_INFINITE);
+    xt_atomic_fetch_sub_u32(&lock->num_sleeping, 1);
+}
+
+static void xthread_rwlock_wake(xt_rwlock_t* lock)
+{
+    xt_atomic_fetch_add_u32(&lock->generation, 1);
+    if (xt_atomic_load_u32(&lock->num_sleeping) > 0)
+        xt_atomic_notify(&lock->generation, true);
+}
+
+void xt_rwlock_read_lock(xt_rwlock_t* lock)
+{
+    for (int i = 0;; i++)
+    {
+        uint32_t generation = xt_atomic_load_u32(&lock->generation);
+        uint32_t state      = xt_atomic_load_u32(&lock->state);
+        if ((state & XTHREAD_RWLOCK_WRITER) == 0 && xt_atomic_load_u32(&lock->writers_waiting) == 0)
+        {
+            if (xt_atomic_compare_exchange_u32(&lock->state, state, state + 1) == state)
+                return;
+        }
+        else if (i < XTHREAD_FASTMUTEX_SPIN_COUNT)
+            xthread_spin_backoff(i);
+        else
+            xthread_rwlock_sleep(lock, generation);
+    }
+}
+
+void xt_rwlock_read_unlock(xt_rwlock_t* lock)
+{
+    // Only a writer can be waiting for the readers to drain
+    if (xt_atomic_fetch_sub_u32(&lock->state, 1) == 1)
+        xthread_rwlock_wake(lock);
+}
+
+void xt_rwlock_write_lock(xt_rwlock_t* lock)
+{
+    xt_atomic_fetch_add_u32(&lock->writers_waiting, 1);
+    for (int i = 0;; i++)
+    {
+        uint32_t generation = xt_atomic_load_u32(&lock->generation);
+        uint32_t state      = xt_atomic_load_u32(&lock->state);
+        if (state == 0)
+        {
+            if (xt_atomic_compare_exchange_u32(&lock->state, 0, XTHREAD_RWLOCK_WRITER) == 0)
+                break;
+        }
+        else if (i < XTHREAD_FASTMUTEX_SPIN_COUNT)
+            xthread_spin_backoff(i);
+        else
+            xthread_rwlock_sleep(lock, generation);
+    }
+    xt_atomic_fetch_sub_u32(&lock->writers_waiting, 1);
+}
+
+void xt_rwlock_write_unlock(xt_rwlock_t* lock)
+{
+    xt_atomic_store_u32(&lock->state, 0);
+    xthread_rwlock_wake(lock);
+}
+
+static uint64_t xthread_monotonic_ms(void)
+{
+#if defined(_WIN32)
+    return GetTickCount64();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+#endif
+}
+
+static uint64_t xthread_monotonic_ns(void)
+{
+#if defined(_WIN32)
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER        now;
+    if (freq.QuadPart == 0)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (uint64_t)((double)now.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+void xthread_semaphore_init(xt_semaphore_t* sem, uint32_t initial_count)
+{
+    xt_atomic_store_u32(&sem->count, initial_count);
+    xt_atomic_store_u32(&sem->num_waiters, 0);
+}
+
+void xthread_semaphore_term(xt_semaphore_t* sem) { XTHREAD_ASSERT(sem->num_waiters == 0, "Semaphore still in use"); }
+
+void xthread_semaphore_post(xt_semaphore_t* sem, uint32_t count)
+{
+    // Both sides are seq_cst. Either the waiter sees the new count, or we see its num_waiters increment
+    xt_atomic_fetch_add_u32(&sem->count, count);
+    if (xt_atomic_load_u32(&sem->num_waiters) > 0)
+        xt_atomic_notify(&sem->count, count > 1);
+}
+
+bool xthread_semaphore_try_wait(xt_semaphore_t* sem)
+{
+    uint32_t c = xt_atomic_load_explicit_u32(&sem->count, xt_memory_order_relaxed);
+    while (c > 0)
+    {
+        uint32_t prev = xt_atomic_compare_exchange_explicit_u32(&sem->count, c, c - 1, xt_memory_order_acquire);
+        if (prev == c)
+            return true;
+        c = prev;
+    }
+    return false;
+}
+
+bool xthread_semaphore_wait(xt_semaphore_t* sem, int timeout_ms)
+{
+    for (int i = 0; i < XTHREAD_FASTMUTEX_SPIN_COUNT; i++)
+    {
+        if (xthread_semaphore_try_wait(sem))
+            return true;
+        xthread_spin_backoff(i);
+    }
+    if (timeout_ms == 0)
+        return xthread_semaphore_try_wait(sem);
+
+    uint64_t deadline = timeout_ms == XTHREAD_SIGNAL_WAIT_INFINITE ? 0 : xthread_monotonic_ms() + (uint64_t)timeout_ms;
+    bool     acquired = false;
+
+    xt_atomic_fetch_add_u32(&sem->num_waiters, 1);
+    while (! (acquired = xthread_semaphore_try_wait(sem)))
+    {
+        int remaining = XTHREAD_SIGNAL_WAIT_INFINITE;
+        if (deadline)
+        {
+            uint64_t now = xthread_monotonic_ms();
+            if (now >= deadline)
+                break;
+            remaining = (int)(deadline - now);
+        }
+        xt_atomic_wait_u32(&sem->count, 0, remaining);
+    }
+    xt_atomic_fetch_sub_u32(&sem->num_waiters, 1);
+    return acquired;
+}
+
+void xthread_barrier_init(xt_barrier_t* barrier, uint32_t count)
+{
+    XTHREAD_ASSERT(count > 0, "Barrier needs at least one thread");
+    memset(barrier, 0, sizeof(*barrier));
+    barrier->count = count;
+    xt_atomic_thread_fence(xt_memory_order_seq_cst);
+}
+
+bool xthread_barrier_wait(xt_barrier_t* barrier)
+{
+    // Read the generation before arriving. It can't change until we've arrived
+    uint32_t gen = xt_atomic_load_explicit_u32(&barrier->generation, xt_memory_order_acquire);
+    if (xt_atomic_fetch_add_explicit_u32(&barrier->arrived, 1, xt_memory_order_acq_rel) + 1 == barrier->count)
+    {
+        // Reset before releasing, so threads released into the next phase arrive at 0
+        xt_atomic_store_explicit_u32(&barrier->arrived, 0, xt_memory_order_relaxed);
+        // Both sides are seq_cst. Either sleepers see the new generation, or we see them
+        xt_atomic_store_u32(&barrier->generation, gen + 1);
+        if (xt_atomic_load_u32(&barrier->num_sleeping) > 0)
+            xt_atomic_notify(&barrier->generation, true);
+        return true;
+    }
+
+    for (int i = 0; i < XTHREAD_BARRIER_SPIN_COUNT; i++)
+    {
+        if (xt_atomic_load_explicit_u32(&barrier->generation, xt_memory_order_acquire) != gen)
+            return false;
+        if (! xthread_spin_backoff(i))
+            break;
+    }
+
+    xt_atomic_fetch_add_u32(&barrier->num_sleeping, 1);
+    while (xt_atomic_load_u32(&barrier->generation) == gen)
+        xt_atomic_wait_u32(&barrier->generation, gen, XTHREAD_SIGNAL_WAIT_INFINITE);
+    xt_atomic_fetch_sub_u32(&barrier->num_sleeping, 1);
+    return false;
+}
+
+void xthread_latch_init(xt_latch_t* latch, uint32_t count)
+{
+    xt_atomic_store_u32(&latch->count, count);
+    xt_atomic_store_u32(&latch->num_sleeping, 0);
+}
+
+void xthread_latch_count_down(xt_latch_t* latch, uint32_t n)
+{
+    uint32_t prev = xt_atomic_fetch_sub_u32(&latch->count, n);
+    XTHREAD_ASSERT(prev >= n, "Latch counted down too many times");
+    if (prev == n && xt_atomic_load_u32(&latch->num_sleeping) > 0)
+        xt_atomic_notify(&latch->count, true);
+}
+
+bool xthread_latch_try_wait(xt_latch_t* latch)
+{
+    return xt_atomic_load_explicit_u32(&latch->count, xt_memory_order_acquire) == 0;
+}
+
+void xthread_latch_wait(xt_latch_t* latch)
+{
+    for (int i = 0; i < XTHREAD_BARRIER_SPIN_COUNT; i++)
+    {
+        if (xthread_latch_try_wait(latch))
+            return;
+        if (! xthread_spin_backoff(i))
+            break;
+    }
+
+    xt_atomic_fetch_add_u32(&latch->num_sleeping, 1);
+    uint32_t c;
+    while ((c = xt_atomic_load_u32(&latch->count)) != 0)
+        xt_atomic_wait_u32(&latch->count, c, XTHREAD_SIGNAL_WAIT_INFINITE);
+    xt_atomic_fetch_sub_u32(&latch->num_sleeping, 1);
+}
+
+// Called by the new lock holder, so plain load + store is enough
+static void xthread_lock_stats_add(xt_lock_stats_t* stats, bool contended, uint64_t wait_start)
+{
+    xt_atomic_store_explicit_u64(
+        &stats->acquisitions,
+        xt_atomic_load_explicit_u64(&stats->acquisitions, xt_memory_order_relaxed) + 1,
+        xt_memory_order_relaxed);
+    if (contended)
+    {
+        xt_atomic_store_explicit_u64(
+            &stats->contended,
+            xt_atomic_load_explicit_u64(&stats->contended, xt_memory_order_relaxed) + 1,
+            xt_memory_order_relaxed);
+        xt_atomic_store_explicit_u64(
+            &stats->wait_ns,
+            xt_atomic_load_explicit_u64(&stats->wait_ns, xt_memory_order_relaxed) + xthread_monotonic_ns() - wait_start,
+            xt_memory_order_relaxed);
+    }
+}
+
+// Spinning threads yield now and then, in case the thread they wait on isn't running
+#define XTHREAD_FAIR_LOCK_YIELD_SPINS 4096
+
+void xt_ticketlock_init(xt_ticketlock_t* lock, xt_lock_stats_t* stats)
+{
+    xt_atomic_store_u32(&lock->next, 0);
+    xt_atomic_store_u32(&lock->serving, 0);
+    lock->stats = stats;
+}
+
+void xt_ticketlock_lock(xt_ticketlock_t* lock)
+{
+    uint32_t ticket  = xt_atomic_fetch_add_explicit_u32(&lock->next, 1, xt_memory_order_relaxed);
+    uint32_t serving = xt_atomic_load_explicit_u32(&lock->serving, xt_memory_order_acquire);
+    if (serving == ticket)
+    {
+        if (lock->stats)
+            xthread_lock_stats_add(lock->stats, false, 0);
+        return;
+    }
+
+    uint64_t start = lock->stats ? xthread_monotonic_ns() : 0;
+    int      spins = 0;
+    while (serving != ticket)
+    {
+        // The further back in line, the longer until our turn
+        for (uint32_t i = ticket - serving; i > 0; i--)
+            xthread_cpu_relax();
+        if ((spins += ticket - serving) >= XTHREAD_FAIR_LOCK_YIELD_SPINS)
+        {
+            spins = 0;
+            xthread_yield();
+        }
+        serving = xt_atomic_load_explicit_u32(&lock->serving, xt_memory_order_acquire);
+    }
+    if (lock->stats)
+        xthread_lock_stats_add(lock->stats, true, start);
+}
+
+bool xt_ticketlock_trylock(xt_ticketlock_t* lock)
+{
+    uint32_t serving = xt_atomic_load_explicit_u32(&lock->serving, xt_memory_order_relaxed);
+    if (xt_atomic_compare_exchange_explicit_u32(&lock->next, serving, serving + 1, xt_memory_order_acquire) != serving)
+        return false;
+    if (lock->stats)
+        xthread_lock_stats_add(lock->stats, false, 0);
+    return true;
+}
+
+void xt_ticketlock_unlock(xt_ticketlock_t* lock)
+{
+    // Only the holder writes 'serving'
+    uint32_t serving = xt_atomic_load_explicit_u32(&lock->serving, xt_memory_order_relaxed);
+    xt_atomic_store_explicit_u32(&lock->serving, serving + 1, xt_memory_order_release);
+}
+
+void xt_mcslock_init(xt_mcslock_t* lock, xt_lock_stats_t* stats)
+{
+    xt_atomic_store_ptr(&lock->tail, NULL);
+    lock->stats = stats;
+}
+
+void xt_mcslock_lock(xt_mcslock_t* lock, xt_mcs_node_t* node)
+{
+    xt_atomic_store_explicit_ptr(&node->next, NULL, xt_memory_order_relaxed);
+    xt_atomic_store_explicit_u32(&node->locked, 1, xt_memory_order_relaxed);
+
+    xt_mcs_node_t* prev = (xt_mcs_node_t*)xt_atomic_exchange_explicit_ptr(&lock->tail, node, xt_memory_order_acq_rel);
+    if (prev == NULL)
+    {
+        if (lock->stats)
+            xthread_lock_stats_add(lock->stats, false, 0);
+        return;
+    }
+
+    uint64_t start = lock->stats ? xthread_monotonic_ns() : 0;
+    xt_atomic_store_explicit_ptr(&prev->next, node, xt_memory_order_release);
+    for (int spins = 0; xt_atomic_load_explicit_u32(&node->locked, xt_memory_order_acquire); spins++)
+    {
+        xthread_cpu_relax();
+        if (spins >= XTHREAD_FAIR_LOCK_YIELD_SPINS)
+        {
+            spins = 0;
+            xthread_yield();
+        }
+    }
+    if (lock->stats)
+        xthread_lock_stats_add(lock->stats, true, start);
+}
+
+void xt_mcslock_unlock(xt_mcslock_t* lock, xt_mcs_node_t* node)
+{
+    xt_mcs_node_t* next = (xt_mcs_node_t*)xt_atomic_load_explicit_ptr(&node->next, xt_memory_order_acquire);
+    if (next == NULL)
+    {
+        // Nobody queued behind us
+        if (xt_atomic_compare_exchange_strong_explicit_ptr(&lock->tail, node, NULL, xt_memory_order_acq_rel))
+            return;
+        // Someone swapped themselves in as the tail, but hasn't linked to us yet
+        while ((next = (xt_mcs_node_t*)xt_atomic_load_explicit_ptr(&node->next, xt_memory_order_acquire)) == NULL)
+            xthread_cpu_relax();
+    }
+    xt_atomic_store_explicit_u32(&next->locked, 0, xt_memory_order_release);
+}
+
+#if defined(_WIN32)
+#define XTHREAD_FIBER_WIN32
+#elif ! defined(XTHREAD_FIBER_UCONTEXT) && (defined(__x86_64__) || defined(__aarch64__) || defined(__arm64__))
+#define XTHREAD_FIBER_ASM
+#else
+#ifndef XTHREAD_FIBER_UCONTEXT
+#define XTHREAD_FIBER_UCONTEXT
+#endif
+#include <ucontext.h>
+#endif
+
+#if defined(_MSC_VER) && !(__clang__)
+#define XTHREAD_NOINLINE __declspec(noinline)
+#else
+#define XTHREAD_NOINLINE __attribute__((noinline))
+#endif
+
+struct xt_fiber_t
+{
+#if defined(XTHREAD_FIBER_WIN32)
+    void* handle;
+#elif defined(XTHREAD_FIBER_ASM)
+    void* sp; // Registers are saved on the fibers own stack
+#else
+    ucontext_t context;
+#endif
+    xt_fiber_t* caller;
+    xt_fiber_fn fn;
+    void*       user_data;
+    void*       stack;      // POSIX, including the guard page
+    size_t      stack_size;
+    bool        done;
+    bool        is_thread; // Converted from a thread, runs on the threads stack
+    bool        converted; // Windows: ConvertThreadToFiber needs undoing
+};
+
+static XTHREAD_LOCAL xt_fiber_t* g_xthread_fiber = NULL;
+
+// A fiber that switches out on one thread can be switched back in on another. Going through functions that aren't
+// inlined stops the compiler reusing the address of the thread local it worked out before the switch
+static XTHREAD_NOINLINE xt_fiber_t* xthread_fiber_get_current(void) { return g_xthread_fiber; }
+static XTHREAD_NOINLINE void        xthread_fiber_set_current(xt_fiber_t* fiber) { g_xthread_fiber = fiber; }
+
+static void xthread_fiber_entry(xt_fiber_t* fiber);
+
+#if defined(XTHREAD_FIBER_WIN32)
+
+static VOID WINAPI xthread_fiber_win32_proc(LPVOID arg) { xthread_fiber_entry((xt_fiber_t*)arg); }
+
+static bool xthread_fiber_init_context(xt_fiber_t* fiber, size_t stack_size)
+{
+    // Reserve stack_size, commit the default
+    fiber->handle = CreateFiberEx(0, stack_size, 0, xthread_fiber_win32_proc, fiber);
+    return fiber->handle != NULL;
+}
+
+static void xthread_fiber_init_thread(xt_fiber_t* fiber)
+{
+    fiber->handle    = ConvertThreadToFiber(NULL);
+    fiber->converted = fiber->handle != NULL;
+    if (fiber->handle == NULL)
+    {
+        XTHREAD_ASSERT(GetLastError() == ERROR_ALREADY_FIBER, "Failed converting thread to fiber");
+        fiber->handle = GetCurrentFiber();
+    }
+}
+
+static void xthread_fiber_switch_context(xt_fiber_t* from, xt_fiber_t* to)
+{
+    (void)from;
+    SwitchToFiber(to->handle);
+}
+
+#else // POSIX
+
+#if defined(XTHREAD_FIBER_ASM)
+#if defined(__APPLE__)
+#define XTHREAD_ASM_TEXT "__TEXT,__text,regular,pure_instructions"
+#define XTHREAD_ASM_FUNCTION(name) ".private_extern _" #name "\n.globl _" #name "\n.p2align 4\n_" #name ":\n"
+#else
+#define XTHREAD_ASM_TEXT ".text"
+#define XTHREAD_ASM_FUNCTION(name) ".hidden " #name "\n.globl " #name "\n.type " #name ", %function\n.p2align 4\n" #name ":\n"
+#endif
+
+// Saves the callee saved registers on the current stack, stores the stack pointer in *from_sp, then restores the
+// registers saved on to_sp and returns to wherever that fiber switched out from.
+// New fibers get a stack laid out as if they had switched out, returning into xthread_fiber_asm_start with the fiber
+// and entry function in callee saved registers
+#ifdef __cplusplus
+extern "C" {
+#endif
+void xthread_fiber_asm_switch(void** from_sp, void* to_sp);
+void xthread_fiber_asm_start(void);
+#ifdef __cplusplus
+}
+#endif
+
+#if defined(__x86_64__)
+// System V: rbx, rbp, r12-r15, plus the MXCSR and x87 control words. 64 byte frame
+__asm__(
+    ".pushsection " XTHREAD_ASM_TEXT "\n"
+    XTHREAD_ASM_FUNCTION(xthread_fiber_asm_switch)
+    "    pushq  %rbp\n"
+    "    pushq  %rbx\n"
+    "    pushq  %r12\n"
+    "    pushq  %r13\n"
+    "    pushq  %r14\n"
+    "    pushq  %r15\n"
+    "    subq   $8, %rsp\n"
+    "    stmxcsr (%rsp)\n"
+    "    fnstcw 4(%rsp)\n"
+    "    movq   %rsp, (%rdi)\n"
+    "    movq   %rsi, %rsp\n"
+    "    ldmxcsr (%rsp)\n"
+    "    fldcw  4(%rsp)\n"
+    "    addq   $8, %rsp\n"
+    "    popq   %r15\n"
+    "    popq   %r14\n"
+    "    popq   %r13\n"
+    "    popq   %r12\n"
+    "    popq   %rbx\n"
+    "    popq   %rbp\n"
+    "    ret\n"
+    XTHREAD_ASM_FUNCTION(xthread_fiber_asm_start)
+    "    movq   %r12, %rdi\n"
+    "    callq  *%rbx\n"
+    "    ud2\n"
+    ".popsection\n");
+
+#define XTHREAD_FIBER_FRAME_SIZE 64
+
+static void xthread_fiber_init_frame(void** frame, xt_fiber_t* fiber)
+{
+    // Inherit the creating threads rounding & denormal modes
+    __asm__ volatile("stmxcsr %0" : "=m"(*(uint32_t*)frame));
+    __asm__ volatile("fnstcw %0" : "=m"(*((uint16_t*)frame + 2)));
+    frame[4] = fiber;                          // r12
+    frame[5] = (void*)xthread_fiber_entry;     // rbx
+    frame[6] = NULL;                           // rbp
+    frame[7] = (void*)xthread_fiber_asm_start; // Return address
+}
+
+#else
+// AAPCS64: x19-x28, fp, lr and the low halves of v8-v15. 160 byte frame
+__asm__(
+    ".pushsection " XTHREAD_ASM_TEXT "\n"
+    XTHREAD_ASM_FUNCTION(xthread_fiber_asm_switch)
+    "    sub  sp, sp, #160\n"
+    "    stp  x19, x20, [sp, #0]\n"
+    "    stp  x21, x22, [sp, #16]\n"
+    "    stp  x23, x24, [sp, #32]\n"
+    "    stp  x25, x26, [sp, #48]\n"
+    "    stp  x27, x28, [sp, #64]\n"
+    "    stp  x29, x30, [sp, #80]\n"
+    "    stp  d8, d9, [sp, #96]\n"
+    "    stp  d10, d11, [sp, #112]\n"
+    "    stp  d12, d13, [sp, #128]\n"
+    "    stp  d14, d15, [sp, #144]\n"
+    "    mov  x2, sp\n"
+    "    str  x2, [x0]\n"
+    "    mov  sp, x1\n"
+    "    ldp  x19, x20, [sp, #0]\n"
+    "    ldp  x21, x22, [sp, #16]\n"
+    "    ldp  x23, x24, [sp, #32]\n"
+    "    ldp  x25, x26, [sp, #48]\n"
+    "    ldp  x27, x28, [sp, #64]\n"
+    "    ldp  x29, x30, [sp, #80]\n"
+    "    ldp  d8, d9, [sp, #96]\n"
+    "    ldp  d10, d11, [sp, #112]\n"
+    "    ldp  d12, d13, [sp, #128]\n"
+    "    ldp  d14, d15, [sp, #144]\n"
+    "    add  sp, sp, #160\n"
+    "    ret\n"
+    XTHREAD_ASM_FUNCTION(xthread_fiber_asm_start)
+    "    mov  x0, x20\n"
+    "    blr  x19\n"
+    "    brk  #0\n"
+    ".popsection\n");
+
+#define XTHREAD_FIBER_FRAME_SIZE 160
+
+static void xthread_fiber_init_frame(void** frame, xt_fiber_t* fiber)
+{
+    frame[0]  = (void*)xthread_fiber_entry;     // x19
+    frame[1]  = fiber;                          // x20
+    frame[10] = NULL;                           // x29
+    frame[11] = (void*)xthread_fiber_asm_start; // x30
+}
+#endif
+
+static void xthread_fiber_init_stack(xt_fiber_t* fiber, char* stack_top)
+{
+    // Stack tops are page aligned, so both frames leave sp 16 byte aligned where the ABIs want it
+    void** frame = (void**)(stack_top - XTHREAD_FIBER_FRAME_SIZE);
+    memset(frame, 0, XTHREAD_FIBER_FRAME_SIZE);
+    xthread_fiber_init_frame(frame, fiber);
+    fiber->sp = frame;
+}
+
+static void xthread_fiber_switch_context(xt_fiber_t* from, xt_fiber_t* to)
+{
+    xthread_fiber_asm_switch(&from->sp, to->sp);
+}
+
+#else // XTHREAD_FIBER_UCONTEXT
+
+// makecontext only passes ints, so the fiber is read back from the thread local set by the switch
+static void xthread_fiber_ucontext_proc(void) { xthread_fiber_entry(xthread_fiber_get_current()); }
+
+static void xthread_fiber_init_stack(xt_fiber_t* fiber, char* stack_top)
+{
+    size_t size = stack_top - (char*)fiber->stack;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    getcontext(&fiber->context);
+    fiber->context.uc_stack.ss_sp   = (char*)fiber->stack + page;
+    fiber->context.uc_stack.ss_size = size - page;
+    fiber->context.uc_link          = NULL;
+    makecontext(&fiber->context, xthread_fiber_ucontext_proc, 0);
+}
+
+static void xthread_fiber_switch_context(xt_fiber_t* from, xt_fiber_t* to)
+{
+    swapcontext(&from->context, &to->context);
+}
+#endif
+
+static bool xthread_fiber_init_context(xt_fiber_t* fiber, size_t stack_size)
+{
+    // Stacks grow down, so the guard page goes at the bottom
+    size_t page       = (size_t)sysconf(_SC_PAGESIZE);
+    stack_size        = (stack_size + page - 1) & ~(page - 1);
+    fiber->stack_size = stack_size + page;
+    fiber->stack      = mmap(NULL, fiber->stack_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (fiber->stack == MAP_FAILED)
+    {
+        fiber->stack = NULL;
+        return false;
+    }
+    mprotect(fiber->stack, page, PROT_NONE);
+    xthread_fiber_init_stack(fiber, (char*)fiber->stack + fiber->stack_size);
+    return true;
+}
+
+static void xthread_fiber_init_thread(xt_fiber_t* fiber) { (void)fiber; } // Filled in when it first switches out
+#endif // POSIX
+
+static void xthread_fiber_entry(xt_fiber_t* fiber)
+{
+    fiber->fn(fiber->user_data);
+    fiber->done = true;
+
+    xt_fiber_t* caller = fiber->caller;
+    xthread_fiber_set_current(caller);
+    xthread_fiber_switch_context(fiber, caller);
+    XTHREAD_ASSERT(false, "Switched to a fiber that is done");
+}
+
+xt_fiber_t* xthread_fiber_create(size_t stack_size, xt_fiber_fn fn, void* user_data)
+{
+    if (stack_size == 0)
+        stack_size = XTHREAD_FIBER_STACK_SIZE_DEFAULT;
+
+    xt_fiber_t* fiber = (xt_fiber_t*)XTHREAD_MALLOC(sizeof(*fiber));
+    memset(fiber, 0, sizeof(*fiber));
+    fiber->fn        = fn;
+    fiber->user_data = user_data;
+    if (! xthread_fiber_init_context(fiber, stack_size))
+    {
+        XTHREAD_FREE(fiber);
+        return NULL;
+    }
+    return fiber;
+}
+
+void xthread_fiber_destroy(xt_fiber_t* fiber)
+{
+    XTHREAD_ASSERT(fiber != xthread_fiber_get_current(), "Can't destroy the running fiber");
+    XTHREAD_ASSERT(! fiber->is_thread, "Use xthread_fiber_release_thread");
+#if defined(XTHREAD_FIBER_WIN32)
+    DeleteFiber(fiber->handle);
+#else
+    munmap(fiber->stack, fiber->stack_size);
+#endif
+    XTHREAD_FREE(fiber);
+}
+
+xt_fiber_t* xthread_fiber_current(void)
+{
+    xt_fiber_t* fiber = xthread_fiber_get_current();
+    if (fiber == NULL)
+    {
+        fiber = (xt_fiber_t*)XTHREAD_MALLOC(sizeof(*fiber));
+        memset(fiber, 0, sizeof(*fiber));
+        fiber->is_thread = true;
+        xthread_fiber_init_thread(fiber);
+        xthread_fiber_set_current(fiber);
+    }
+    return fiber;
+}
+
+void xthread_fiber_switch(xt_fiber_t* to)
+{
+    xt_fiber_t* from = xthread_fiber_current();
+    XTHREAD_ASSERT(! to->done, "Fiber is done");
+    if (from == to)
+        return;
+    to->caller = from;
+    xthread_fiber_set_current(to);
+    xthread_fiber_switch_context(from, to);
+}
+
+bool xthread_fiber_done(xt_fiber_t* fiber) { return fiber->done; }
+
+void xthread_fiber_release_thread(void)
+{
+    xt_fiber_t* fiber = xthread_fiber_get_current();
+    if (fiber == NULL)
+        return;
+    XTHREAD_ASSERT(fiber->is_thread, "Must be called from the threads original fiber");
+#if defined(XTHREAD_FIBER_WIN32)
+    if (fiber->converted)
+        ConvertFiberToThread();
+#endif
+    XTHREAD_FREE(fiber);
+    xthread_fiber_set_current(NULL);
+}
+
+#ifndef XTHREAD_POOL_DEQUE_SIZE
+#define XTHREAD_POOL_DEQUE_SIZE 1024
+#endif
+#ifndef XTHREAD_POOL_QUEUE_SIZE
+#define XTHREAD_POOL_QUEUE_SIZE 1024
+#endif
+#define XTHREAD_JOB_FIBER 1u
+XTHREAD_STATIC_ASSERT((XTHREAD_POOL_DEQUE_SIZE & (XTHREAD_POOL_DEQUE_SIZE - 1)) == 0, "Must be a power of 2");
+
+// Chase-Lev deque, using the memory orders from 'Correct and Efficient Work-Stealing for Weak Memory Models' by Lê et al.
+// https://fzn.fr/readings/ppopp13.pdf
+// Fixed size. When full, jobs overflow into the pools injection queue
+struct xthread_pool_deque
+{
+    xt_atomic_int64_t top;
+    char              pad0[XTHREAD_CACHE_LINE_SIZE - sizeof(int64_t)];
+    xt_atomic_int64_t bottom;
+    char              pad1[XTHREAD_CACHE_LINE_SIZE - sizeof(int64_t)];
+    xt_atomic_ptr_t   jobs[XTHREAD_POOL_DEQUE_SIZE];
+};
+
+struct xthread_pool_worker
+{
+    struct xthread_pool_deque deque;
+
+    xt_pool_t*         pool;
+    xt_thread_ptr_t    thread;
+    xt_signal_t        wake;
+    xt_atomic_uint32_t sleeping;
+    uint32_t           rng;
+    int                index;
+};
+
+enum xthread_pool_fiber_state
+{
+    XTHREAD_POOL_FIBER_IDLE,
+    XTHREAD_POOL_FIBER_RUNNING,
+    XTHREAD_POOL_FIBER_PARKED,
+};
+
+struct xthread_pool_fiber
+{
+    xt_stack_node_t node; // Must be first
+    xt_fiber_t*     fiber;
+    xt_pool_t*      pool;
+    xt_job_t*       job;
+    xt_job_t*       wait_job;
+    int             state;
+
+    struct xthread_pool_fiber* next_parked;
+};
+
+struct xt_pool_t
+{
+    xt_mpmc_queue_t injection;
+    xt_mpmc_cell_t  cells[XTHREAD_POOL_QUEUE_SIZE];
+
+    // Fibers waiting on a job, oldest first, and idle fibers ready for the next fiber job
+    xt_fastmutex_t              parked_lock; // Guards 'parked' & 'parked_tail'
+    struct xthread_pool_fiber*  parked;
+    struct xthread_pool_fiber** parked_tail;
+    xt_stack_t                  idle_fibers;
+
+    xt_atomic_uint32_t stop;
+    xt_atomic_uint32_t num_sleeping;
+    xt_atomic_uint32_t num_parked;
+
+    int                         num_workers;
+    struct xthread_pool_worker* workers;
+};
+
+static XTHREAD_LOCAL struct xthread_pool_worker* g_xthread_pool_worker = NULL;
+
+// Fiber jobs can be resumed by another worker, see xthread_fiber_get_current
+static XTHREAD_NOINLINE struct xthread_pool_worker* xthread_pool_get_worker(void) { return g_xthread_pool_worker; }
+static XTHREAD_NOINLINE void xthread_pool_set_worker(struct xthread_pool_worker* worker)
+{
+    g_xthread_pool_worker = worker;
+}
+
+static bool xthread_pool_deque_push(struct xthread_pool_deque* dq, xt_job_t* job)
+{
+    int64_t b = xt_atomic_load_explicit_i64(&dq->bottom, xt_memory_order_relaxed);
+    int64_t t = xt_atomic_load_explicit_i64(&dq->top, xt_memory_order_acquire);
+    if (b - t >= XTHREAD_POOL_DEQUE_SIZE)
+        return false;
+    xt_atomic_store_explicit_ptr(&dq->jobs[b & (XTHREAD_POOL_DEQUE_SIZE - 1)], job, xt_memory_order_relaxed);
+    xt_atomic_store_explicit_i64(&dq->bottom, b + 1, xt_memory_order_release);
+    return true;
+}
+
+// Owner only
+static xt_job_t* xthread_pool_deque_take(struct xthread_pool_deque* dq)
+{
+    int64_t b = xt_atomic_load_explicit_i64(&dq->bottom, xt_memory_order_relaxed) - 1;
+    xt_atomic_store_explicit_i64(&dq->bottom, b, xt_memory_order_relaxed);
+    xt_atomic_thread_fence(xt_memory_order_seq_cst);
+    int64_t t = xt_atomic_load_explicit_i64(&dq->top, xt_memory_order_relaxed);
+
+    xt_job_t* job = NULL;
+    if (t <= b)
+    {
+        job = (xt_job_t*)xt_atomic_load_explicit_ptr(&dq->jobs[b & (XTHREAD_POOL_DEQUE_SIZE - 1)], xt_memory_order_relaxed);
+        if (t == b)
+        {
+            // Last job. Race against thieves
+            if (xt_atomic_compare_exchange_explicit_i64(&dq->top, t, t + 1, xt_memory_order_seq_cst) != t)
+                job = NULL;
+            xt_atomic_store_explicit_i64(&dq->bottom, b + 1, xt_memory_order_relaxed);
+        }
+    }
+    else
+    {
+        xt_atomic_store_explicit_i64(&dq->bottom, b + 1, xt_memory_order_relaxed);
+    }
+    return job;
+}
+
+// Any thread
+static xt_job_t* xthread_pool_deque_steal(struct xthread_pool_deque* dq)
+{
+    int64_t t = xt_atomic_load_explicit_i64(&dq->top, xt_memory_order_acquire);
+    xt_atomic_thread_fence(xt_memory_order_seq_cst);
+    int64_t b = xt_atomic_load_explicit_i64(&dq->bottom, xt_memory_order_acquire);
+
+    if (t < b)
+    {
+        xt_job_t* job = (xt_job_t*)xt_atomic_load_explicit_ptr(&dq->jobs[t & (XTHREAD_POOL_DEQUE_SIZE - 1)], xt_memory_order_relaxed);
+        if (xt_atomic_compare_exchange_explicit_i64(&dq->top, t, t + 1, xt_memory_order_seq_cst) == t)
+            return job;
+    }
+    return NULL;
+}
+
+static xt_job_t* xthread_pool_find_job(xt_pool_t* pool, struct xthread_pool_worker* self)
+{
+    xt_job_t* job = NULL;
+    if (self)
+    {
+        job = xthread_pool_deque_take(&self->deque);
+        if (job)
+            return job;
+    }
+
+    void* v = NULL;
+    if (xthread_mpmc_queue_try_pop(&pool->injection, &v))
+        return (xt_job_t*)v;
+
+    // Steal, starting from a random victim so thieves spread out
+    int start = 0;
+    if (self)
+    {
+        self->rng ^= self->rng << 13;
+        self->rng ^= self->rng >> 17;
+        self->rng ^= self->rng << 5;
+        start      = (int)(self->rng % (uint32_t)pool->num_workers);
+    }
+    for (int i = 0; i < pool->num_workers; i++)
+    {
+        struct xthread_pool_worker* victim = &pool->workers[(start + i) % pool->num_workers];
+        if (victim == self)
+            continue;
+        job = xthread_pool_deque_steal(&victim->deque);
+        if (job)
+            return job;
+    }
+    return NULL;
+}
+
+static void xthread_pool_wake_one(xt_pool_t* pool)
+{
+    // Pushes publish with a release store. Order them before the load, pairs with the fetch_add on num_sleeping
+    // a worker does before its last look at the queues
+    xt_atomic_thread_fence(xt_memory_order_seq_cst);
+    if (xt_atomic_load_explicit_u32(&pool->num_sleeping, xt_memory_order_relaxed) == 0)
+        return;
+    for (int i = 0; i < pool->num_workers; i++)
+    {
+        struct xthread_pool_worker* w = &pool->workers[i];
+        if (xt_atomic_compare_exchange_u32(&w->sleeping, 1, 0) == 1)
+        {
+            xt_atomic_fetch_sub_u32(&pool->num_sleeping, 1);
+            xthread_signal_raise(&w->wake);
+            return;
+        }
+    }
+}
+
+static void xthread_pool_finish_job(xt_pool_t* pool, xt_job_t* job)
+{
+    // The waiter may free the job as soon as 'unfinished' hits zero, so read everything we need first
+    xt_job_t* parent = job->parent;
+    if (xt_atomic_fetch_sub_explicit_i32(&job->unfinished, 1, xt_memory_order_acq_rel) != 1)
+        return;
+
+    // A parked fiber may be waiting on this job. Pairs with the sleeping workers last look at the parked fibers
+    xt_atomic_thread_fence(xt_memory_order_seq_cst);
+    if (xt_atomic_load_explicit_u32(&pool->num_parked, xt_memory_order_relaxed) != 0)
+        xthread_pool_wake_one(pool);
+    if (parent)
+        xthread_pool_finish_job(pool, parent);
+}
+
+static void xthread_pool_fiber_proc(void* arg)
+{
+    struct xthread_pool_fiber* pf = (struct xthread_pool_fiber*)arg;
+    for (;;)
+    {
+        xt_job_t* job = pf->job;
+        job->fn(job->user_data);
+        xthread_pool_finish_job(pf->pool, job);
+
+        pf->job   = NULL;
+        pf->state = XTHREAD_POOL_FIBER_IDLE;
+        xthread_fiber_switch(pf->fiber->caller);
+    }
+}
+
+// Runs the fiber until it finishes its job or parks itself in xthread_pool_wait
+static void xthread_pool_resume_fiber(xt_pool_t* pool, struct xthread_pool_fiber* pf)
+{
+    pf->state = XTHREAD_POOL_FIBER_RUNNING;
+    xthread_fiber_switch(pf->fiber);
+
+    if (pf->state == XTHREAD_POOL_FIBER_IDLE)
+    {
+        xthread_stack_push(&pool->idle_fibers, &pf->node);
+        return;
+    }
+    // Count it before it's visible, so the count is never lower than the number of parked fibers. Whoever checks for
+    // parked fibers after we check for sleepers will find it, otherwise we wake them
+    xt_atomic_fetch_add_u32(&pool->num_parked, 1);
+    pf->next_parked = NULL;
+    xt_fastmutex_lock(&pool->parked_lock);
+    *pool->parked_tail = pf;
+    pool->parked_tail  = &pf->next_parked;
+    xt_fastmutex_unlock(&pool->parked_lock);
+    xthread_pool_wake_one(pool);
+}
+
+// Returns a parked fiber whose job is done, or NULL
+static struct xthread_pool_fiber* xthread_pool_take_ready_fiber(xt_pool_t* pool)
+{
+    if (xt_atomic_load_u32(&pool->num_parked) == 0)
+        return NULL;
+
+    struct xthread_pool_fiber* pf = NULL;
+    xt_fastmutex_lock(&pool->parked_lock);
+    for (struct xthread_pool_fiber** link = &pool->parked; *link != NULL; link = &(*link)->next_parked)
+    {
+        if (xthread_job_done((*link)->wait_job))
+        {
+            pf    = *link;
+            *link = pf->next_parked;
+            if (pool->parked_tail == &pf->next_parked)
+                pool->parked_tail = link;
+            break;
+        }
+    }
+    xt_fastmutex_unlock(&pool->parked_lock);
+
+    if (pf != NULL)
+    {
+        xt_atomic_fetch_sub_u32(&pool->num_parked, 1);
+        pf->wait_job = NULL;
+    }
+    return pf;
+}
+
+static void xthread_pool_run_job(xt_pool_t* pool, xt_job_t* job)
+{
+    if ((job->flags & XTHREAD_JOB_FIBER) == 0)
+    {
+        job->fn(job->user_data);
+        xthread_pool_finish_job(pool, job);
+        return;
+    }
+
+    struct xthread_pool_fiber* pf = (struct xthread_pool_fiber*)xthread_stack_pop(&pool->idle_fibers);
+    if (pf == NULL)
+    {
+        pf = (struct xthread_pool_fiber*)XTHREAD_MALLOC(sizeof(*pf));
+        memset(pf, 0, sizeof(*pf));
+        pf->pool  = pool;
+        pf->fiber = xthread_fiber_create(XTHREAD_FIBER_STACK_SIZE_DEFAULT, xthread_pool_fiber_proc, pf);
+        XTHREAD_ASSERT(pf->fiber != NULL, "Failed creating fiber");
+    }
+    pf->job = job;
+    xthread_pool_resume_fiber(pool, pf);
+}
+
+static int xthread_pool_worker_proc(void* arg)
+{
+    struct xthread_pool_worker* self = (struct xthread_pool_worker*)arg;
+    xt_pool_t*                  pool = self->pool;
+    xthread_pool_set_worker(self);
+
+    int spins = 0;
+    while (! xt_atomic_load_explicit_u32(&pool->stop, xt_memory_order_acquire))
+    {
+        // Finish what was started before starting anything new
+        struct xthread_pool_fiber* pf = xthread_pool_take_ready_fiber(pool);
+        if (pf)
+        {
+            xthread_pool_resume_fiber(pool, pf);
+            spins = 0;
+            continue;
+        }
+        xt_job_t* job = xthread_pool_find_job(pool, self);
+        if (job)
+        {
+            xthread_pool_run_job(pool, job);
+            spins = 0;
+            continue;
+        }
+        if (++spins < 64)
+        {
+            xthread_cpu_relax();
+            continue;
+        }
+        spins = 0;
+
+        // Announce we're going to sleep, then look for work once more. Submitters push their job before checking
+        // 'num_sleeping', so either we see their job here or they see us and raise our signal. The same goes for
+        // parked fibers and the jobs they wait on
+        xt_atomic_store_u32(&self->sleeping, 1);
+        xt_atomic_fetch_add_u32(&pool->num_sleeping, 1);
+        job = xthread_pool_find_job(pool, self);
+        if (job == NULL)
+            pf = xthread_pool_take_ready_fiber(pool);
+        if (job == NULL && pf == NULL && ! xt_atomic_load_u32(&pool->stop))
+            xthread_signal_wait(&self->wake, XTHREAD_SIGNAL_WAIT_INFINITE);
+
+        // If nobody woke us we must take ourselves off the sleeping list
+        if (xt_atomic_compare_exchange_u32(&self->sleeping, 1, 0) == 1)
+            xt_atomic_fetch_sub_u32(&pool->num_sleeping, 1);
+        if (job)
+            xthread_pool_run_job(pool, job);
+        if (pf)
+            xthread_pool_resume_fiber(pool, pf);
+    }
+    xthread_pool_set_worker(NULL);
+    xthread_fiber_release_thread();
+    return 0;
+}
+
+xt_pool_t* xthread_pool_create(int num_threads)
+{
+    if (num_threads <= 0)
+        num_threads = xthread_num_cores();
+
+    xt_pool_t* pool = (xt_pool_t*)XTHREAD_MALLOC(sizeof(*pool));
+    memset((void*)pool, 0, sizeof(*pool));
+    xthread_mpmc_queue_init(&pool->injection, pool->cells, XTHREAD_POOL_QUEUE_SIZE);
+    pool->parked_tail = &pool->parked;
+    xthread_stack_init(&pool->idle_fibers);
+    pool->num_workers = num_threads;
+    pool->workers     = (struct xthread_pool_worker*)XTHREAD_MALLOC(sizeof(*pool->workers) * num_threads);
+    memset(pool->workers, 0, sizeof(*pool->workers) * num_threads);
+
+    for (int i = 0; i < num_threads; i++)
+    {
+        struct xthread_pool_worker* w = &pool->workers[i];
+        w->pool                       = pool;
+        w->index                      = i;
+        w->rng                        = 0x9E3779B9u * (uint32_t)(i + 1);
+        xthread_signal_init(&w->wake);
+    }
+    xt_atomic_thread_fence(xt_memory_order_seq_cst);
+    for (int i = 0; i < num_threads; i++)
+    {
+        struct xthread_pool_worker* w = &pool->workers[i];
+        char name[32];
+        snprintf(name, sizeof(name), "xt_pool %d", i);
+
+        xt_thread_options_t options;
+        memset(&options, 0, sizeof(options));
+        options.name = name;
+        w->thread    = xthread_create_ex(xthread_pool_worker_proc, w, &options);
+        XTHREAD_ASSERT(w->thread != NULL, "Failed creating worker thread");
+    }
+    return pool;
+}
+
+void xthread_pool_destroy(xt_pool_t* pool)
+{
+    xt_atomic_store_u32(&pool->stop, 1);
+    for (int i = 0; i < pool->num_workers; i++)
+        xthread_signal_raise(&pool->workers[i].wake);
+    for (int i = 0; i < pool->num_workers; i++)
+    {
+        xthread_join(pool->workers[i].thread);
+        xthread_signal_term(&pool->workers[i].wake);
+    }
+    XTHREAD_ASSERT(xt_atomic_load_u32(&pool->num_parked) == 0, "Fiber jobs are still waiting");
+    struct xthread_pool_fiber* pf;
+    while ((pf = (struct xthread_pool_fiber*)xthread_stack_pop(&pool->idle_fibers)) != NULL)
+    {
+        xthread_fiber_destroy(pf->fiber);
+        XTHREAD_FREE(pf);
+    }
+    xthread_mpmc_queue_term(&pool->injection);
+    XTHREAD_FREE(pool->workers);
+    XTHREAD_FREE(pool);
+}
+
+int xthread_pool_num_threads(xt_pool_t* pool) { return pool->num_workers; }
+
+static void xthread_pool_push(xt_pool_t* pool, xt_job_t* job)
+{
+    struct xthread_pool_worker* self = xthread_pool_get_worker();
+    if (self && self->pool == pool && xthread_pool_deque_push(&self->deque, job))
+        ; // pushed to our own deque
+    else if (! xthread_mpmc_queue_try_push(&pool->injection, job))
+    {
+        // Everything is full. Run it now rather than block
+        xthread_pool_run_job(pool, job);
+        return;
+    }
+    xthread_pool_wake_one(pool);
+}
+
+void xthread_pool_submit(xt_pool_t* pool, xt_job_t* job, xt_job_fn fn, void* user_data)
+{
+    job->fn        = fn;
+    job->user_data = user_data;
+    job->parent    = NULL;
+    job->flags     = 0;
+    xt_atomic_store_explicit_i32(&job->unfinished, 1, xt_memory_order_relaxed);
+    xthread_pool_push(pool, job);
+}
+
+void xthread_pool_submit_child(xt_pool_t* pool, xt_job_t* parent, xt_job_t* job, xt_job_fn fn, void* user_data)
+{
+    XTHREAD_ASSERT(! xthread_job_done(parent), "Parent has already finished");
+    xt_atomic_fetch_add_explicit_i32(&parent->unfinished, 1, xt_memory_order_relaxed);
+    job->fn        = fn;
+    job->user_data = user_data;
+    job->parent    = parent;
+    job->flags     = 0;
+    xt_atomic_store_explicit_i32(&job->unfinished, 1, xt_memory_order_relaxed);
+    xthread_pool_push(pool, job);
+}
+
+void xthread_pool_submit_fiber(xt_pool_t* pool, xt_job_t* job, xt_job_fn fn, void* user_data)
+{
+    job->fn        = fn;
+    job->user_data = user_data;
+    job->parent    = NULL;
+    job->flags     = XTHREAD_JOB_FIBER;
+    xt_atomic_store_explicit_i32(&job->unfinished, 1, xt_memory_order_relaxed);
+    xthread_pool_push(pool, job);
+}
+
+bool xthread_job_done(xt_job_t* job) { return xt_atomic_load_explicit_i32(&job->unfinished, xt_memory_order_acquire) == 0; }
+
+void xthread_pool_wait(xt_pool_t* pool, xt_job_t* job)
+{
+    // Fiber jobs park and hand the thread back to whoever resumed them
+    xt_fiber_t* fiber = xthread_fiber_get_current();
+    if (fiber && fiber->fn == xthread_pool_fiber_proc)
+    {
+        struct xthread_pool_fiber* pf = (struct xthread_pool_fiber*)fiber->user_data;
+        if (pf->pool == pool)
+        {
+            while (! xthread_job_done(job))
+            {
+                pf->wait_job = job;
+                pf->state    = XTHREAD_POOL_FIBER_PARKED;
+                xthread_fiber_switch(fiber->caller);
+            }
+            return;
+        }
+    }
+
+    struct xthread_pool_worker* self = xthread_pool_get_worker();
+    if (self && self->pool != pool)
+        self = NULL;
+
+    int spins = 0;
+    while (! xthread_job_done(job))
+    {
+        xt_job_t*                  other = xthread_pool_find_job(pool, self);
+        struct xthread_pool_fiber* pf    = other ? NULL : xthread_pool_take_ready_fiber(pool);
+        if (other)
+        {
+            xthread_pool_run_job(pool, other);
+            spins = 0;
+        }
+        else if (pf)
+        {
+            xthread_pool_resume_fiber(pool, pf);
+            spins = 0;
+        }
+        else if (++spins < 64)
+            xthread_cpu_relax();
+        else
+            xthread_yield();
+    }
+}
+
+struct xthread_parallel_desc
+{
+    xt_pool_t*   pool;
+    xt_range_fn  for_fn;
+    xt_reduce_fn reduce_fn;
+    xt_join_fn   join_fn;
+    void*        ctx;
+    int64_t      grain;
+    size_t       result_size;
+    uint64_t     identity[XTHREAD_REDUCE_MAX_SIZE / sizeof(uint64_t)];
+};
+
+struct xthread_parallel_task
+{
+    xt_job_t                            job;
+    const struct xthread_parallel_desc* desc;
+    int64_t                             begin;
+    int64_t                             end;
+    void*                               result;
+};
+
+static void xthread_parallel_job(void* arg)
+{
+    struct xthread_parallel_task*       task = (struct xthread_parallel_task*)arg;
+    const struct xthread_parallel_desc* desc = task->desc;
+
+    if (task->end - task->begin > desc->grain)
+    {
+        uint64_t right_result[XTHREAD_REDUCE_MAX_SIZE / sizeof(uint64_t)];
+
+        int64_t                      mid   = task->begin + (task->end - task->begin) / 2;
+        struct xthread_parallel_task left  = *task;
+        struct xthread_parallel_task right = *task;
+        left.end                           = mid;
+        right.begin                        = mid;
+        if (desc->reduce_fn)
+        {
+            memcpy(right_result, desc->identity, desc->result_size);
+            right.result = right_result;
+        }
+
+        xthread_pool_submit(desc->pool, &right.job, xthread_parallel_job, &right);
+        xthread_parallel_job(&left);
+        // If nobody stole the right half, this pops it straight back off our deque and runs it here
+        xthread_pool_wait(desc->pool, &right.job);
+
+        if (desc->reduce_fn)
+            desc->join_fn(desc->ctx, task->result, right_result);
+    }
+    else if (desc->reduce_fn)
+        desc->reduce_fn(desc->ctx, task->begin, task->end, task->result);
+    else
+        desc->for_fn(desc->ctx, task->begin, task->end);
+}
+
+static void xthread_parallel_run(struct xthread_parallel_desc* desc, int64_t begin, int64_t end, void* result)
+{
+    if (desc->grain <= 0)
+    {
+        // ~8 ranges per worker leaves room for stealing to even out uneven work
+        desc->grain = (end - begin) / ((int64_t)xthread_pool_num_threads(desc->pool) * 8);
+        if (desc->grain < 1)
+            desc->grain = 1;
+    }
+    struct xthread_parallel_task task;
+    task.desc   = desc;
+    task.begin  = begin;
+    task.end    = end;
+    task.result = result;
+    if (begin < end)
+        xthread_parallel_job(&task);
+}
+
+void xthread_parallel_for(xt_pool_t* pool, int64_t begin, int64_t end, int64_t grain, xt_range_fn fn, void* ctx)
+{
+    struct xthread_parallel_desc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.pool   = pool;
+    desc.for_fn = fn;
+    desc.ctx    = ctx;
+    desc.grain  = grain;
+    xthread_parallel_run(&desc, begin, end, NULL);
+}
+
+void xthread_parallel_reduce(
+    xt_pool_t*   pool,
+    int64_t      begin,
+    int64_t      end,
+    int64_t      grain,
+    xt_reduce_fn reduce_fn,
+    xt_join_fn   join_fn,
+    void*        ctx,
+    void*        result,
+    size_t       result_size)
+{
+    XTHREAD_ASSERT(result_size <= XTHREAD_REDUCE_MAX_SIZE, "Result too big");
+    struct xthread_parallel_desc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.pool        = pool;
+    desc.reduce_fn   = reduce_fn;
+    desc.join_fn     = join_fn;
+    desc.ctx         = ctx;
+    desc.grain       = grain;
+    desc.result_size = result_size;
+    memcpy(desc.identity, result, result_size);
+    xthread_parallel_run(&desc, begin, end, result);
+}
+
+struct xthread_graph_node
+{
+    xt_job_t          job;
+    xt_graph_t*       graph;
+    xt_job_fn         fn;
+    void*             user_data;
+    xt_atomic_int32_t pending;
+    int               num_predecessors;
+    int               first_successor; // Index into graph->successors
+    int               num_successors;
+};
+
+struct xthread_graph_edge
+{
+    int from;
+    int to;
+};
+
+struct xt_graph_t
+{
+    struct xthread_graph_node* nodes;
+    struct xthread_graph_edge* edges;
+    int*                       successors;
+    int*                       roots;
+    int                        num_nodes;
+    int                        max_nodes;
+    int                        num_edges;
+    int                        max_edges;
+    int                        num_roots;
+    bool                       dirty;
+
+    // Set during a run
+    xt_pool_t* pool;
+    xt_job_t   done;
+};
+
+xt_graph_t* xthread_graph_create(int max_nodes, int max_dependencies)
+{
+    xt_graph_t* graph = (xt_graph_t*)XTHREAD_MALLOC(sizeof(*graph));
+    memset(graph, 0, sizeof(*graph));
+    graph->nodes      = (struct xthread_graph_node*)XTHREAD_MALLOC(sizeof(*graph->nodes) * max_nodes);
+    graph->edges      = (struct xthread_graph_edge*)XTHREAD_MALLOC(sizeof(*graph->edges) * max_dependencies);
+    graph->successors = (int*)XTHREAD_MALLOC(sizeof(int) * max_dependencies);
+    graph->roots      = (int*)XTHREAD_MALLOC(sizeof(int) * max_nodes);
+    graph->max_nodes  = max_nodes;
+    graph->max_edges  = max_dependencies;
+    return graph;
+}
+
+void xthread_graph_destroy(xt_graph_t* graph)
+{
+    XTHREAD_FREE(graph->nodes);
+    XTHREAD_FREE(graph->edges);
+    XTHREAD_FREE(graph->successors);
+    XTHREAD_FREE(graph->roots);
+    XTHREAD_FREE(graph);
+}
+
+int xthread_graph_add_node(xt_graph_t* graph, xt_job_fn fn, void* user_data)
+{
+    XTHREAD_ASSERT(graph->num_nodes < graph->max_nodes, "Too many nodes");
+    int                        idx  = graph->num_nodes++;
+    struct xthread_graph_node* node = &graph->nodes[idx];
+    memset(node, 0, sizeof(*node));
+    node->graph     = graph;
+    node->fn        = fn;
+    node->user_data = user_data;
+    graph->dirty    = true;
+    return idx;
+}
+
+void xthread_graph_add_dependency(xt_graph_t* graph, int node, int depends_on)
+{
+    XTHREAD_ASSERT(graph->num_edges < graph->max_edges, "Too many dependencies");
+    XTHREAD_ASSERT(node >= 0 && node < graph->num_nodes, "Invalid node");
+    XTHREAD_ASSERT(depends_on >= 0 && depends_on < graph->num_nodes, "Invalid node");
+    struct xthread_graph_edge* edge = &graph->edges[graph->num_edges++];
+    edge->from                      = depends_on;
+    edge->to                        = node;
+    graph->dirty                    = true;
+}
+
+// Counting sort of the edges by their source node, so each nodes successors are contiguous
+static void xthread_graph_sort(xt_graph_t* graph)
+{
+    struct xthread_graph_node* nodes = graph->nodes;
+    for (int i = 0; i < graph->num_nodes; i++)
+    {
+        nodes[i].num_predecessors = 0;
+        nodes[i].num_successors   = 0;
+    }
+    for (int i = 0; i < graph->num_edges; i++)
+    {
+        nodes[graph->edges[i].from].num_successors++;
+        nodes[graph->edges[i].to].num_predecessors++;
+    }
+    int offset       = 0;
+    graph->num_roots = 0;
+    for (int i = 0; i < graph->num_nodes; i++)
+    {
+        nodes[i].first_successor = offset;
+        offset                  += nodes[i].num_successors;
+        nodes[i].num_successors  = 0;
+        if (nodes[i].num_predecessors == 0)
+            graph->roots[graph->num_roots++] = i;
+    }
+    for (int i = 0; i < graph->num_edges; i++)
+    {
+        struct xthread_graph_node* from = &nodes[graph->edges[i].from];
+        graph->successors[from->first_successor + from->num_successors++] = graph->edges[i].to;
+    }
+
+#ifndef NDEBUG
+    // Kahn's algorithm. If we can't visit every node there is a cycle. 'roots' past num_roots is scratch space
+    int num_visited = graph->num_roots;
+    for (int i = 0; i < graph->num_nodes; i++)
+        nodes[i].pending = nodes[i].num_predecessors;
+    for (int i = 0; i < num_visited; i++)
+    {
+        struct xthread_graph_node* node = &nodes[graph->roots[i]];
+        for (int j = 0; j < node->num_successors; j++)
+        {
+            int succ = graph->successors[node->first_successor + j];
+            if (--nodes[succ].pending == 0)
+                graph->roots[num_visited++] = succ;
+        }
+    }
+    XTHREAD_ASSERT(num_visited == graph->num_nodes, "Graph contains a cycle");
+#endif
+    graph->dirty = false;
+}
+
+static void xthread_graph_node_proc(void* arg)
+{
+    struct xthread_graph_node* node  = (struct xthread_graph_node*)arg;
+    xt_graph_t*                graph = node->graph;
+
+    while (node)
+    {
+        node->fn(node->user_data);
+
+        // Keep one ready successor to run ourselves, it saves a trip through the deque and stays cache warm
+        struct xthread_graph_node* next = NULL;
+        for (int i = 0; i < node->num_successors; i++)
+        {
+            struct xthread_graph_node* succ = &graph->nodes[graph->successors[node->first_successor + i]];
+            if (xt_atomic_fetch_sub_explicit_i32(&succ->pending, 1, xt_memory_order_acq_rel) == 1)
+            {
+                if (next)
+                    xthread_pool_submit_child(graph->pool, &graph->done, &next->job, xthread_graph_node_proc, next);
+                next = succ;
+            }
+        }
+        node = next;
+    }
+}
+
+void xthread_graph_run(xt_graph_t* graph, xt_pool_t* pool)
+{
+    if (graph->dirty)
+        xthread_graph_sort(graph);
+    if (graph->num_nodes == 0)
+        return;
+
+    for (int i = 0; i < graph->num_nodes; i++)
+        xt_atomic_store_explicit_i32(&graph->nodes[i].pending, graph->nodes[i].num_predecessors, xt_memory_order_relaxed);
+
+    // 'done' is never run itself, it only exists so every node can be counted as its child. The extra count we hold
+    // stops it completing while roots are still being submitted
+    graph->pool           = pool;
+    graph->done.fn        = NULL;
+    graph->done.user_data = NULL;
+    graph->done.parent    = NULL;
+    graph->done.flags     = 0;
+    xt_atomic_store_explicit_i32(&graph->done.unfinished, 1, xt_memory_order_relaxed);
+
+    for (int i = 0; i < graph->num_roots; i++)
+    {
+        struct xthread_graph_node* root = &graph->nodes[graph->roots[i]];
+        xthread_pool_submit_child(pool, &graph->done, &root->job, xthread_graph_node_proc, root);
+    }
+    xthread_pool_finish_job(pool, &graph->done);
+    xthread_pool_wait(pool, &graph->done);
+}
+
+// Readers announce (epoch << 1) | 1 while inside, 0 when outside. The global epoch only advances when every active
+// reader has announced the current epoch, so while a reader is inside epoch E the global epoch is at most E + 1.
+// Objects retired in epoch E are unlinked before any reader could enter E + 1, and are freed once the global epoch
+// reaches E + 2. Only three lists of retired objects are needed: E - 1 (freeable), E and E + 1
+struct xt_ebr_reader_t
+{
+    xt_atomic_uint64_t epoch;
+    xt_ebr_t*          ebr;
+    xt_atomic_uint32_t in_use;
+    char               pad[XTHREAD_CACHE_LINE_SIZE - sizeof(uint64_t) - sizeof(xt_ebr_t*) - sizeof(uint32_t)];
+};
+XTHREAD_STATIC_ASSERT(sizeof(xt_ebr_reader_t) == XTHREAD_CACHE_LINE_SIZE, "Readers must not share cache lines");
+
+struct xthread_ebr_node
+{
+    struct xthread_ebr_node* next;
+    void*                    ptr;
+    xt_ebr_free_fn           free_fn;
+    void*                    ctx;
+};
+
+struct xt_ebr_t
+{
+    xt_atomic_uint64_t       epoch;
+    xt_fastmutex_t           mutex; // Guards 'retired'
+    struct xthread_ebr_node* retired[3];
+    int                      max_readers;
+    xt_ebr_reader_t*         readers;
+};
+
+xt_ebr_t* xthread_ebr_create(int max_readers)
+{
+    xt_ebr_t* ebr = (xt_ebr_t*)XTHREAD_MALLOC(sizeof(*ebr));
+    memset(ebr, 0, sizeof(*ebr));
+    ebr->max_readers = max_readers;
+    ebr->readers     = (xt_ebr_reader_t*)XTHREAD_MALLOC(sizeof(*ebr->readers) * max_readers);
+    memset(ebr->readers, 0, sizeof(*ebr->readers) * max_readers);
+    for (int i = 0; i < max_readers; i++)
+        ebr->readers[i].ebr = ebr;
+    xt_atomic_thread_fence(xt_memory_order_seq_cst);
+    return ebr;
+}
+
+static int xthread_ebr_free_list(struct xthread_ebr_node* node)
+{
+    int n = 0;
+    while (node)
+    {
+        struct xthread_ebr_node* next = node->next;
+        node->free_fn(node->ctx, node->ptr);
+        XTHREAD_FREE(node);
+        node = next;
+        n++;
+    }
+    return n;
+}
+
+void xthread_ebr_destroy(xt_ebr_t* ebr)
+{
+    for (int i = 0; i < 3; i++)
+        xthread_ebr_free_list(ebr->retired[i]);
+    XTHREAD_FREE(ebr->readers);
+    XTHREAD_FREE(ebr);
+}
+
+xt_ebr_reader_t* xthread_ebr_register(xt_ebr_t* ebr)
+{
+    for (int i = 0; i < ebr->max_readers; i++)
+    {
+        xt_ebr_reader_t* reader = &ebr->readers[i];
+        if (xt_atomic_compare_exchange_u32(&reader->in_use, 0, 1) == 0)
+        {
+            xt_atomic_store_u64(&reader->epoch, 0);
+            return reader;
+        }
+    }
+    return NULL;
+}
+
+void xthread_ebr_unregister(xt_ebr_t* ebr, xt_ebr_reader_t* reader)
+{
+    (void)ebr;
+    XTHREAD_ASSERT(reader->ebr == ebr, "Reader belongs to another ebr");
+    XTHREAD_ASSERT(xt_atomic_load_u64(&reader->epoch) == 0, "Unregistered while inside");
+    xt_atomic_store_u32(&reader->in_use, 0);
+}
+
+void xthread_ebr_enter(xt_ebr_reader_t* reader)
+{
+    XTHREAD_ASSERT(xt_atomic_load_explicit_u64(&reader->epoch, xt_memory_order_relaxed) == 0, "Nested enter");
+    // The announcement must be visible before we load any shared pointers, hence seq_cst. If the epoch moved before
+    // it became visible, announce again so we don't hold back the epoch needlessly
+    uint64_t epoch = xt_atomic_load_u64(&reader->ebr->epoch);
+    for (;;)
+    {
+        xt_atomic_store_u64(&reader->epoch, (epoch << 1) | 1);
+        uint64_t now = xt_atomic_load_u64(&reader->ebr->epoch);
+        if (now == epoch)
+            break;
+        epoch = now;
+    }
+}
+
+void xthread_ebr_exit(xt_ebr_reader_t* reader)
+{
+    xt_atomic_store_explicit_u64(&reader->epoch, 0, xt_memory_order_release);
+}
+
+void xthread_ebr_retire(xt_ebr_t* ebr, void* ptr, xt_ebr_free_fn free_fn, void* ctx)
+{
+    struct xthread_ebr_node* node = (struct xthread_ebr_node*)XTHREAD_MALLOC(sizeof(*node));
+    node->ptr                     = ptr;
+    node->free_fn                 = free_fn;
+    node->ctx                     = ctx;
+
+    xt_fastmutex_lock(&ebr->mutex);
+    uint64_t epoch          = xt_atomic_load_u64(&ebr->epoch);
+    node->next              = ebr->retired[epoch % 3];
+    ebr->retired[epoch % 3] = node;
+    xt_fastmutex_unlock(&ebr->mutex);
+}
+
+void* xthread_ebr_publish(xt_ebr_t* ebr, xt_atomic_ptr_t* ptr, void* obj, xt_ebr_free_fn free_fn, void* ctx)
+{
+    void* prev = xt_atomic_exchange_ptr(ptr, obj);
+    if (prev)
+        xthread_ebr_retire(ebr, prev, free_fn, ctx);
+    return prev;
+}
+
+int xthread_ebr_collect(xt_ebr_t* ebr)
+{
+    struct xthread_ebr_node* freeable = NULL;
+
+    xt_fastmutex_lock(&ebr->mutex);
+    uint64_t epoch   = xt_atomic_load_u64(&ebr->epoch);
+    bool     advance = true;
+    for (int i = 0; i < ebr->max_readers && advance; i++)
+    {
+        uint64_t e = xt_atomic_load_u64(&ebr->readers[i].epoch);
+        if ((e & 1) && (e >> 1) != epoch)
+            advance = false;
+    }
+    if (advance)
+    {
+        xt_atomic_store_u64(&ebr->epoch, epoch + 1);
+        // Retired in epoch - 1, which shares a list with epoch + 2
+        freeable                      = ebr->retired[(epoch + 2) % 3];
+        ebr->retired[(epoch + 2) % 3] = NULL;
+    }
+    xt_fastmutex_unlock(&ebr->mutex);
+
+    return xthread_ebr_free_list(freeable);
+}
+
+static xt_atomic_uint32_t     g_xthread_counter_next_shard = 0;
+static XTHREAD_LOCAL uint32_t g_xthread_counter_shard      = 0; // Shard index + 1, 0 until first use
+
+void xt_counter_add(xt_counter_t* counter, int64_t v)
+{
+    uint32_t shard = g_xthread_counter_shard;
+    if (shard == 0)
+    {
+        // Hand out shards round robin, so the first XTHREAD_COUNTER_SHARDS threads get one each
+        uint32_t next           = xt_atomic_fetch_add_explicit_u32(&g_xthread_counter_next_shard, 1, xt_memory_order_relaxed);
+        shard                   = next % XTHREAD_COUNTER_SHARDS + 1;
+        g_xthread_counter_shard = shard;
+    }
+    xt_atomic_fetch_add_explicit_i64(&counter->shards[shard - 1].value, v, xt_memory_order_relaxed);
+}
+
+int64_t xt_counter_read(const xt_counter_t* counter)
+{
+    int64_t sum = 0;
+    for (int i = 0; i < XTHREAD_COUNTER_SHARDS; i++)
+        sum += xt_atomic_load_explicit_i64(&counter->shards[i].value, xt_memory_order_relaxed);
+    return sum;
+}
+
+void xt_counter_reset(xt_counter_t* counter)
+{
+    for (int i = 0; i < XTHREAD_COUNTER_SHARDS; i++)
+        xt_atomic_store_explicit_i64(&counter->shards[i].value, 0, xt_memory_order_relaxed);
+}
+
+struct xthread_deadline_record
+{
+    uint64_t    duration_ns;
+    uint64_t    deadline_ns;
+    uint64_t    zone_ns;
+    const char* zone;
+};
+
+struct xt_deadline_t
+{
+    xt_spsc_ring_t ring;
+
+    // Realtime thread, read by the watchdog to spot stuck cycles
+    xt_atomic_uint64_t cycle_start; // 0 outside a cycle
+    xt_atomic_uint64_t cycle_deadline;
+    xt_atomic_ptr_t    zone;
+    xt_atomic_uint64_t zone_start;
+    xt_atomic_uint64_t num_dropped;
+    uint64_t           longest_zone_ns;
+    const char*        longest_zone;
+    char               pad0[XTHREAD_CACHE_LINE_SIZE - 5 * sizeof(uint64_t) - 2 * sizeof(void*)];
+
+    // Watchdog, guarded by the monitors mutex
+    const char*                    name;
+    bool                           in_use;
+    uint64_t                       reported_start; // Stuck cycle already reported
+    uint64_t                       dropped_base;   // num_dropped at the last reset
+    xt_deadline_stats_t            stats;
+    uint64_t                       histogram[XTHREAD_DEADLINE_HISTOGRAM_SIZE];
+    struct xthread_deadline_record records[XTHREAD_DEADLINE_RING_SIZE];
+};
+
+struct xt_deadline_monitor_t
+{
+    xt_fastmutex_t         mutex;
+    xt_atomic_uint32_t     stop;
+    xt_signal_t            wake;
+    xt_thread_ptr_t        thread;
+    int                    interval_ms;
+    xt_deadline_overrun_fn on_overrun;
+    void*                  ctx;
+    int                    max_threads;
+    xt_deadline_t*         deadlines;
+    struct xthread_deadline_record batch[XTHREAD_DEADLINE_RING_SIZE];
+    // Overruns waiting for the watchdog to pass them to on_overrun, and its copy to call it with outside the lock
+    int                    num_pending;
+    xt_deadline_overrun_t  pending[XTHREAD_DEADLINE_RING_SIZE];
+    xt_deadline_overrun_t  reporting[XTHREAD_DEADLINE_RING_SIZE];
+};
+
+// Log-linear buckets: values below 8 get one each, above that each power of 2 is split in 8
+static int xthread_deadline_bucket(uint64_t ns)
+{
+    if (ns < 8)
+        return (int)ns;
+#if defined(_MSC_VER) && !(__clang__) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long msb;
+    _BitScanReverse64(&msb, ns);
+#elif defined(_MSC_VER) && !(__clang__)
+    unsigned long msb;
+    if (_BitScanReverse(&msb, (unsigned long)(ns >> 32)))
+        msb += 32;
+    else
+        _BitScanReverse(&msb, (unsigned long)ns);
+#else
+    int msb = 63 - __builtin_clzll(ns);
+#endif
+    return ((int)msb - 2) * 8 + (int)((ns >> (msb - 3)) & 7);
+}
+
+static uint64_t xthread_deadline_bucket_max(int bucket)
+{
+    if (bucket < 8)
+        return (uint64_t)bucket;
+    int shift = bucket / 8 - 1;
+    return ((uint64_t)(8 + bucket % 8 + 1) << shift) - 1;
+}
+
+static uint64_t xthread_deadline_percentile(const xt_deadline_t* d, uint64_t total, double percentile)
+{
+    uint64_t target = (uint64_t)(total * percentile);
+    uint64_t sum    = 0;
+    for (int i = 0; i < XTHREAD_DEADLINE_HISTOGRAM_SIZE; i++)
+    {
+        sum += d->histogram[i];
+        if (sum > target)
+            return xthread_deadline_bucket_max(i);
+    }
+    return 0;
+}
+
+// Monitor must be locked. Queued for the watchdog, on_overrun is never called with the monitor locked
+static void xthread_deadline_queue_overrun(xt_deadline_monitor_t* monitor, const xt_deadline_overrun_t* overrun)
+{
+    if (monitor->on_overrun && monitor->num_pending < XTHREAD_DEADLINE_RING_SIZE)
+        monitor->pending[monitor->num_pending++] = *overrun;
+}
+
+// Monitor must be locked
+static void xthread_deadline_collect(xt_deadline_monitor_t* monitor, xt_deadline_t* d)
+{
+    uint32_t n;
+    while ((n = xthread_spsc_ring_consume_n(&d->ring, monitor->batch, XTHREAD_DEADLINE_RING_SIZE)) > 0)
+    {
+        for (uint32_t i = 0; i < n; i++)
+        {
+            const struct xthread_deadline_record* r = &monitor->batch[i];
+
+            d->stats.cycles++;
+            d->histogram[xthread_deadline_bucket(r->duration_ns)]++;
+            if (r->duration_ns > d->stats.worst_ns)
+            {
+                d->stats.worst_ns          = r->duration_ns;
+                d->stats.worst_deadline_ns = r->deadline_ns;
+                d->stats.worst_zone        = r->zone;
+                d->stats.worst_zone_ns     = r->zone_ns;
+            }
+            if (r->duration_ns > r->deadline_ns)
+            {
+                d->stats.overruns++;
+                xt_deadline_overrun_t overrun;
+                overrun.thread_name   = d->name;
+                overrun.duration_ns   = r->duration_ns;
+                overrun.deadline_ns   = r->deadline_ns;
+                overrun.zone          = r->zone;
+                overrun.zone_ns       = r->zone_ns;
+                overrun.still_running = false;
+                xthread_deadline_queue_overrun(monitor, &overrun);
+            }
+        }
+    }
+    d->stats.dropped = xt_atomic_load_explicit_u64(&d->num_dropped, xt_memory_order_relaxed) - d->dropped_base;
+}
+
+// Monitor must be locked
+static void xthread_deadline_check_stuck(xt_deadline_monitor_t* monitor, xt_deadline_t* d)
+{
+    uint64_t start = xt_atomic_load_explicit_u64(&d->cycle_start, xt_memory_order_acquire);
+    if (start == 0 || start == d->reported_start)
+        return;
+    uint64_t deadline = xt_atomic_load_explicit_u64(&d->cycle_deadline, xt_memory_order_relaxed);
+    uint64_t now      = XTHREAD_DEADLINE_CLOCK_NS();
+    if (now - start <= deadline)
+        return;
+
+    // The cycle may end while we look, in which case the values are slightly stale but harmless
+    d->reported_start = start;
+    d->stats.hangs++;
+    xt_deadline_overrun_t overrun;
+    overrun.thread_name   = d->name;
+    overrun.duration_ns   = now - start;
+    overrun.deadline_ns   = deadline;
+    overrun.zone          = (const char*)xt_atomic_load_explicit_ptr(&d->zone, xt_memory_order_relaxed);
+    overrun.zone_ns       = now - xt_atomic_load_explicit_u64(&d->zone_start, xt_memory_order_relaxed);
+    overrun.still_running = true;
+    xthread_deadline_queue_overrun(monitor, &overrun);
+}
+
+static int xthread_deadline_watchdog_proc(void* arg)
+{
+    xt_deadline_monitor_t* monitor = (xt_deadline_monitor_t*)arg;
+    bool stopping = false;
+    while (! stopping)
+    {
+        xthread_signal_wait(&monitor->wake, monitor->interval_ms);
+        // One last pass after destroy wakes us, so overruns queued before then are still reported
+        stopping = xt_atomic_load_explicit_u32(&monitor->stop, xt_memory_order_acquire) != 0;
+
+        xt_fastmutex_lock(&monitor->mutex);
+        for (int i = 0; i < monitor->max_threads; i++)
+        {
+            xt_deadline_t* d = &monitor->deadlines[i];
+            if (! d->in_use)
+                continue;
+            xthread_deadline_collect(monitor, d);
+            xthread_deadline_check_stuck(monitor, d);
+        }
+        // Only this thread touches 'reporting'
+        int num_reporting = monitor->num_pending;
+        memcpy(monitor->reporting, monitor->pending, sizeof(monitor->pending[0]) * num_reporting);
+        monitor->num_pending = 0;
+        xt_fastmutex_unlock(&monitor->mutex);
+
+        for (int i = 0; i < num_reporting; i++)
+            monitor->on_overrun(monitor->ctx, &monitor->reporting[i]);
+    }
+    return 0;
+}
+
+xt_deadline_monitor_t*
+xthread_deadline_monitor_create(int max_threads, int interval_ms, xt_deadline_overrun_fn on_overrun, void* ctx)
+{
+    XTHREAD_ASSERT(max_threads > 0, "Monitor needs at least one thread");
+    xt_deadline_monitor_t* monitor = (xt_deadline_monitor_t*)XTHREAD_MALLOC(sizeof(*monitor));
+    memset(monitor, 0, sizeof(*monitor));
+    monitor->interval_ms = interval_ms > 0 ? interval_ms : 100;
+    monitor->on_overrun  = on_overrun;
+    monitor->ctx         = ctx;
+    monitor->max_threads = max_threads;
+    monitor->deadlines   = (xt_deadline_t*)XTHREAD_MALLOC(sizeof(*monitor->deadlines) * max_threads);
+    memset(monitor->deadlines, 0, sizeof(*monitor->deadlines) * max_threads);
+    xthread_signal_init(&monitor->wake);
+    xt_atomic_thread_fence(xt_memory_order_seq_cst);
+
+    xt_thread_options_t options;
+    memset(&options, 0, sizeof(options));
+    options.name    = "xt_watchdog";
+    monitor->thread = xthread_create_ex(xthread_deadline_watchdog_proc, monitor, &options);
+    XTHREAD_ASSERT(monitor->thread != NULL, "Failed creating watchdog thread");
+    return monitor;
+}
+
+void xthread_deadline_monitor_destroy(xt_deadline_monitor_t* monitor)
+{
+    xt_atomic_store_explicit_u32(&monitor->stop, 1, xt_memory_order_release);
+    xthread_signal_raise(&monitor->wake);
+    xthread_join(monitor->thread);
+    xthread_signal_term(&monitor->wake);
+    XTHREAD_FREE(monitor->deadlines);
+    XTHREAD_FREE(monitor);
+}
+
+xt_deadline_t* xthread_deadline_register(xt_deadline_monitor_t* monitor, const char* name)
+{
+    xt_deadline_t* d = NULL;
+    xt_fastmutex_lock(&monitor->mutex);
+    for (int i = 0; i < monitor->max_threads; i++)
+    {
+        if (! monitor->deadlines[i].in_use)
+        {
+            d = &monitor->deadlines[i];
+            memset(d, 0, sizeof(*d));
+            xthread_spsc_ring_init(&d->ring, d->records, sizeof(d->records[0]), XTHREAD_DEADLINE_RING_SIZE);
+            d->name   = name;
+            d->in_use = true;
+            break;
+        }
+    }
+    xt_fastmutex_unlock(&monitor->mutex);
+    return d;
+}
+
+void xthread_deadline_unregister(xt_deadline_monitor_t* monitor, xt_deadline_t* deadline)
+{
+    xt_fastmutex_lock(&monitor->mutex);
+    deadline->in_use = false;
+    xt_fastmutex_unlock(&monitor->mutex);
+}
+
+void xthread_deadline_begin(xt_deadline_t* d, uint64_t deadline_ns)
+{
+    uint64_t now = XTHREAD_DEADLINE_CLOCK_NS();
+    d->longest_zone_ns = 0;
+    d->longest_zone    = NULL;
+    xt_atomic_store_explicit_ptr(&d->zone, NULL, xt_memory_order_relaxed);
+    xt_atomic_store_explicit_u64(&d->zone_start, now, xt_memory_order_relaxed);
+    xt_atomic_store_explicit_u64(&d->cycle_deadline, deadline_ns, xt_memory_order_relaxed);
+    xt_atomic_store_explicit_u64(&d->cycle_start, now, xt_memory_order_release);
+}
+
+// Closes the current zone, keeping it if it's the longest so far
+static void xthread_deadline_close_zone(xt_deadline_t* d, uint64_t now)
+{
+    uint64_t elapsed = now - xt_atomic_load_explicit_u64(&d->zone_start, xt_memory_order_relaxed);
+    if (elapsed > d->longest_zone_ns)
+    {
+        d->longest_zone_ns = elapsed;
+        d->longest_zone    = (const char*)xt_atomic_load_explicit_ptr(&d->zone, xt_memory_order_relaxed);
+    }
+}
+
+void xthread_deadline_zone(xt_deadline_t* d, const char* zone)
+{
+    uint64_t now = XTHREAD_DEADLINE_CLOCK_NS();
+    xthread_deadline_close_zone(d, now);
+    xt_atomic_store_explicit_ptr(&d->zone, (void*)zone, xt_memory_order_relaxed);
+    xt_atomic_store_explicit_u64(&d->zone_start, now, xt_memory_order_relaxed);
+}
+
+void xthread_deadline_end(xt_deadline_t* d)
+{
+    uint64_t now   = XTHREAD_DEADLINE_CLOCK_NS();
+    uint64_t start = xt_atomic_load_explicit_u64(&d->cycle_start, xt_memory_order_relaxed);
+    XTHREAD_ASSERT(start != 0, "xthread_deadline_end called without begin");
+    xthread_deadline_close_zone(d, now);
+
+    struct xthread_deadline_record r;
+    r.duration_ns = now - start;
+    r.deadline_ns = xt_atomic_load_explicit_u64(&d->cycle_deadline, xt_memory_order_relaxed);
+    r.zone_ns     = d->longest_zone_ns;
+    r.zone        = d->longest_zone;
+    if (! xthread_spsc_ring_produce(&d->ring, &r))
+    {
+        // Only this thread writes it
+        uint64_t dropped = xt_atomic_load_explicit_u64(&d->num_dropped, xt_memory_order_relaxed);
+        xt_atomic_store_explicit_u64(&d->num_dropped, dropped + 1, xt_memory_order_relaxed);
+    }
+    xt_atomic_store_explicit_u64(&d->cycle_start, 0, xt_memory_order_release);
+}
+
+void xthread_deadline_get_stats(xt_deadline_monitor_t* monitor, xt_deadline_t* d, xt_deadline_stats_t* stats)
+{
+    xt_fastmutex_lock(&monitor->mutex);
+    xthread_deadline_collect(monitor, d);
+    *stats = d->stats;
+
+    uint64_t total = 0;
+    for (int i = 0; i < XTHREAD_DEADLINE_HISTOGRAM_SIZE; i++)
+        total += d->histogram[i];
+    stats->p50_ns  = xthread_deadline_percentile(d, total, 0.5);
+    stats->p99_ns  = xthread_deadline_percentile(d, total, 0.99);
+    stats->p999_ns = xthread_deadline_percentile(d, total, 0.999);
+    xt_fastmutex_unlock(&monitor->mutex);
+}
+
+void xthread_deadline_reset_stats(xt_deadline_monitor_t* monitor, xt_deadline_t* d)
+{
+    xt_fastmutex_lock(&monitor->mutex);
+    xthread_deadline_collect(monitor, d);
+    memset(&d->stats, 0, sizeof(d->stats));
+    memset(d->histogram, 0, sizeof(d->histogram));
+    // Only the realtime thread writes num_dropped
+    d->dropped_base = xt_atomic_load_explicit_u64(&d->num_dropped, xt_memory_order_relaxed);
+    xt_fastmutex_unlock(&monitor->mutex);
 }
 
 #endif /* XHL_THREAD_IMPL */
-// clang-format on
\ No newline at end of file
+// clang-format on
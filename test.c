@@ -5,6 +5,14 @@
 #define XHL_ALLOC_IMPL
 #define XHL_FILES_IMPL
 #define XHL_STRING_IMPL
+#define XHL_THREAD_IMPL
+
+// The deadline monitor test drives the clock itself
+static unsigned long long test_deadline_clock_ns(void);
+#define XTHREAD_DEADLINE_CLOCK_NS() test_deadline_clock_ns()
+
+// Before any system headers, see the top of thread.h
+#include "./include/xhl/thread.h"
 
 #include "./include/xhl/debug.h"
 
@@ -31,7 +39,7 @@ void test_formatting(const char* fmt, ...)
     };
     char buf_libc[256] = {0};
     char buf_gbx[256]  = {0};
-    _Static_assert(CAP <= sizeof(buf_gbx), "");
+    xstatic_assert(CAP <= sizeof(buf_gbx), "");
     int result = 0;
 
     va_list args;
@@ -47,6 +55,823 @@ void test_formatting(const char* fmt, ...)
     xassert(result == 0);
 }
 
+// Bump allocator used to test xarr_allocator
+struct test_arena
+{
+    char*  buf;
+    size_t len;
+    size_t cap;
+};
+
+static void* test_arena_realloc(void* ctx, void* ptr, size_t old_size, size_t new_size)
+{
+    struct test_arena* arena = (struct test_arena*)ctx;
+
+    // Align the address rather than the offset, so the buffer itself needs no particular alignment
+    size_t offset = arena->len + (-(size_t)(arena->buf + arena->len) & 15);
+    xassert(offset + new_size <= arena->cap);
+    void* next = arena->buf + offset;
+    arena->len = offset + new_size;
+    if (ptr)
+        memcpy(next, ptr, old_size);
+    return next;
+}
+
+// Threading test helpers
+#define TEST_ATOMIC_THREADS 4
+#define TEST_ATOMIC_ITERS   100000
+struct test_atomics
+{
+    xt_atomic_uint8_t  u8;
+    xt_atomic_uint16_t u16;
+    xt_atomic_uint32_t u32;
+    xt_atomic_uint64_t u64;
+    xt_atomic_int64_t  i64;
+    xt_atomic_int32_t  cas;
+    xt_atomic_uint64_t bits;
+    xt_atomic_uint32_t xor_bits;
+};
+struct test_atomics_thread
+{
+    struct test_atomics* shared;
+    int                  index;
+};
+static int test_atomics_proc(void* ctx)
+{
+    struct test_atomics_thread* t = (struct test_atomics_thread*)ctx;
+    struct test_atomics*        a = t->shared;
+    for (int i = 0; i < TEST_ATOMIC_ITERS; i++)
+    {
+        xt_atomic_fetch_add_u8(&a->u8, 1);
+        xt_atomic_fetch_add_u16(&a->u16, 1);
+        xt_atomic_fetch_add_u32(&a->u32, 1);
+        xt_atomic_fetch_add_u64(&a->u64, 0x100000000ull);
+        xt_atomic_fetch_sub_i64(&a->i64, 2);
+        xt_atomic_fetch_xor_u32(&a->xor_bits, 1u << t->index);
+
+        int32_t v = xt_atomic_load_i32(&a->cas);
+        int32_t prev;
+        while ((prev = xt_atomic_compare_exchange_i32(&a->cas, v, v + 1)) != v)
+            v = prev;
+    }
+    xt_atomic_fetch_or_u64(&a->bits, 1ull << (40 + t->index));
+    return 0;
+}
+
+#define TEST_EXPLICIT_MESSAGES 100000
+struct test_explicit
+{
+    uint64_t           payload[4]; // Plain memory, published by the release store of ready
+    xt_atomic_uint32_t ready;
+    xt_atomic_uint32_t relaxed_count;
+    xt_atomic_uint64_t claimed;
+};
+static int test_explicit_consumer(void* ctx)
+{
+    struct test_explicit* e = (struct test_explicit*)ctx;
+    for (uint32_t i = 1; i <= TEST_EXPLICIT_MESSAGES; i++)
+    {
+        while (xt_atomic_load_explicit_u32(&e->ready, xt_memory_order_acquire) != i)
+            xthread_yield();
+        for (int j = 0; j < 4; j++)
+            xassert(e->payload[j] == (uint64_t)i * (j + 1));
+        xt_atomic_fetch_add_explicit_u32(&e->relaxed_count, 1, xt_memory_order_relaxed);
+        xt_atomic_store_explicit_u32(&e->ready, 0, xt_memory_order_release);
+    }
+    return 0;
+}
+static int test_explicit_claimer(void* ctx)
+{
+    struct test_explicit* e = (struct test_explicit*)ctx;
+    for (int i = 0; i < TEST_EXPLICIT_MESSAGES; i++)
+    {
+        uint64_t v = xt_atomic_load_explicit_u64(&e->claimed, xt_memory_order_relaxed);
+        uint64_t prev;
+        while ((prev = xt_atomic_compare_exchange_explicit_u64(&e->claimed, v, v + 1, xt_memory_order_acq_rel)) != v)
+            v = prev;
+    }
+    return 0;
+}
+
+#define TEST_SIGNAL_ROUNDS  10000
+#define TEST_SIGNAL_WAITERS 3
+struct test_signal
+{
+    xt_signal_t       ping;
+    xt_signal_t       pong;
+    xt_signal_t       start;
+    xt_atomic_int32_t started;
+};
+static int test_signal_ponger(void* ctx)
+{
+    struct test_signal* s = (struct test_signal*)ctx;
+    for (int i = 0; i < TEST_SIGNAL_ROUNDS; i++)
+    {
+        xassert(xthread_signal_wait(&s->ping, -1));
+        xthread_signal_raise(&s->pong);
+    }
+    return 0;
+}
+static int test_signal_waiter(void* ctx)
+{
+    struct test_signal* s = (struct test_signal*)ctx;
+    xassert(xthread_signal_wait(&s->start, -1));
+    xt_atomic_fetch_add_i32(&s->started, 1);
+    return 0;
+}
+
+#define TEST_MPMC_THREADS 4
+#define TEST_MPMC_ITEMS   20000
+#define TEST_MPMC_CELLS   16 // Small, so producers and consumers both end up waiting
+struct test_mpmc
+{
+    xt_mpmc_queue_t   queue;
+    xt_mpmc_cell_t    cells[TEST_MPMC_CELLS];
+    xt_atomic_int32_t seen[TEST_MPMC_THREADS * TEST_MPMC_ITEMS];
+};
+struct test_mpmc_thread
+{
+    struct test_mpmc* shared;
+    int               index;
+};
+static int test_mpmc_producer(void* ctx)
+{
+    struct test_mpmc_thread* t = (struct test_mpmc_thread*)ctx;
+    for (int i = 0; i < TEST_MPMC_ITEMS; i++)
+    {
+        // + 1 so no value is NULL
+        uintptr_t v = (uintptr_t)t->index * TEST_MPMC_ITEMS + i + 1;
+        xassert(xthread_mpmc_queue_produce(&t->shared->queue, (void*)v, XTHREAD_QUEUE_WAIT_INFINITE));
+    }
+    return 0;
+}
+static int test_mpmc_consumer(void* ctx)
+{
+    struct test_mpmc_thread* t = (struct test_mpmc_thread*)ctx;
+    for (int i = 0; i < TEST_MPMC_ITEMS; i++)
+    {
+        uintptr_t v = (uintptr_t)xthread_mpmc_queue_consume(&t->shared->queue, XTHREAD_QUEUE_WAIT_INFINITE);
+        xassert(v != 0 && v <= TEST_MPMC_THREADS * TEST_MPMC_ITEMS);
+        xt_atomic_fetch_add_i32(&t->shared->seen[v - 1], 1);
+    }
+    return 0;
+}
+
+#define TEST_SPSC_ITEMS 200000
+#define TEST_SPSC_SIZE  64
+#define TEST_SPSC_BATCH 16
+struct test_spsc_item
+{
+    uint32_t seq;
+    uint32_t check;
+    uint32_t pad; // 12 byte stride, not a power of 2
+};
+struct test_spsc
+{
+    xt_spsc_ring_t        ring;
+    struct test_spsc_item buffer[TEST_SPSC_SIZE];
+};
+static int test_spsc_producer(void* ctx)
+{
+    struct test_spsc*     s = (struct test_spsc*)ctx;
+    struct test_spsc_item batch[TEST_SPSC_BATCH];
+    uint32_t              next = 0;
+    while (next < TEST_SPSC_ITEMS)
+    {
+        // Batch sizes from 1 to 16 so the copies regularly wrap around the end of the buffer
+        uint32_t n = 1 + next % TEST_SPSC_BATCH;
+        if (n > TEST_SPSC_ITEMS - next)
+            n = TEST_SPSC_ITEMS - next;
+        for (uint32_t i = 0; i < n; i++)
+        {
+            batch[i].seq   = next + i;
+            batch[i].check = ~(next + i);
+        }
+        uint32_t sent = xthread_spsc_ring_produce_n(&s->ring, batch, n);
+        xassert(sent <= n);
+        if (sent == 0)
+            xthread_yield();
+        next += sent;
+    }
+    return 0;
+}
+
+#define TEST_DEQUE_JOBS 100000
+struct test_deque
+{
+    struct xthread_pool_deque deque;
+    xt_job_t                  jobs[TEST_DEQUE_JOBS];
+    xt_atomic_int32_t         runs[TEST_DEQUE_JOBS];
+    xt_atomic_uint32_t        done;
+};
+
+static int test_deque_thief(void* ctx)
+{
+    struct test_deque* t = (struct test_deque*)ctx;
+    while (!xt_atomic_load_u32(&t->done))
+    {
+        xt_job_t* job = xthread_pool_deque_steal(&t->deque);
+        if (job)
+            xt_atomic_fetch_add_i32(&t->runs[job - t->jobs], 1);
+    }
+    return 0;
+}
+
+struct test_pool
+{
+    xt_pool_t*        pool;
+    xt_job_t          parent;
+    xt_job_t          children[256];
+    xt_atomic_int32_t count;
+};
+static void test_pool_child(void* ctx) { xt_atomic_fetch_add_i32(&((struct test_pool*)ctx)->count, 1); }
+static void test_pool_parent(void* ctx)
+{
+    struct test_pool* t = (struct test_pool*)ctx;
+    for (int i = 0; i < 256; i++)
+        xthread_pool_submit_child(t->pool, &t->parent, &t->children[i], test_pool_child, t);
+    xt_atomic_fetch_add_i32(&t->count, 1);
+}
+
+static void test_sum_reduce(void* ctx, int64_t begin, int64_t end, void* result)
+{
+    (void)ctx;
+    for (int64_t i = begin; i < end; i++)
+        *(int64_t*)result += i;
+}
+static void test_sum_join(void* ctx, void* result, const void* other)
+{
+    (void)ctx;
+    *(int64_t*)result += *(const int64_t*)other;
+}
+
+static void test_square_range(void* ctx, int64_t begin, int64_t end)
+{
+    int64_t* nums = (int64_t*)ctx;
+    for (int64_t i = begin; i < end; i++)
+        nums[i] = i * i;
+}
+
+#define TEST_GRAPH_NODES 8
+struct test_graph
+{
+    xt_atomic_int32_t counter;
+    int               order[TEST_GRAPH_NODES];
+};
+struct test_graph_node
+{
+    struct test_graph* graph;
+    int                index;
+};
+static void test_graph_node_proc(void* ctx)
+{
+    struct test_graph_node* node = (struct test_graph_node*)ctx;
+    node->graph->order[node->index] = xt_atomic_fetch_add_i32(&node->graph->counter, 1);
+}
+
+#define TEST_CREATE_THREADS 4
+struct test_create
+{
+    xt_atomic_int32_t ran;
+    xt_atomic_int32_t named;
+};
+static int test_create_proc(void* ctx)
+{
+    struct test_create* t = (struct test_create*)ctx;
+    // Uses more than the smallest default stacks (512KB on Apple)
+    volatile char big[1024 * 1024];
+    for (int i = 0; i < (int)sizeof(big); i += 4096)
+        big[i] = (char)i;
+    if (xthread_set_name("xthread rename"))
+        xt_atomic_fetch_add_i32(&t->named, 1);
+    return xt_atomic_fetch_add_i32(&t->ran, 1) + 100;
+}
+
+struct test_realtime
+{
+    xt_realtime_t     granted[2];
+    xt_atomic_int32_t counter;
+};
+struct test_realtime_thread
+{
+    struct test_realtime* shared;
+    int                   index;
+};
+static int test_realtime_proc(void* ctx)
+{
+    struct test_realtime_thread* t = (struct test_realtime_thread*)ctx;
+    // Keep the main thread at its normal priority, only these threads ask for realtime
+    t->shared->granted[t->index] = xthread_set_realtime(XTHREAD_REALTIME_DEFAULT_PRIORITY, false);
+    for (int i = 0; i < 10000; i++)
+        xt_atomic_fetch_add_i32(&t->shared->counter, 1);
+    return 0;
+}
+
+#define TEST_FASTMUTEX_THREADS 4
+#define TEST_FASTMUTEX_ITERS   50000
+struct test_fastmutex
+{
+    xt_fastmutex_t mutex;
+    int64_t        a, b; // Plain, only touched under the mutex
+    int64_t        trylocked;
+};
+static int test_fastmutex_proc(void* ctx)
+{
+    struct test_fastmutex* t = (struct test_fastmutex*)ctx;
+    for (int i = 0; i < TEST_FASTMUTEX_ITERS; i++)
+    {
+        if (i % 8 == 0 && xt_fastmutex_trylock(&t->mutex))
+            t->trylocked++;
+        else
+            xt_fastmutex_lock(&t->mutex);
+        t->a++;
+        // Hold the lock across a yield now and then so waiters go to sleep and have to be woken
+        if (i % 1000 == 0)
+            xthread_yield();
+        t->b++;
+        xt_fastmutex_unlock(&t->mutex);
+    }
+    return 0;
+}
+
+#define TEST_PI_MUTEX_THREADS 4
+#define TEST_PI_MUTEX_ITERS   20000
+struct test_pi_mutex
+{
+    xt_mutex_t mutex;
+    int64_t    a, b; // Plain, only touched under the mutex
+};
+static int test_pi_mutex_proc(void* ctx)
+{
+    struct test_pi_mutex* t = (struct test_pi_mutex*)ctx;
+    for (int i = 0; i < TEST_PI_MUTEX_ITERS; i++)
+    {
+        xthread_mutex_lock(&t->mutex);
+        t->a++;
+        if (i % 1000 == 0)
+            xthread_yield();
+        t->b++;
+        xthread_mutex_unlock(&t->mutex);
+    }
+    return 0;
+}
+
+#define TEST_SEMAPHORE_THREADS 4
+#define TEST_SEMAPHORE_ITERS   20000
+#define TEST_SEMAPHORE_PERMITS 2
+struct test_semaphore
+{
+    xt_semaphore_t     items;
+    xt_semaphore_t     permits;
+    xt_atomic_int32_t  consumed;
+    xt_atomic_int32_t  inside;
+    xt_atomic_int32_t  max_inside;
+    xt_atomic_uint32_t gate;
+    xt_atomic_int32_t  through_gate;
+};
+static int test_semaphore_consumer(void* ctx)
+{
+    struct test_semaphore* t = (struct test_semaphore*)ctx;
+    for (int i = 0; i < TEST_SEMAPHORE_ITERS; i++)
+    {
+        xassert(xthread_semaphore_wait(&t->items, -1));
+        xt_atomic_fetch_add_i32(&t->consumed, 1);
+    }
+    return 0;
+}
+static int test_semaphore_permit(void* ctx)
+{
+    struct test_semaphore* t = (struct test_semaphore*)ctx;
+    for (int i = 0; i < 1000; i++)
+    {
+        xassert(xthread_semaphore_wait(&t->permits, -1));
+        int32_t inside = xt_atomic_fetch_add_i32(&t->inside, 1) + 1;
+        int32_t max    = xt_atomic_load_i32(&t->max_inside);
+        while (inside > max && xt_atomic_compare_exchange_i32(&t->max_inside, max, inside) != max)
+            max = xt_atomic_load_i32(&t->max_inside);
+        xthread_yield();
+        xt_atomic_fetch_sub_i32(&t->inside, 1);
+        xthread_semaphore_post(&t->permits, 1);
+    }
+    return 0;
+}
+static int test_atomic_wait_proc(void* ctx)
+{
+    struct test_semaphore* t = (struct test_semaphore*)ctx;
+    while (xt_atomic_load_u32(&t->gate) == 0)
+        xt_atomic_wait_u32(&t->gate, 0, -1);
+    xt_atomic_fetch_add_i32(&t->through_gate, 1);
+    return 0;
+}
+
+struct test_rwlock
+{
+    xt_rwlock_t        lock;
+    int64_t            a, b;
+    xt_seqlock_t       seqlock;
+    int64_t            pair[2];
+    xt_atomic_int32_t  torn;
+    xt_atomic_uint32_t done;
+};
+static int test_rwlock_proc(void* ctx)
+{
+    struct test_rwlock* t = (struct test_rwlock*)ctx;
+    for (int i = 0; i < 10000; i++)
+    {
+        xt_rwlock_write_lock(&t->lock);
+        t->a++;
+        t->b++;
+        xt_rwlock_write_unlock(&t->lock);
+
+        xt_rwlock_read_lock(&t->lock);
+        if (t->a != t->b)
+            xt_atomic_fetch_add_i32(&t->torn, 1);
+        xt_rwlock_read_unlock(&t->lock);
+    }
+    return 0;
+}
+static int test_seqlock_writer(void* ctx)
+{
+    struct test_rwlock* t = (struct test_rwlock*)ctx;
+    for (int64_t i = 1; !xt_atomic_load_u32(&t->done); i++)
+    {
+        int64_t pair[2] = {i, -i};
+        xt_seqlock_write(&t->seqlock, t->pair, pair, sizeof(pair));
+    }
+    return 0;
+}
+
+#define TEST_TRIPLE_WRITES 200000
+struct test_triple_item
+{
+    uint64_t seq;
+    uint64_t data[15];
+};
+struct test_triple
+{
+    xt_triple_buffer_t      tb;
+    struct test_triple_item buffers[3];
+};
+static int test_triple_writer(void* ctx)
+{
+    struct test_triple* t = (struct test_triple*)ctx;
+    for (uint64_t seq = 1; seq <= TEST_TRIPLE_WRITES; seq++)
+    {
+        if (seq & 1)
+        {
+            struct test_triple_item* item = (struct test_triple_item*)xthread_triple_buffer_write_begin(&t->tb);
+            item->seq                     = seq;
+            for (int i = 0; i < 15; i++)
+                item->data[i] = seq * (i + 1);
+            xthread_triple_buffer_write_end(&t->tb);
+        }
+        else
+        {
+            struct test_triple_item item;
+            item.seq = seq;
+            for (int i = 0; i < 15; i++)
+                item.data[i] = seq * (i + 1);
+            xthread_triple_buffer_write(&t->tb, &item);
+        }
+    }
+    return 0;
+}
+
+static void test_ebr_free(void* ctx, void* ptr)
+{
+    (void)ptr;
+    (*(int*)ctx)++;
+}
+
+#define TEST_EBR_READERS   3
+#define TEST_EBR_PUBLISHES 5000
+#define TEST_EBR_ALIVE     0x600d
+#define TEST_EBR_DEAD      0xdead
+struct test_ebr_object
+{
+    xt_atomic_uint32_t state;
+    uint32_t           value;
+};
+struct test_ebr
+{
+    xt_ebr_t*              ebr;
+    xt_atomic_ptr_t        current;
+    struct test_ebr_object objects[TEST_EBR_PUBLISHES + 1]; // Never really freed, so use after free can be spotted
+    xt_atomic_int32_t      freed;
+    xt_atomic_int32_t      used_after_free;
+    xt_atomic_uint32_t     done;
+};
+static void test_ebr_kill(void* ctx, void* ptr)
+{
+    struct test_ebr_object* obj = (struct test_ebr_object*)ptr;
+    xt_atomic_store_u32(&obj->state, TEST_EBR_DEAD);
+    xt_atomic_fetch_add_i32(&((struct test_ebr*)ctx)->freed, 1);
+}
+static int test_ebr_reader_proc(void* ctx)
+{
+    struct test_ebr* t      = (struct test_ebr*)ctx;
+    xt_ebr_reader_t* reader = xthread_ebr_register(t->ebr);
+    xassert(reader);
+    while (! xt_atomic_load_u32(&t->done))
+    {
+        xthread_ebr_enter(reader);
+        struct test_ebr_object* obj = (struct test_ebr_object*)xt_atomic_load_ptr(&t->current);
+        for (int i = 0; i < 100; i++)
+            if (xt_atomic_load_u32(&obj->state) != TEST_EBR_ALIVE)
+                xt_atomic_fetch_add_i32(&t->used_after_free, 1);
+        xassert(obj->value == (uint32_t)(obj - t->objects));
+        xthread_ebr_exit(reader);
+    }
+    xthread_ebr_unregister(t->ebr, reader);
+    return 0;
+}
+
+#define TEST_FAIR_LOCK_THREADS 4
+#define TEST_FAIR_LOCK_ITERS   20000
+struct test_fair_lock
+{
+    xt_ticketlock_t ticket;
+    xt_lock_stats_t ticket_stats;
+    int64_t         ticket_a, ticket_b; // Plain, only touched under the ticket lock
+    xt_mcslock_t    mcs;
+    xt_lock_stats_t mcs_stats;
+    int64_t         mcs_a, mcs_b; // Plain, only touched under the MCS lock
+};
+static int test_fair_lock_proc(void* ctx)
+{
+    struct test_fair_lock* t = (struct test_fair_lock*)ctx;
+    xt_mcs_node_t          node;
+    for (int i = 0; i < TEST_FAIR_LOCK_ITERS; i++)
+    {
+        if (i % 8 != 0 || ! xt_ticketlock_trylock(&t->ticket))
+            xt_ticketlock_lock(&t->ticket);
+        t->ticket_a++;
+        t->ticket_b++;
+        xt_ticketlock_unlock(&t->ticket);
+
+        xt_mcslock_lock(&t->mcs, &node);
+        t->mcs_a++;
+        t->mcs_b++;
+        xt_mcslock_unlock(&t->mcs, &node);
+    }
+    return 0;
+}
+
+#define TEST_FREELIST_THREADS 4
+#define TEST_FREELIST_ITEMS   64
+#define TEST_FREELIST_ITERS   50000
+struct test_freelist_item
+{
+    xt_stack_node_t    node; // Overwritten while the item is free
+    xt_atomic_uint32_t in_use;
+};
+struct test_freelist
+{
+    xt_freelist_t             list;
+    struct test_freelist_item items[TEST_FREELIST_ITEMS];
+    xt_atomic_int32_t         duplicates;
+};
+static int test_freelist_proc(void* ctx)
+{
+    struct test_freelist*      t = (struct test_freelist*)ctx;
+    struct test_freelist_item* held[8];
+    for (int i = 0; i < TEST_FREELIST_ITERS; i++)
+    {
+        // Take a few at a time, so others pop and push while we hold them
+        int n = 0;
+        for (; n < 1 + i % 8; n++)
+        {
+            held[n] = (struct test_freelist_item*)xthread_freelist_alloc(&t->list);
+            if (! held[n])
+                break;
+            if (xt_atomic_exchange_u32(&held[n]->in_use, 1) != 0)
+                xt_atomic_fetch_add_i32(&t->duplicates, 1);
+        }
+        while (n-- > 0)
+        {
+            xt_atomic_store_u32(&held[n]->in_use, 0);
+            xthread_freelist_free(&t->list, held[n]);
+        }
+    }
+    return 0;
+}
+
+#define TEST_MPSC_PRODUCERS 4
+#define TEST_MPSC_ITEMS     20000
+struct test_mpsc_item
+{
+    xt_mpsc_node_t node; // First, so a node pointer is an item pointer
+    int            producer;
+    int            seq;
+};
+struct test_mpsc
+{
+    xt_mpsc_queue_t       queue;
+    struct test_mpsc_item items[TEST_MPSC_PRODUCERS][TEST_MPSC_ITEMS];
+    int                   next_seq[TEST_MPSC_PRODUCERS]; // Consumer only
+    int                   received;                      // Consumer only
+};
+struct test_mpsc_thread
+{
+    struct test_mpsc* shared;
+    int               index;
+};
+static int test_mpsc_producer(void* ctx)
+{
+    struct test_mpsc_thread* t = (struct test_mpsc_thread*)ctx;
+    for (int i = 0; i < TEST_MPSC_ITEMS; i++)
+    {
+        struct test_mpsc_item* item = &t->shared->items[t->index][i];
+        item->producer              = t->index;
+        item->seq                   = i;
+        xthread_mpsc_queue_push(&t->shared->queue, &item->node);
+    }
+    return 0;
+}
+static void test_mpsc_receive(void* ctx, xt_mpsc_node_t* node)
+{
+    struct test_mpsc*      t    = (struct test_mpsc*)ctx;
+    struct test_mpsc_item* item = (struct test_mpsc_item*)node;
+    xassert(item->seq == t->next_seq[item->producer]); // Each producers items arrive in the order they were pushed
+    t->next_seq[item->producer]++;
+    t->received++;
+}
+static void test_mpsc_repost(void* ctx, xt_mpsc_node_t* node)
+{
+    // Posts itself again, which must not keep drain going forever
+    xthread_mpsc_queue_push((xt_mpsc_queue_t*)ctx, node);
+}
+
+struct test_fiber_job
+{
+    xt_pool_t*        pool;
+    xt_atomic_int32_t child_runs;
+    xt_atomic_int32_t parent_saw_child;
+};
+static void test_fiber_child(void* ctx)
+{
+    struct test_fiber_job* t = (struct test_fiber_job*)ctx;
+    for (volatile int i = 0; i < 10000; i++)
+        ;
+    xt_atomic_fetch_add_i32(&t->child_runs, 1);
+}
+static void test_fiber_parent(void* ctx)
+{
+    struct test_fiber_job* t = (struct test_fiber_job*)ctx;
+    xt_job_t               child;
+    xthread_pool_submit(t->pool, &child, test_fiber_child, t);
+    xthread_pool_wait(t->pool, &child);
+    if (xt_atomic_load_i32(&t->child_runs) > 0)
+        xt_atomic_fetch_add_i32(&t->parent_saw_child, 1);
+}
+
+
+#define TEST_FIBER_NUM_PARKED (XTHREAD_POOL_QUEUE_SIZE + 500)
+struct test_fiber_gate
+{
+    xt_pool_t*        pool;
+    xt_job_t          gate;
+    xt_atomic_int32_t started;
+    xt_atomic_int32_t resumed;
+};
+static void test_fiber_gate_proc(void* ctx)
+{
+    struct test_fiber_gate* t = (struct test_fiber_gate*)ctx;
+    while (xt_atomic_load_i32(&t->started) < TEST_FIBER_NUM_PARKED)
+        xthread_yield();
+}
+static void test_fiber_gate_waiter(void* ctx)
+{
+    struct test_fiber_gate* t = (struct test_fiber_gate*)ctx;
+    xt_atomic_fetch_add_i32(&t->started, 1);
+    xthread_pool_wait(t->pool, &t->gate);
+    if (xthread_job_done(&t->gate))
+        xt_atomic_fetch_add_i32(&t->resumed, 1);
+}
+
+#define TEST_COUNTER_THREADS (XTHREAD_COUNTER_SHARDS + 4) // Some threads share a shard
+#define TEST_COUNTER_ITERS   20000
+struct test_counter
+{
+    xt_counter_t blocks;
+    xt_counter_t bytes;
+};
+static int test_counter_proc(void* ctx)
+{
+    struct test_counter* t = (struct test_counter*)ctx;
+    for (int i = 0; i < TEST_COUNTER_ITERS; i++)
+    {
+        xt_counter_add(&t->blocks, 1);
+        xt_counter_add(&t->bytes, 3);
+    }
+    return 0;
+}
+
+#define TEST_BARRIER_THREADS 4
+#define TEST_BARRIER_PHASES  2000
+struct test_barrier
+{
+    xt_barrier_t      barrier;
+    xt_latch_t        latch;
+    xt_atomic_int32_t slots[TEST_BARRIER_THREADS];
+    xt_atomic_int32_t serial;
+    xt_atomic_int32_t mismatches;
+    int               done[TEST_BARRIER_THREADS]; // Plain, published by the latch
+};
+struct test_barrier_thread
+{
+    struct test_barrier* shared;
+    int                  index;
+};
+static int test_barrier_proc(void* ctx)
+{
+    struct test_barrier_thread* self = (struct test_barrier_thread*)ctx;
+    struct test_barrier*        t    = self->shared;
+    xt_timer_t                  timer;
+    xthread_timer_init(&timer);
+    for (int p = 0; p < TEST_BARRIER_PHASES; p++)
+    {
+        // Every so often one thread is late, so the others go to sleep
+        if (self->index == p % TEST_BARRIER_THREADS && p % 64 == 0)
+            xthread_timer_wait(&timer, 1000000);
+        xt_atomic_store_i32(&t->slots[self->index], p);
+        if (xthread_barrier_wait(&t->barrier))
+            xt_atomic_fetch_add_i32(&t->serial, 1);
+
+        // Nobody can have moved on to the next phase before everyone has checked this one
+        for (int i = 0; i < TEST_BARRIER_THREADS; i++)
+            if (xt_atomic_load_i32(&t->slots[i]) != p)
+                xt_atomic_fetch_add_i32(&t->mismatches, 1);
+        if (xthread_barrier_wait(&t->barrier))
+            xt_atomic_fetch_add_i32(&t->serial, 1);
+    }
+    xthread_timer_term(&timer);
+
+    t->done[self->index] = 1;
+    xthread_latch_count_down(&t->latch, 1);
+    xthread_latch_wait(&t->latch);
+    return 0;
+}
+
+static xt_atomic_uint64_t g_test_deadline_fake_ns; // 0 uses the real clock
+static unsigned long long test_deadline_clock_ns(void)
+{
+    uint64_t ns = xt_atomic_load_u64(&g_test_deadline_fake_ns);
+    return ns ? ns : xthread_monotonic_ns();
+}
+static void test_deadline_advance(uint64_t ns) { xt_atomic_fetch_add_u64(&g_test_deadline_fake_ns, ns); }
+struct test_deadline_reports
+{
+    xt_atomic_int32_t finished;
+    xt_atomic_int32_t still_running;
+    xt_atomic_int32_t wrong_zone;
+};
+static void test_deadline_on_overrun(void* ctx, const xt_deadline_overrun_t* overrun)
+{
+    struct test_deadline_reports* t = (struct test_deadline_reports*)ctx;
+    xt_atomic_fetch_add_i32(overrun->still_running ? &t->still_running : &t->finished, 1);
+    if (overrun->zone == NULL || strcmp(overrun->zone, "stuck") != 0 || overrun->duration_ns <= overrun->deadline_ns)
+        xt_atomic_fetch_add_i32(&t->wrong_zone, 1);
+}
+
+#define TEST_DEADLINE_FAST_CYCLES  20000
+#define TEST_DEADLINE_STUCK_CYCLES 4
+struct test_deadline_thread
+{
+    xt_deadline_t*                deadline;
+    struct test_deadline_reports* reports;
+    bool                          stuck;
+};
+static int test_deadline_proc(void* ctx)
+{
+    struct test_deadline_thread* self = (struct test_deadline_thread*)ctx;
+    xt_timer_t                   timer;
+    xthread_timer_init(&timer);
+    if (self->stuck)
+    {
+        // Runs past a 1ms deadline until the watchdog has seen it stuck
+        for (int i = 0; i < TEST_DEADLINE_STUCK_CYCLES; i++)
+        {
+            xthread_deadline_begin(self->deadline, 1000000);
+            xthread_deadline_zone(self->deadline, "stuck");
+            while (xt_atomic_load_i32(&self->reports->still_running) == i)
+                xthread_timer_wait(&timer, 1000000);
+            xthread_deadline_end(self->deadline);
+        }
+    }
+    else
+    {
+        for (int i = 0; i < TEST_DEADLINE_FAST_CYCLES; i++)
+        {
+            xthread_deadline_begin(self->deadline, 1000000000);
+            xthread_deadline_zone(self->deadline, "synth");
+            xthread_deadline_end(self->deadline);
+        }
+    }
+    xthread_timer_term(&timer);
+    return 0;
+}
+
 int main()
 {
     xalloc_init();
@@ -81,6 +906,35 @@ int main()
         xassert(nums == NULL);
     }
 
+    // TEST XARRAY WITH ALLOCATOR
+    {
+        static char       arena_buf[4096];
+        struct test_arena arena = {arena_buf, 0, sizeof(arena_buf)};
+
+        xarr_allocator allocator = {test_arena_realloc, NULL, &arena};
+
+        int* nums = NULL;
+        xarra_init(nums, &allocator, 2);
+        xassert(xarra_allocator(nums) == &allocator);
+        xassert(xarr_len(nums) == 0);
+
+        for (int i = 0; i < 100; i++)
+            xarra_push(nums, i);
+        xarra_insert(nums, 50, 69);
+        xassert(xarr_len(nums) == 101);
+        xassert(nums[50] == 69 && nums[100] == 99);
+        xassert((char*)nums >= arena.buf && (char*)nums < arena.buf + arena.cap);
+        xassert(((size_t)nums & 15) == 0); // Same alignment as plain xarr arrays
+
+        xarr_delete(nums, 50);
+        xassert(xarr_len(nums) == 100);
+
+        // free is NULL, everything is released when the arena resets
+        xarra_free(nums);
+        xassert(nums == NULL);
+        arena.len = 0;
+    }
+
     // TEST XFILES
     {
         bool ok = false;
@@ -179,6 +1033,862 @@ int main()
         xtr_fmt(mybuf, sizeof(mybuf), 0, "%d", 3.14); // should write a big int
         s += 0;
     }
+
+    // Test XTRING interning
+    {
+        xtr_intern table;
+        xtr_intern_init(&table);
+
+        char name[32];
+        for (uint32_t i = 0; i < 1024; i++)
+        {
+            unsigned len = xtr_fmt(name, sizeof(name), 0, "param_%u", i);
+            uint32_t id  = xtr_intern_add(&table, name, len);
+            xassert(id == i);
+        }
+        // The table is full enough to grow on the next new string, but strings already added don't grow it
+        uint32_t cap_slots = table.cap_slots;
+        xassert(xtr_intern_add(&table, "param_42", 8) == 42);
+        xassert(table.cap_slots == cap_slots);
+        xassert(xtr_intern_find(&table, "param_999", 9) == 999);
+        xassert(xtr_intern_find(&table, "param_1024", 10) == XTR_INTERN_INVALID);
+        xassert(strcmp(xtr_intern_get(&table, 7), "param_7") == 0);
+        xassert(xtr_intern_len(&table, 7) == 7);
+        xassert(((size_t)xtr_intern_get(&table, 3) & 15) == 0);
+
+        xtr_intern_deinit(&table);
+    }
+    // Test XTHREAD inline atomics
+    {
+        static struct test_atomics a;
+        struct test_atomics_thread args[TEST_ATOMIC_THREADS];
+        xt_thread_ptr_t            threads[TEST_ATOMIC_THREADS];
+        xt_atomic_store_u64(&a.bits, 0xff);
+        for (int i = 0; i < TEST_ATOMIC_THREADS; i++)
+        {
+            args[i].shared = &a;
+            args[i].index  = i;
+            threads[i]     = xthread_create(test_atomics_proc, &args[i], 0);
+        }
+        for (int i = 0; i < TEST_ATOMIC_THREADS; i++)
+            xthread_join(threads[i]);
+
+        const uint64_t n = (uint64_t)TEST_ATOMIC_THREADS * TEST_ATOMIC_ITERS;
+        xassert(xt_atomic_load_u8(&a.u8) == (uint8_t)n);
+        xassert(xt_atomic_load_u16(&a.u16) == (uint16_t)n);
+        xassert(xt_atomic_load_u32(&a.u32) == n);
+        xassert(xt_atomic_load_u64(&a.u64) == n << 32); // Carries across the 32 bit halves
+        xassert(xt_atomic_load_i64(&a.i64) == -2 * (int64_t)n);
+        xassert(xt_atomic_load_i32(&a.cas) == (int32_t)n);
+        xassert(xt_atomic_load_u32(&a.xor_bits) == 0); // Each thread flips its bit an even number of times
+        xassert(xt_atomic_fetch_and_u64(&a.bits, 0xf0ull << 40) == (0xfull << 40 | 0xff));
+        xassert(xt_atomic_exchange_u64(&a.bits, 1) == 0);
+        xassert(xt_atomic_compare_exchange_u64(&a.bits, 2, 3) == 1); // Fails, returns the old value
+        xassert(xt_atomic_compare_exchange_u64(&a.bits, 1, 3) == 1);
+        xassert(xt_atomic_load_u64(&a.bits) == 3);
+    }
+
+    // Test XTHREAD explicit memory orders
+    {
+        static struct test_explicit e;
+        xt_thread_ptr_t consumer = xthread_create(test_explicit_consumer, &e, 0);
+        xt_thread_ptr_t claimer  = xthread_create(test_explicit_claimer, &e, 0);
+        for (uint32_t i = 1; i <= TEST_EXPLICIT_MESSAGES; i++)
+        {
+            while (xt_atomic_load_explicit_u32(&e.ready, xt_memory_order_acquire) != 0)
+                xthread_yield();
+            for (int j = 0; j < 4; j++)
+                e.payload[j] = (uint64_t)i * (j + 1);
+            xt_atomic_store_explicit_u32(&e.ready, i, xt_memory_order_release);
+
+            uint64_t v = xt_atomic_load_explicit_u64(&e.claimed, xt_memory_order_relaxed);
+            uint64_t prev;
+            while ((prev = xt_atomic_compare_exchange_explicit_u64(&e.claimed, v, v + 1, xt_memory_order_acq_rel)) != v)
+                v = prev;
+        }
+        xthread_join(consumer);
+        xthread_join(claimer);
+        xt_atomic_thread_fence(xt_memory_order_seq_cst);
+        xassert(xt_atomic_load_explicit_u32(&e.relaxed_count, xt_memory_order_relaxed) == TEST_EXPLICIT_MESSAGES);
+        xassert(xt_atomic_load_explicit_u64(&e.claimed, xt_memory_order_seq_cst) == 2 * TEST_EXPLICIT_MESSAGES);
+        xassert(xt_atomic_exchange_explicit_u64(&e.claimed, 0, xt_memory_order_release) == 2 * TEST_EXPLICIT_MESSAGES);
+    }
+
+    // Test XTHREAD signal
+    {
+        static struct test_signal s;
+        xthread_signal_init(&s.ping);
+        xthread_signal_init(&s.pong);
+        xthread_signal_init(&s.start);
+
+        // Raises don't stack, and a wait consumes the raise
+        xassert(! xthread_signal_wait(&s.ping, 0));
+        xthread_signal_raise(&s.ping);
+        xthread_signal_raise(&s.ping);
+        xassert(xthread_signal_wait(&s.ping, 0));
+        xassert(! xthread_signal_wait(&s.ping, 0));
+        xassert(! xthread_signal_wait(&s.ping, 20)); // Times out instead of sleeping forever
+
+        xt_thread_ptr_t ponger = xthread_create(test_signal_ponger, &s, 0);
+        for (int i = 0; i < TEST_SIGNAL_ROUNDS; i++)
+        {
+            xthread_signal_raise(&s.ping);
+            xassert(xthread_signal_wait(&s.pong, -1));
+        }
+        xthread_join(ponger);
+        xassert(! xthread_signal_wait(&s.pong, 0));
+
+        // Several threads parked on one signal. Each raise wakes at least one of them
+        xt_thread_ptr_t waiters[TEST_SIGNAL_WAITERS];
+        xt_timer_t      timer;
+        xthread_timer_init(&timer);
+        for (int i = 0; i < TEST_SIGNAL_WAITERS; i++)
+            waiters[i] = xthread_create(test_signal_waiter, &s, 0);
+        while (xt_atomic_load_i32(&s.started) < TEST_SIGNAL_WAITERS)
+        {
+            xthread_signal_raise(&s.start);
+            xthread_timer_wait(&timer, 1000000);
+        }
+        for (int i = 0; i < TEST_SIGNAL_WAITERS; i++)
+            xthread_join(waiters[i]);
+        xthread_timer_term(&timer);
+
+        xthread_signal_term(&s.start);
+        xthread_signal_term(&s.pong);
+        xthread_signal_term(&s.ping);
+    }
+
+    // Test XTHREAD MPMC queue
+    {
+        static struct test_mpmc q;
+        xthread_mpmc_queue_init(&q.queue, q.cells, TEST_MPMC_CELLS);
+
+        void* v = NULL;
+        xassert(! xthread_mpmc_queue_try_pop(&q.queue, &v));
+        xassert(xthread_mpmc_queue_consume(&q.queue, 0) == NULL);
+        for (int i = 0; i < TEST_MPMC_CELLS; i++)
+            xassert(xthread_mpmc_queue_try_push(&q.queue, (void*)(uintptr_t)(i + 1)));
+        xassert(! xthread_mpmc_queue_try_push(&q.queue, &q));
+        xassert(! xthread_mpmc_queue_produce(&q.queue, &q, 10)); // Full, times out
+        for (int i = 0; i < TEST_MPMC_CELLS; i++)
+        {
+            xassert(xthread_mpmc_queue_try_pop(&q.queue, &v));
+            xassert(v == (void*)(uintptr_t)(i + 1)); // FIFO with a single thread
+        }
+        xassert(xthread_mpmc_queue_count(&q.queue) == 0);
+
+        struct test_mpmc_thread args[TEST_MPMC_THREADS];
+        xt_thread_ptr_t         producers[TEST_MPMC_THREADS];
+        xt_thread_ptr_t         consumers[TEST_MPMC_THREADS];
+        for (int i = 0; i < TEST_MPMC_THREADS; i++)
+        {
+            args[i].shared = &q;
+            args[i].index  = i;
+            consumers[i]   = xthread_create(test_mpmc_consumer, &args[i], 0);
+        }
+        for (int i = 0; i < TEST_MPMC_THREADS; i++)
+            producers[i] = xthread_create(test_mpmc_producer, &args[i], 0);
+        for (int i = 0; i < TEST_MPMC_THREADS; i++)
+        {
+            xthread_join(producers[i]);
+            xthread_join(consumers[i]);
+        }
+        // Nothing lost, nothing duplicated
+        for (int i = 0; i < TEST_MPMC_THREADS * TEST_MPMC_ITEMS; i++)
+            xassert(xt_atomic_load_i32(&q.seen[i]) == 1);
+        xassert(xthread_mpmc_queue_count(&q.queue) == 0);
+        xthread_mpmc_queue_term(&q.queue);
+    }
+
+    // Test XTHREAD SPSC ring
+    {
+        static struct test_spsc s;
+        xthread_spsc_ring_init(&s.ring, s.buffer, sizeof(s.buffer[0]), TEST_SPSC_SIZE);
+
+        struct test_spsc_item item = {0};
+        xassert(! xthread_spsc_ring_consume(&s.ring, &item));
+        for (uint32_t i = 0; i < TEST_SPSC_SIZE; i++)
+        {
+            item.seq = i;
+            xassert(xthread_spsc_ring_produce(&s.ring, &item));
+        }
+        xassert(! xthread_spsc_ring_produce(&s.ring, &item));
+        xassert(xthread_spsc_ring_count(&s.ring) == TEST_SPSC_SIZE);
+        for (uint32_t i = 0; i < TEST_SPSC_SIZE; i++)
+        {
+            xassert(xthread_spsc_ring_consume(&s.ring, &item));
+            xassert(item.seq == i);
+        }
+
+        xt_thread_ptr_t       producer = xthread_create(test_spsc_producer, &s, 0);
+        struct test_spsc_item batch[TEST_SPSC_BATCH + 3];
+        uint32_t              expected = 0;
+        while (expected < TEST_SPSC_ITEMS)
+        {
+            // A different batch size to the producer
+            uint32_t n = xthread_spsc_ring_consume_n(&s.ring, batch, 1 + expected % (TEST_SPSC_BATCH + 3));
+            if (n == 0)
+                xthread_yield();
+            for (uint32_t i = 0; i < n; i++, expected++)
+            {
+                xassert(batch[i].seq == expected);
+                xassert(batch[i].check == ~expected);
+            }
+        }
+        xthread_join(producer);
+        xassert(xthread_spsc_ring_count(&s.ring) == 0);
+        xassert(xthread_spsc_ring_consume_n(&s.ring, batch, TEST_SPSC_BATCH) == 0);
+    }
+
+    // Test XTHREAD work stealing pool
+    {
+        // Chase-Lev deque. The owner pushes and takes while thieves steal, every job must run exactly once
+        static struct test_deque deque;
+        xt_thread_ptr_t          thieves[3];
+        for (int i = 0; i < 3; i++)
+            thieves[i] = xthread_create(test_deque_thief, &deque, 0);
+        for (int i = 0; i < TEST_DEQUE_JOBS; i++)
+        {
+            while (!xthread_pool_deque_push(&deque.deque, &deque.jobs[i]))
+            {
+                xt_job_t* job = xthread_pool_deque_take(&deque.deque);
+                if (job)
+                    xt_atomic_fetch_add_i32(&deque.runs[job - deque.jobs], 1);
+            }
+            if (i % 3 == 0)
+            {
+                xt_job_t* job = xthread_pool_deque_take(&deque.deque);
+                if (job)
+                    xt_atomic_fetch_add_i32(&deque.runs[job - deque.jobs], 1);
+            }
+        }
+        xt_job_t* job;
+        while ((job = xthread_pool_deque_take(&deque.deque)) != NULL)
+            xt_atomic_fetch_add_i32(&deque.runs[job - deque.jobs], 1);
+        xt_atomic_store_u32(&deque.done, 1);
+        for (int i = 0; i < 3; i++)
+            xthread_join(thieves[i]);
+        for (int i = 0; i < TEST_DEQUE_JOBS; i++)
+            xassert(deque.runs[i] == 1);
+
+        xt_pool_t* pool = xthread_pool_create(4);
+        xassert(xthread_pool_num_threads(pool) == 4);
+
+        // Pool, including child jobs counting towards their parent
+        {
+            static struct test_pool t;
+            t.pool  = pool;
+            t.count = 0;
+            xthread_pool_submit(pool, &t.parent, test_pool_parent, &t);
+            xthread_pool_wait(pool, &t.parent);
+            xassert(xthread_job_done(&t.parent));
+            xassert(t.count == 257);
+        }
+
+        xthread_pool_destroy(pool);
+    }
+
+    // Test XTHREAD parallel_for and parallel_reduce
+    {
+        enum
+        {
+            N = 1000003
+        };
+        xt_pool_t* pool = xthread_pool_create(4);
+        int64_t*   nums = (int64_t*)malloc(sizeof(*nums) * N);
+        xthread_parallel_for(pool, 0, N, 0, test_square_range, nums);
+        for (int64_t i = 0; i < N; i++)
+            xassert(nums[i] == i * i);
+        free(nums);
+
+        int64_t sum = 0;
+        xthread_parallel_reduce(pool, 0, N, 1000, test_sum_reduce, test_sum_join, NULL, &sum, sizeof(sum));
+        xassert(sum == (int64_t)N * (N - 1) / 2);
+        xthread_pool_destroy(pool);
+    }
+
+    // Test XTHREAD graph. Every node must run after the nodes it depends on, on every run
+    {
+        static const int       edges[][2] = {{1, 0}, {2, 0}, {3, 1}, {3, 2}, {4, 3}, {5, 3}, {6, 4}, {6, 5}, {7, 0}};
+        struct test_graph      tg;
+        struct test_graph_node nodes[TEST_GRAPH_NODES];
+        xt_pool_t*             pool  = xthread_pool_create(4);
+        xt_graph_t*            graph = xthread_graph_create(TEST_GRAPH_NODES, 16);
+        for (int i = 0; i < TEST_GRAPH_NODES; i++)
+        {
+            nodes[i].graph = &tg;
+            nodes[i].index = xthread_graph_add_node(graph, test_graph_node_proc, &nodes[i]);
+            xassert(nodes[i].index == i);
+        }
+        for (int i = 0; i < (int)(sizeof(edges) / sizeof(edges[0])); i++)
+            xthread_graph_add_dependency(graph, edges[i][0], edges[i][1]);
+        for (int run = 0; run < 100; run++)
+        {
+            tg.counter = 0;
+            xthread_graph_run(graph, pool);
+            xassert(tg.counter == TEST_GRAPH_NODES);
+            for (int i = 0; i < (int)(sizeof(edges) / sizeof(edges[0])); i++)
+                xassert(tg.order[edges[i][0]] > tg.order[edges[i][1]]);
+        }
+        xthread_graph_destroy(graph);
+        xthread_pool_destroy(pool);
+    }
+
+    // Test XTHREAD create_ex
+    {
+        static struct test_create t;
+        xt_thread_ptr_t           threads[TEST_CREATE_THREADS];
+        int                       num_cores = xthread_num_cores();
+        xassert(num_cores > 0);
+        for (int i = 0; i < TEST_CREATE_THREADS; i++)
+        {
+            char name[16];
+            snprintf(name, sizeof(name), "xthread test %d", i);
+
+            xt_thread_options_t options;
+            memset(&options, 0, sizeof(options));
+            options.stack_size    = 4 * 1024 * 1024;
+            options.name          = name; // Copied before create_ex returns
+            options.affinity_mask = 1ull << (i % (num_cores < 64 ? num_cores : 64));
+            // Usually not permitted, which must still create the thread
+            options.sched_policy   = i & 1 ? XTHREAD_SCHED_FIFO : XTHREAD_SCHED_DEFAULT;
+            options.sched_priority = 10;
+            threads[i]             = xthread_create_ex(test_create_proc, &t, &options);
+            xassert(threads[i]);
+        }
+        int sum = 0;
+        for (int i = 0; i < TEST_CREATE_THREADS; i++)
+            sum += xthread_join(threads[i]);
+        xassert(sum == TEST_CREATE_THREADS * 100 + TEST_CREATE_THREADS * (TEST_CREATE_THREADS - 1) / 2);
+        xassert(t.ran == TEST_CREATE_THREADS);
+        xassert(t.named == TEST_CREATE_THREADS);
+    }
+
+    // Test XTHREAD set_realtime. Whether realtime is granted depends on the user, but the report must be sane
+    {
+        static struct test_realtime t;
+        struct test_realtime_thread args[2];
+        xt_thread_ptr_t             threads[2];
+        for (int i = 0; i < 2; i++)
+        {
+            args[i].shared = &t;
+            args[i].index  = i;
+            threads[i]     = xthread_create(test_realtime_proc, &args[i], 0);
+        }
+        for (int i = 0; i < 2; i++)
+            xthread_join(threads[i]);
+        xassert(t.counter == 2 * 10000);
+        for (int i = 0; i < 2; i++)
+        {
+            xassert(t.granted[i].sched_policy == XTHREAD_SCHED_FIFO || t.granted[i].sched_policy == XTHREAD_SCHED_DEFAULT);
+            if (t.granted[i].sched_policy == XTHREAD_SCHED_FIFO)
+                xassert(t.granted[i].sched_priority > 0 && t.granted[i].sched_priority <= XTHREAD_REALTIME_DEFAULT_PRIORITY);
+            else
+                xassert(t.granted[i].nice <= 0 && t.granted[i].nice >= -20);
+            xassert(! t.granted[i].memory_locked);
+        }
+    }
+
+    // Test XTHREAD fastmutex
+    {
+        static struct test_fastmutex t;
+        xassert(sizeof(t.mutex) == 4);
+        xassert(xt_fastmutex_trylock(&t.mutex));
+        xassert(! xt_fastmutex_trylock(&t.mutex));
+        xt_fastmutex_unlock(&t.mutex);
+
+        xt_thread_ptr_t threads[TEST_FASTMUTEX_THREADS];
+        for (int i = 0; i < TEST_FASTMUTEX_THREADS; i++)
+            threads[i] = xthread_create(test_fastmutex_proc, &t, 0);
+        for (int i = 0; i < TEST_FASTMUTEX_THREADS; i++)
+            xthread_join(threads[i]);
+        xassert(t.a == TEST_FASTMUTEX_THREADS * TEST_FASTMUTEX_ITERS);
+        xassert(t.b == t.a);
+        xassert(xt_atomic_load_u32(&t.mutex) == 0); // Unlocked, and no waiter left marked
+    }
+
+    // Test XTHREAD priority inheritance mutex. Falls back to a plain mutex where unsupported, which must still work
+    {
+        static struct test_pi_mutex t;
+        bool                        inherits = xthread_mutex_init_ex(&t.mutex, XTHREAD_MUTEX_PRIO_INHERIT);
+#if defined(__linux__)
+        xassert(inherits);
+#endif
+        (void)inherits;
+        xt_thread_ptr_t threads[TEST_PI_MUTEX_THREADS];
+        for (int i = 0; i < TEST_PI_MUTEX_THREADS; i++)
+            threads[i] = xthread_create(test_pi_mutex_proc, &t, 0);
+        for (int i = 0; i < TEST_PI_MUTEX_THREADS; i++)
+            xthread_join(threads[i]);
+        xassert(t.a == TEST_PI_MUTEX_THREADS * TEST_PI_MUTEX_ITERS);
+        xassert(t.b == t.a);
+        xthread_mutex_term(&t.mutex);
+    }
+
+    // Test XTHREAD semaphore and wait on address
+    {
+        static struct test_semaphore t;
+        xt_thread_ptr_t              threads[TEST_SEMAPHORE_THREADS];
+
+        xthread_semaphore_init(&t.items, 1);
+        xassert(xthread_semaphore_try_wait(&t.items));
+        xassert(! xthread_semaphore_try_wait(&t.items));
+        xassert(! xthread_semaphore_wait(&t.items, 10)); // Times out
+
+        // Every post is consumed exactly once, whether posted one at a time or in bulk
+        for (int i = 0; i < TEST_SEMAPHORE_THREADS; i++)
+            threads[i] = xthread_create(test_semaphore_consumer, &t, 0);
+        for (int posted = 0; posted < TEST_SEMAPHORE_THREADS * TEST_SEMAPHORE_ITERS;)
+        {
+            uint32_t n = 1 + posted % 5;
+            if (n > (uint32_t)(TEST_SEMAPHORE_THREADS * TEST_SEMAPHORE_ITERS - posted))
+                n = TEST_SEMAPHORE_THREADS * TEST_SEMAPHORE_ITERS - posted;
+            xthread_semaphore_post(&t.items, n);
+            posted += n;
+        }
+        for (int i = 0; i < TEST_SEMAPHORE_THREADS; i++)
+            xthread_join(threads[i]);
+        xassert(t.consumed == TEST_SEMAPHORE_THREADS * TEST_SEMAPHORE_ITERS);
+        xassert(! xthread_semaphore_try_wait(&t.items));
+        xthread_semaphore_term(&t.items);
+
+        // Never more than TEST_SEMAPHORE_PERMITS threads inside at once
+        xthread_semaphore_init(&t.permits, TEST_SEMAPHORE_PERMITS);
+        for (int i = 0; i < TEST_SEMAPHORE_THREADS; i++)
+            threads[i] = xthread_create(test_semaphore_permit, &t, 0);
+        for (int i = 0; i < TEST_SEMAPHORE_THREADS; i++)
+            xthread_join(threads[i]);
+        xassert(t.max_inside >= 1 && t.max_inside <= TEST_SEMAPHORE_PERMITS);
+        xthread_semaphore_term(&t.permits);
+
+        // xt_atomic_wait_u32 returns at once if the value already differs, and notify(all) wakes every sleeper
+        xassert(xt_atomic_wait_u32(&t.gate, 1, -1));
+        xassert(! xt_atomic_wait_u32(&t.gate, 0, 10));
+        for (int i = 0; i < TEST_SEMAPHORE_THREADS; i++)
+            threads[i] = xthread_create(test_atomic_wait_proc, &t, 0);
+        xt_timer_t timer;
+        xthread_timer_init(&timer);
+        xthread_timer_wait(&timer, 10000000); // Give them time to fall asleep
+        xthread_timer_term(&timer);
+        xassert(t.through_gate == 0);
+        xt_atomic_store_u32(&t.gate, 1);
+        xt_atomic_notify(&t.gate, true);
+        for (int i = 0; i < TEST_SEMAPHORE_THREADS; i++)
+            xthread_join(threads[i]);
+        xassert(t.through_gate == TEST_SEMAPHORE_THREADS);
+    }
+
+    // Test XTHREAD rwlock and seqlock
+    {
+        static struct test_rwlock t;
+        xt_thread_ptr_t           threads[4];
+        for (int i = 0; i < 4; i++)
+            threads[i] = xthread_create(test_rwlock_proc, &t, 0);
+        for (int i = 0; i < 4; i++)
+            xthread_join(threads[i]);
+        xassert(t.a == 4 * 10000 && t.b == t.a);
+        xassert(t.torn == 0);
+
+        xt_thread_ptr_t writer = xthread_create(test_seqlock_writer, &t, 0);
+        for (int i = 0; i < 100000; i++)
+        {
+            int64_t pair[2];
+            xt_seqlock_read(&t.seqlock, pair, t.pair, sizeof(pair));
+            xassert(pair[0] == -pair[1]);
+        }
+        xt_atomic_store_u32(&t.done, 1);
+        xthread_join(writer);
+    }
+
+    // Test XTHREAD triple buffer. The reader only ever sees whole items, in increasing order
+    {
+        static struct test_triple t;
+        xthread_triple_buffer_init(&t.tb, t.buffers, sizeof(t.buffers[0]));
+        bool                           is_new = true;
+        const struct test_triple_item* item   = (const struct test_triple_item*)xthread_triple_buffer_read(&t.tb, &is_new);
+        xassert(! is_new && item->seq == 0);
+
+        xt_thread_ptr_t writer   = xthread_create(test_triple_writer, &t, 0);
+        uint64_t        last     = 0;
+        int             num_seen = 0;
+        while (last < TEST_TRIPLE_WRITES)
+        {
+            item = (const struct test_triple_item*)xthread_triple_buffer_read(&t.tb, &is_new);
+            if (is_new)
+            {
+                xassert(item->seq > last);
+                num_seen++;
+            }
+            else
+            {
+                xassert(item->seq == last);
+            }
+            for (int i = 0; i < 15; i++)
+                xassert(item->data[i] == item->seq * (i + 1));
+            last = item->seq;
+        }
+        xthread_join(writer);
+        xassert(num_seen > 0);
+        item = (const struct test_triple_item*)xthread_triple_buffer_read(&t.tb, &is_new);
+        xassert(! is_new && item->seq == TEST_TRIPLE_WRITES);
+    }
+
+    // Test XTHREAD EBR. Objects retired in epoch E are freed when the epoch reaches E + 2, which a reader inside E holds back
+    {
+        int              freed  = 0;
+        int              object = 0;
+        xt_ebr_t*        ebr    = xthread_ebr_create(2);
+        xt_ebr_reader_t* reader = xthread_ebr_register(ebr);
+        xassert(reader);
+
+        xthread_ebr_enter(reader);
+        xthread_ebr_retire(ebr, &object, test_ebr_free, &freed);
+        xassert(xthread_ebr_collect(ebr) == 0); // Advances once
+        xassert(xthread_ebr_collect(ebr) == 0); // Held back by the reader
+        xassert(freed == 0);
+        xthread_ebr_exit(reader);
+        xassert(xthread_ebr_collect(ebr) == 1); // Advances twice
+        xassert(freed == 1);
+
+        xthread_ebr_retire(ebr, &object, test_ebr_free, &freed);
+        xthread_ebr_unregister(ebr, reader);
+        xthread_ebr_destroy(ebr); // Frees what is still retired
+        xassert(freed == 2);
+    }
+    // Test XTHREAD EBR with readers running while objects are published and collected
+    {
+        static struct test_ebr t;
+        t.ebr = xthread_ebr_create(TEST_EBR_READERS);
+        for (int i = 0; i <= TEST_EBR_PUBLISHES; i++)
+        {
+            t.objects[i].state = TEST_EBR_ALIVE;
+            t.objects[i].value = i;
+        }
+        xt_atomic_store_ptr(&t.current, &t.objects[0]);
+
+        xt_thread_ptr_t readers[TEST_EBR_READERS];
+        for (int i = 0; i < TEST_EBR_READERS; i++)
+            readers[i] = xthread_create(test_ebr_reader_proc, &t, 0);
+        for (int i = 1; i <= TEST_EBR_PUBLISHES; i++)
+        {
+            void* old = xthread_ebr_publish(t.ebr, &t.current, &t.objects[i], test_ebr_kill, &t);
+            xassert(old == &t.objects[i - 1]);
+            if (i % 16 == 0)
+                xthread_ebr_collect(t.ebr);
+        }
+        xt_atomic_store_u32(&t.done, 1);
+        for (int i = 0; i < TEST_EBR_READERS; i++)
+            xthread_join(readers[i]);
+        xassert(t.used_after_free == 0);
+        xthread_ebr_destroy(t.ebr);
+        xassert(t.freed == TEST_EBR_PUBLISHES); // Everything but the current object
+        xassert(t.objects[TEST_EBR_PUBLISHES].state == TEST_EBR_ALIVE);
+    }
+
+    // Test XTHREAD ticket and MCS locks, and their contention stats
+    {
+        static struct test_fair_lock t;
+        xt_ticketlock_init(&t.ticket, &t.ticket_stats);
+        xt_mcslock_init(&t.mcs, &t.mcs_stats);
+        xassert(xt_ticketlock_trylock(&t.ticket));
+        xassert(! xt_ticketlock_trylock(&t.ticket));
+        xt_ticketlock_unlock(&t.ticket);
+
+        xt_thread_ptr_t threads[TEST_FAIR_LOCK_THREADS];
+        for (int i = 0; i < TEST_FAIR_LOCK_THREADS; i++)
+            threads[i] = xthread_create(test_fair_lock_proc, &t, 0);
+        for (int i = 0; i < TEST_FAIR_LOCK_THREADS; i++)
+            xthread_join(threads[i]);
+
+        const int64_t n = (int64_t)TEST_FAIR_LOCK_THREADS * TEST_FAIR_LOCK_ITERS;
+        xassert(t.ticket_a == n && t.ticket_b == n);
+        xassert(t.mcs_a == n && t.mcs_b == n);
+        xassert(xt_atomic_load_u64(&t.ticket_stats.acquisitions) == (uint64_t)n + 1); // + the trylock above
+        xassert(xt_atomic_load_u64(&t.ticket_stats.contended) <= (uint64_t)n);
+        xassert(xt_atomic_load_u64(&t.mcs_stats.acquisitions) == (uint64_t)n);
+        xassert(xt_atomic_load_u64(&t.mcs_stats.contended) <= (uint64_t)n);
+        xassert(xt_atomic_load_ptr(&t.mcs.tail) == NULL);
+        xassert(xt_atomic_load_u32(&t.ticket.next) == xt_atomic_load_u32(&t.ticket.serving));
+    }
+
+    // Test XTHREAD free list. Items are never handed out twice at once, and none go missing
+    {
+        static struct test_freelist t;
+        xthread_freelist_init(&t.list, t.items, sizeof(t.items[0]), TEST_FREELIST_ITEMS);
+        xassert(xthread_freelist_alloc(&t.list) == &t.items[0]);
+        xthread_freelist_free(&t.list, &t.items[0]);
+
+        xt_thread_ptr_t threads[TEST_FREELIST_THREADS];
+        for (int i = 0; i < TEST_FREELIST_THREADS; i++)
+            threads[i] = xthread_create(test_freelist_proc, &t, 0);
+        for (int i = 0; i < TEST_FREELIST_THREADS; i++)
+            xthread_join(threads[i]);
+        xassert(t.duplicates == 0);
+
+        static bool seen[TEST_FREELIST_ITEMS];
+        int         count = 0;
+        void*       item;
+        while ((item = xthread_freelist_alloc(&t.list)) != NULL)
+        {
+            int idx = (int)((struct test_freelist_item*)item - t.items);
+            xassert(idx >= 0 && idx < TEST_FREELIST_ITEMS);
+            xassert(! seen[idx]);
+            seen[idx] = true;
+            count++;
+        }
+        xassert(count == TEST_FREELIST_ITEMS);
+    }
+
+    // Test XTHREAD MPSC queue
+    {
+        static struct test_mpsc t;
+        xthread_mpsc_queue_init(&t.queue);
+        xassert(xthread_mpsc_queue_pop(&t.queue) == NULL);
+
+        struct test_mpsc_thread args[TEST_MPSC_PRODUCERS];
+        xt_thread_ptr_t         producers[TEST_MPSC_PRODUCERS];
+        for (int i = 0; i < TEST_MPSC_PRODUCERS; i++)
+        {
+            args[i].shared = &t;
+            args[i].index  = i;
+            producers[i]   = xthread_create(test_mpsc_producer, &args[i], 0);
+        }
+        while (t.received < TEST_MPSC_PRODUCERS * TEST_MPSC_ITEMS)
+        {
+            int n = xthread_mpsc_queue_drain(&t.queue, 7, test_mpsc_receive, &t);
+            xassert(n >= 0 && n <= 7);
+            if (n == 0)
+                xthread_yield();
+        }
+        for (int i = 0; i < TEST_MPSC_PRODUCERS; i++)
+            xthread_join(producers[i]);
+        for (int i = 0; i < TEST_MPSC_PRODUCERS; i++)
+            xassert(t.next_seq[i] == TEST_MPSC_ITEMS);
+        xassert(xthread_mpsc_queue_pop(&t.queue) == NULL);
+
+        xthread_mpsc_queue_push(&t.queue, &t.items[0][0].node);
+        xassert(xthread_mpsc_queue_drain(&t.queue, 3, test_mpsc_repost, &t.queue) == 3);
+        xassert(xthread_mpsc_queue_pop(&t.queue) == &t.items[0][0].node);
+        xassert(xthread_mpsc_queue_pop(&t.queue) == NULL);
+    }
+
+    // Test XTHREAD pool fibers
+    {
+        xt_pool_t* pool = xthread_pool_create(4);
+
+        // Fiber jobs waiting on a child park, and finish once the child is done
+        {
+            static xt_job_t       jobs[32];
+            struct test_fiber_job t;
+            t.pool             = pool;
+            t.child_runs       = 0;
+            t.parent_saw_child = 0;
+            for (int i = 0; i < 32; i++)
+                xthread_pool_submit_fiber(pool, &jobs[i], test_fiber_parent, &t);
+            for (int i = 0; i < 32; i++)
+                xthread_pool_wait(pool, &jobs[i]);
+            xassert(t.child_runs == 32);
+            xassert(t.parent_saw_child == 32);
+        }
+
+        // More fibers parked at once than fit in the pools queues. The gate only opens once every waiter has started
+        {
+            static xt_job_t               jobs[TEST_FIBER_NUM_PARKED];
+            static struct test_fiber_gate t;
+            t.pool    = pool;
+            t.started = 0;
+            t.resumed = 0;
+            xthread_pool_submit(pool, &t.gate, test_fiber_gate_proc, &t);
+            for (int i = 0; i < TEST_FIBER_NUM_PARKED; i++)
+                xthread_pool_submit_fiber(pool, &jobs[i], test_fiber_gate_waiter, &t);
+            for (int i = 0; i < TEST_FIBER_NUM_PARKED; i++)
+                xthread_pool_wait(pool, &jobs[i]);
+            xassert(t.resumed == TEST_FIBER_NUM_PARKED);
+        }
+
+        xthread_fiber_release_thread();
+        xthread_pool_destroy(pool);
+    }
+
+    // Test XTHREAD counters. Reads while adding only ever go up, and no adds go missing
+    {
+        static struct test_counter t;
+        xassert(xt_counter_read(&t.blocks) == 0);
+
+        xt_thread_ptr_t threads[TEST_COUNTER_THREADS];
+        for (int i = 0; i < TEST_COUNTER_THREADS; i++)
+            threads[i] = xthread_create(test_counter_proc, &t, 0);
+
+        const int64_t n    = (int64_t)TEST_COUNTER_THREADS * TEST_COUNTER_ITERS;
+        int64_t       last = 0;
+        while (last < n)
+        {
+            int64_t v = xt_counter_read(&t.blocks);
+            xassert(v >= last && v <= n);
+            last = v;
+        }
+        for (int i = 0; i < TEST_COUNTER_THREADS; i++)
+            xthread_join(threads[i]);
+
+        xassert(xt_counter_read(&t.blocks) == n);
+        xassert(xt_counter_read(&t.bytes) == n * 3);
+        xt_counter_reset(&t.blocks);
+        xassert(xt_counter_read(&t.blocks) == 0);
+        xassert(xt_counter_read(&t.bytes) == n * 3);
+        xt_counter_add(&t.blocks, -5);
+        xassert(xt_counter_read(&t.blocks) == -5);
+    }
+
+    // Test XTHREAD barrier and latch. No thread passes a barrier early, and one thread per phase is told it was last
+    {
+        static struct test_barrier t;
+        xthread_barrier_init(&t.barrier, TEST_BARRIER_THREADS);
+        xthread_latch_init(&t.latch, TEST_BARRIER_THREADS);
+        xassert(! xthread_latch_try_wait(&t.latch));
+
+        struct test_barrier_thread ctx[TEST_BARRIER_THREADS];
+        xt_thread_ptr_t            threads[TEST_BARRIER_THREADS];
+        for (int i = 0; i < TEST_BARRIER_THREADS; i++)
+        {
+            ctx[i].shared = &t;
+            ctx[i].index  = i;
+            threads[i]    = xthread_create(test_barrier_proc, &ctx[i], 0);
+        }
+        xthread_latch_wait(&t.latch);
+        for (int i = 0; i < TEST_BARRIER_THREADS; i++)
+            xassert(t.done[i] == 1);
+        for (int i = 0; i < TEST_BARRIER_THREADS; i++)
+            xthread_join(threads[i]);
+
+        xassert(xthread_latch_try_wait(&t.latch));
+        xassert(t.mismatches == 0);
+        xassert(t.serial == 2 * TEST_BARRIER_PHASES);
+    }
+
+    // Test XTHREAD deadline buckets. Each value lands in a bucket no more than ~12% wider than it
+    {
+        xassert(xthread_deadline_bucket(0) == 0 && xthread_deadline_bucket(7) == 7);
+        xassert(xthread_deadline_bucket(~0ull) == XTHREAD_DEADLINE_HISTOGRAM_SIZE - 1);
+        xassert(xthread_deadline_bucket_max(XTHREAD_DEADLINE_HISTOGRAM_SIZE - 1) == ~0ull);
+        for (uint64_t v = 1; v < (1ull << 62); v += v / 7 + 1)
+        {
+            int      b   = xthread_deadline_bucket(v);
+            uint64_t max = xthread_deadline_bucket_max(b);
+            xassert(max >= v && max - v <= v / 8);
+            xassert(xthread_deadline_bucket(max) == b && xthread_deadline_bucket(max + 1) == b + 1);
+        }
+    }
+
+    // Test XTHREAD deadline stats, with the clock driven by the test
+    {
+        static struct test_deadline_reports reports;
+
+        xt_deadline_monitor_t* monitor = xthread_deadline_monitor_create(1, 60000, test_deadline_on_overrun, &reports);
+        xt_deadline_t*         d       = xthread_deadline_register(monitor, "audio");
+        xassert(d != NULL);
+        xassert(xthread_deadline_register(monitor, "full") == NULL);
+
+        // 1000 cycles with a 1us deadline: 979 take 100ns, 15 take 800ns, 5 take 5us and 1 takes 7us.
+        // Overruns are spent in "stuck"
+        xt_atomic_store_u64(&g_test_deadline_fake_ns, 1000000);
+        xt_deadline_stats_t stats;
+        for (int i = 0; i < 1000; i++)
+        {
+            xthread_deadline_begin(d, 1000);
+            if (i == 500)
+            {
+                test_deadline_advance(500);
+                xthread_deadline_zone(d, "synth");
+                test_deadline_advance(500);
+                xthread_deadline_zone(d, "stuck");
+                test_deadline_advance(6000);
+            }
+            else
+            {
+                if (i >= 995)
+                    xthread_deadline_zone(d, "stuck");
+                test_deadline_advance(i < 980 ? 100 : i < 995 ? 800 : 5000);
+            }
+            xthread_deadline_end(d);
+            if (i % 128 == 0) // Keep the ring from filling up
+                xthread_deadline_get_stats(monitor, d, &stats);
+        }
+        xthread_deadline_get_stats(monitor, d, &stats);
+        xassert(stats.cycles == 1000 && stats.dropped == 0 && stats.hangs == 0);
+        xassert(stats.overruns == 6);
+        xassert(stats.worst_ns == 7000 && stats.worst_deadline_ns == 1000);
+        xassert(stats.worst_zone != NULL && strcmp(stats.worst_zone, "stuck") == 0 && stats.worst_zone_ns == 6000);
+        // The 99th falls among the 800s, between 979 cycles at or below 100ns and 994 at or below 800ns
+        xassert(stats.p50_ns == xthread_deadline_bucket_max(xthread_deadline_bucket(100)));
+        xassert(stats.p99_ns == xthread_deadline_bucket_max(xthread_deadline_bucket(800)));
+        xassert(stats.p999_ns >= 5000 && stats.p999_ns <= xthread_deadline_bucket_max(xthread_deadline_bucket(7000)));
+
+        // A cycle is only counted once it ends. Spotting it while stuck is the watchdogs job
+        xthread_deadline_begin(d, 1000);
+        xthread_deadline_zone(d, "stuck");
+        test_deadline_advance(2000);
+        xthread_deadline_get_stats(monitor, d, &stats);
+        xassert(stats.cycles == 1000 && stats.overruns == 6);
+        xthread_deadline_end(d);
+        xthread_deadline_get_stats(monitor, d, &stats);
+        xassert(stats.cycles == 1001 && stats.overruns == 7 && stats.worst_ns == 7000);
+
+        xthread_deadline_reset_stats(monitor, d);
+        xthread_deadline_get_stats(monitor, d, &stats);
+        xassert(stats.cycles == 0 && stats.overruns == 0 && stats.worst_ns == 0 && stats.p99_ns == 0);
+        xt_atomic_store_u64(&g_test_deadline_fake_ns, 0);
+
+        // Everything queued is reported by the watchdog on its way out
+        xthread_deadline_unregister(monitor, d);
+        xthread_deadline_monitor_destroy(monitor);
+        xassert(reports.finished == 7 && reports.still_running == 0 && reports.wrong_zone == 0);
+    }
+
+    // Test XTHREAD deadline monitor, with realtime threads reporting while the watchdog and another thread collect
+    {
+        static struct test_deadline_reports reports;
+
+        xt_deadline_monitor_t* monitor = xthread_deadline_monitor_create(2, 5, test_deadline_on_overrun, &reports);
+
+        struct test_deadline_thread ctx[2];
+        xt_thread_ptr_t             threads[2];
+        for (int i = 0; i < 2; i++)
+        {
+            ctx[i].deadline = xthread_deadline_register(monitor, i ? "stuck" : "fast");
+            ctx[i].reports  = &reports;
+            ctx[i].stuck    = i == 1;
+            xassert(ctx[i].deadline != NULL);
+            threads[i] = xthread_create(test_deadline_proc, &ctx[i], 0);
+        }
+        xt_deadline_stats_t stats[2];
+        xt_timer_t          timer;
+        xthread_timer_init(&timer);
+        do
+        {
+            xthread_deadline_get_stats(monitor, ctx[0].deadline, &stats[0]);
+            xthread_deadline_get_stats(monitor, ctx[1].deadline, &stats[1]);
+            xthread_timer_wait(&timer, 100000);
+        } while (stats[1].cycles < TEST_DEADLINE_STUCK_CYCLES);
+        xthread_timer_term(&timer);
+        for (int i = 0; i < 2; i++)
+            xthread_join(threads[i]);
+
+        for (int i = 0; i < 2; i++)
+            xthread_deadline_get_stats(monitor, ctx[i].deadline, &stats[i]);
+        xassert(stats[0].cycles + stats[0].dropped == TEST_DEADLINE_FAST_CYCLES);
+        xassert(stats[0].overruns == 0 && stats[0].hangs == 0);
+        xassert(stats[1].cycles == TEST_DEADLINE_STUCK_CYCLES && stats[1].dropped == 0);
+        xassert(stats[1].overruns == TEST_DEADLINE_STUCK_CYCLES && stats[1].hangs == TEST_DEADLINE_STUCK_CYCLES);
+        xassert(stats[1].worst_ns > 1000000 && strcmp(stats[1].worst_zone, "stuck") == 0);
+        xassert(stats[1].p50_ns > 1000000);
+
+        for (int i = 0; i < 2; i++)
+            xthread_deadline_unregister(monitor, ctx[i].deadline);
+        xthread_deadline_monitor_destroy(monitor);
+        xassert(reports.finished == TEST_DEADLINE_STUCK_CYCLES && reports.still_running == TEST_DEADLINE_STUCK_CYCLES);
+        xassert(reports.wrong_zone == 0);
+    }
+
     fprintf(stderr, "\nAll tests passed\n");
 
     xalloc_shutdown();